@@ -6,11 +6,18 @@
  * the main loop.
  */
 
+#define _DEFAULT_SOURCE
+
 #include "pith_runtime.h"
 #include "pith_ui.h"
+#include "pith_watch.h"
+#include "pith_fs.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
+#include <limits.h>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -18,126 +25,43 @@
 #define getcwd _getcwd
 #else
 #include <unistd.h>
-#include <dirent.h>
-#include <sys/stat.h>
 #endif
 
-/* Global debug flag */
-bool g_debug = false;
-
 /* ========================================================================
-   FILE SYSTEM IMPLEMENTATION
+   HOT RELOAD
    ======================================================================== */
 
-static char* fs_read_file(const char *path, void *userdata) {
-    (void)userdata;
-    
-    FILE *f = fopen(path, "rb");
-    if (!f) return NULL;
-    
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    
-    char *contents = malloc(size + 1);
-    if (!contents) {
-        fclose(f);
-        return NULL;
+/* Watch the directory of every loaded source file */
+static PithWatcher* watch_sources(PithRuntime *rt) {
+    PithWatcher *watcher = pith_watcher_new();
+    for (size_t i = 0; i < rt->unit_count; i++) {
+        char dir[PATH_MAX];
+        if (snprintf(dir, sizeof(dir), "%s", rt->units[i]->name) >= (int)sizeof(dir)) {
+            fprintf(stderr, "Warning: not watching %s (path too long)\n", rt->units[i]->name);
+            continue;
+        }
+        char *slash = strrchr(dir, '/');
+        if (slash) {
+            *slash = '\0';
+        } else {
+            snprintf(dir, sizeof(dir), ".");
+        }
+        pith_watcher_add_dir(watcher, dir);
     }
-    
-    fread(contents, 1, size, f);
-    contents[size] = '\0';
-    fclose(f);
-    
-    return contents;
-}
-
-static bool fs_write_file(const char *path, const char *contents, void *userdata) {
-    (void)userdata;
-    
-    FILE *f = fopen(path, "wb");
-    if (!f) return false;
-    
-    size_t len = strlen(contents);
-    size_t written = fwrite(contents, 1, len, f);
-    fclose(f);
-    
-    return written == len;
+    return watcher;
 }
 
-static bool fs_file_exists(const char *path, void *userdata) {
-    (void)userdata;
-    
-    FILE *f = fopen(path, "r");
-    if (f) {
-        fclose(f);
-        return true;
-    }
-    return false;
-}
+/* ========================================================================
+   TIMERS
+   ======================================================================== */
 
-static char** fs_list_dir(const char *path, size_t *count, void *userdata) {
-    (void)userdata;
-    
-    *count = 0;
-    
+static void sleep_ms(double ms) {
 #ifdef _WIN32
-    /* Windows implementation */
-    char search_path[512];
-    snprintf(search_path, sizeof(search_path), "%s\\*", path);
-    
-    WIN32_FIND_DATA fd;
-    HANDLE h = FindFirstFile(search_path, &fd);
-    if (h == INVALID_HANDLE_VALUE) return NULL;
-    
-    /* Count entries first */
-    size_t capacity = 16;
-    char **entries = malloc(capacity * sizeof(char*));
-    
-    do {
-        if (strcmp(fd.cFileName, ".") == 0 || strcmp(fd.cFileName, "..") == 0) {
-            continue;
-        }
-        
-        if (*count >= capacity) {
-            capacity *= 2;
-            entries = realloc(entries, capacity * sizeof(char*));
-        }
-        
-        char full_path[512];
-        snprintf(full_path, sizeof(full_path), "%s\\%s", path, fd.cFileName);
-        entries[(*count)++] = strdup(full_path);
-        
-    } while (FindNextFile(h, &fd));
-    
-    FindClose(h);
-    return entries;
+    Sleep((DWORD)ms);
 #else
-    /* POSIX implementation */
-    DIR *dir = opendir(path);
-    if (!dir) return NULL;
-    
-    size_t capacity = 16;
-    char **entries = malloc(capacity * sizeof(char*));
-    
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-        
-        if (*count >= capacity) {
-            capacity *= 2;
-            entries = realloc(entries, capacity * sizeof(char*));
-        }
-        
-        char full_path[512];
-        snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
-        entries[(*count)++] = strdup(full_path);
-    }
-    
-    closedir(dir);
-    return entries;
+    struct timespec ts = { .tv_sec = (time_t)(ms / 1000),
+                           .tv_nsec = (long)(fmod(ms, 1000) * 1e6) };
+    nanosleep(&ts, NULL);
 #endif
 }
 
@@ -155,6 +79,8 @@ static void print_usage(const char *program) {
     printf("  -h, --help    Show this help message\n");
     printf("  -v, --version Show version information\n");
     printf("  -d, --debug   Enable debug output (parsing, execution, rendering)\n");
+    printf("  -s, --stack-stats Print per-slot stack high-water marks on exit\n");
+    printf("  -m, --memory-fs   Copy the project into memory and never touch the disk\n");
 }
 
 static void print_version(void) {
@@ -165,6 +91,9 @@ static void print_version(void) {
 int main(int argc, char *argv[]) {
     /* Parse command line arguments */
     const char *project_path = ".";
+    bool stack_stats = false;
+    bool debug = false;
+    bool memory_fs = false;
     
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
@@ -176,7 +105,15 @@ int main(int argc, char *argv[]) {
             return 0;
         }
         if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--debug") == 0) {
-            g_debug = true;
+            debug = true;
+            continue;
+        }
+        if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--stack-stats") == 0) {
+            stack_stats = true;
+            continue;
+        }
+        if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--memory-fs") == 0) {
+            memory_fs = true;
             continue;
         }
         /* First non-flag argument is the project path */
@@ -184,13 +121,21 @@ int main(int argc, char *argv[]) {
     }
     
     /* Set up file system callbacks */
-    PithFileSystem fs = {
-        .read_file = fs_read_file,
-        .write_file = fs_write_file,
-        .file_exists = fs_file_exists,
-        .list_dir = fs_list_dir,
-        .userdata = NULL,
-    };
+    PithFileSystem fs = pith_fs_native();
+    PithMemFS *memfs = NULL;
+    if (memory_fs) {
+        /* Benchmarks: the program's file access costs no disk I/O */
+        memfs = pith_memfs_new();
+        size_t len;
+        char *source = fs.read_file(project_path, &len, NULL);
+        if (source) {
+            pith_memfs_add(memfs, project_path, source, len);
+            free(source);
+        } else {
+            pith_memfs_load_dir(memfs, project_path);
+        }
+        fs = pith_memfs_filesystem(memfs);
+    }
     
     /* Create runtime */
     PithRuntime *rt = pith_runtime_new(fs);
@@ -198,6 +143,9 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Failed to create runtime\n");
         return 1;
     }
+    rt->debug = debug;
+    rt->disk_cache = !memfs;
+    pith_stack_profile(rt, stack_stats);
     
     /* Load project */
     if (!pith_runtime_load_project(rt, project_path)) {
@@ -206,7 +154,7 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    if (g_debug) {
+    if (debug) {
         pith_debug_print_state(rt);
     }
 
@@ -225,7 +173,7 @@ int main(int argc, char *argv[]) {
     if (view) {
         /* Create UI window */
         PithUIConfig ui_config = pith_ui_default_config();
-        ui_config.verbose = g_debug;
+        ui_config.verbose = debug;
 
         /* Build window title */
         char title[256];
@@ -239,11 +187,27 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
+        /* Edits on disk never reach a memory file system */
+        PithWatcher *watcher = memfs ? NULL : watch_sources(rt);
+
         /* Main loop */
         while (!pith_ui_should_close(ui)) {
             /* Begin frame */
             pith_ui_begin_frame(ui);
 
+            /* Reload changed source files (the view is rebuilt once below) */
+            PithEvent change;
+            while ((change = pith_watcher_poll(watcher)).type != EVENT_NONE) {
+                if (debug) {
+                    fprintf(stderr, "[DEBUG] Reloading %s\n", change.as.file_change.path);
+                }
+                if (!pith_runtime_reload_file(rt, change.as.file_change.path)) {
+                    fprintf(stderr, "Reload failed: %s\n", pith_get_error(rt));
+                    pith_clear_error(rt);
+                }
+                pith_runtime_handle_event(rt, change);
+            }
+
             /* Poll and handle events */
             PithEvent event;
             while ((event = pith_ui_poll_event(ui)).type != EVENT_NONE) {
@@ -262,7 +226,10 @@ int main(int argc, char *argv[]) {
                         pith_ui_commit_text_widget(old_focus);
                     }
 
-                    if (hit && (hit->type == VIEW_TEXTFIELD || hit->type == VIEW_TEXTAREA)) {
+                    if (hit && hit->type == VIEW_TEXTAREA && hit == old_focus && event.as.click.alt) {
+                        /* Alt+click in the focused textarea adds a cursor */
+                        pith_ui_click_add_cursor(hit, event.as.click.x, event.as.click.y);
+                    } else if (hit && (hit->type == VIEW_TEXTFIELD || hit->type == VIEW_TEXTAREA)) {
                         pith_ui_set_focus(ui, hit);
                         pith_ui_click_to_cursor(hit, event.as.click.x, event.as.click.y);
                     } else if (hit && hit->type == VIEW_BUTTON) {
@@ -287,6 +254,17 @@ int main(int argc, char *argv[]) {
                 pith_runtime_handle_event(rt, event);
             }
 
+            /* Advance live searches by one time slice */
+            pith_runtime_search_step(rt, PITH_SEARCH_SLICE);
+
+            /* Deliver results of finished background jobs */
+            pith_runtime_poll_jobs(rt);
+
+            /* Fire due timers in one batch */
+            if (pith_runtime_next_timer(rt) == 0) {
+                pith_runtime_handle_event(rt, (PithEvent){ .type = EVENT_TICK });
+            }
+
             /* Check for dirty signals and re-render UI if needed */
             if (pith_runtime_has_dirty_signals(rt)) {
                 /* Clear focus before freeing old view (but remember signal for restoration) */
@@ -307,7 +285,7 @@ int main(int argc, char *argv[]) {
 
             /* Get view tree from runtime and render */
             view = pith_runtime_get_view(rt);
-            if (g_debug) {
+            if (debug) {
                 static bool first_frame = true;
                 if (first_frame) {
                     fprintf(stderr, "[DEBUG] View hierarchy:\n");
@@ -328,8 +306,9 @@ int main(int argc, char *argv[]) {
         }
 
         /* Cleanup UI */
+        pith_watcher_free(watcher);
         pith_ui_free(ui);
-    } else if (g_debug) {
+    } else if (debug) {
         fprintf(stderr, "[DEBUG] No ui slot, skipping window\n");
     }
 
@@ -337,20 +316,36 @@ int main(int argc, char *argv[]) {
     pith_runtime_run_slot(rt, "main");
     if (rt->has_error) {
         fprintf(stderr, "Error in main: %s\n", pith_get_error(rt));
+        if (stack_stats) pith_debug_print_stack_stats(rt);
         pith_runtime_free(rt);
         return 1;
     }
 
+    /* Without a window, sleep until each timer is due until none are left */
+    if (!view) {
+        double wait;
+        while (!rt->has_error && (wait = pith_runtime_next_timer(rt)) >= 0) {
+            sleep_ms(wait);
+            pith_runtime_handle_event(rt, (PithEvent){ .type = EVENT_TICK });
+        }
+    }
+
     /* Run exit slot if present */
     pith_runtime_run_slot(rt, "exit");
     if (rt->has_error) {
         fprintf(stderr, "Error in exit: %s\n", pith_get_error(rt));
+        if (stack_stats) pith_debug_print_stack_stats(rt);
         pith_runtime_free(rt);
         return 1;
     }
 
+    if (stack_stats) {
+        pith_debug_print_stack_stats(rt);
+    }
+
     /* Cleanup */
     pith_runtime_free(rt);
+    pith_memfs_free(memfs);
 
     return 0;
 }
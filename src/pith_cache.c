@@ -0,0 +1,240 @@
+/*
+ * pith_cache.c - On-disk token cache for fast project startup
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "pith_cache.h"
+#include "pith_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t token_size;        /* sizeof(PithCacheToken), guards layout changes */
+    uint64_t source_hash;
+    uint64_t source_length;
+    uint64_t token_count;
+    uint64_t string_bytes;
+} PithCacheHeader;
+
+typedef struct {
+    uint32_t type;
+    uint32_t text;              /* Offset into the string table + 1 (0 = no text) */
+    uint32_t line;
+    uint32_t column;
+} PithCacheToken;
+
+uint64_t pith_cache_hash(const char *source, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)source[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+#ifndef _WIN32
+
+/* ========================================================================
+   LOADING
+   ======================================================================== */
+
+bool pith_cache_load(const char *cache_path, const char *source, size_t len,
+                     PithUnit *unit) {
+    int fd = open(cache_path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(PithCacheHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    /* Validate the header against this source */
+    const PithCacheHeader *header = map;
+    bool valid = memcmp(header->magic, PITH_CACHE_MAGIC, sizeof(PITH_CACHE_MAGIC)) == 0 &&
+                 header->version == PITH_CACHE_VERSION &&
+                 header->token_size == sizeof(PithCacheToken) &&
+                 header->source_length == len &&
+                 header->token_count > 0 &&
+                 header->token_count <= (size - sizeof(PithCacheHeader)) / sizeof(PithCacheToken);
+    size_t strings_at = 0;
+    if (valid) {
+        strings_at = sizeof(PithCacheHeader) + header->token_count * sizeof(PithCacheToken);
+        valid = header->string_bytes > 0 &&
+                strings_at + header->string_bytes == size &&
+                ((const char *)map)[size - 1] == '\0' &&
+                header->source_hash == pith_cache_hash(source, len);
+    }
+    if (!valid) {
+        munmap(map, size);
+        return false;
+    }
+
+    /* One pass to check every record and build the tokens */
+    const PithCacheToken *records = (const PithCacheToken *)(header + 1);
+    char *strings = (char *)map + strings_at;
+    size_t count = header->token_count;
+    PithToken *tokens = malloc(count * sizeof(PithToken));
+    for (size_t i = 0; i < count; i++) {
+        const PithCacheToken *r = &records[i];
+        if (r->type > TOK_NIL || r->text > header->string_bytes ||
+            (r->type == TOK_EOF) != (i == count - 1)) {
+            free(tokens);
+            munmap(map, size);
+            return false;
+        }
+        tokens[i].type = (PithTokenType)r->type;
+        tokens[i].text = r->text ? strings + r->text - 1 : NULL;
+        tokens[i].line = r->line;
+        tokens[i].column = r->column;
+    }
+
+    unit->tokens = tokens;
+    unit->token_count = count;
+    unit->token_capacity = count;
+    unit->map = map;
+    unit->map_size = size;
+    return true;
+}
+
+void pith_cache_release(PithUnit *unit) {
+    if (unit->map) munmap(unit->map, unit->map_size);
+    unit->map = NULL;
+    unit->map_size = 0;
+}
+
+/* ========================================================================
+   STORING
+   ======================================================================== */
+
+/* Open-addressing set of texts already in the string table */
+typedef struct {
+    uint32_t *slots;            /* Offset + 1 into the table, 0 = empty */
+    size_t capacity;
+    char *table;
+    size_t table_len;
+    size_t table_capacity;
+} StringTable;
+
+static uint32_t string_table_add(StringTable *st, const char *text) {
+    size_t len = strlen(text);
+    size_t mask = st->capacity - 1;
+    size_t h = (size_t)pith_cache_hash(text, len) & mask;
+
+    while (st->slots[h]) {
+        if (strcmp(st->table + st->slots[h] - 1, text) == 0) return st->slots[h];
+        h = (h + 1) & mask;
+    }
+
+    if (st->table_len + len + 1 > st->table_capacity) {
+        while (st->table_len + len + 1 > st->table_capacity) st->table_capacity *= 2;
+        st->table = realloc(st->table, st->table_capacity);
+    }
+    memcpy(st->table + st->table_len, text, len + 1);
+    st->slots[h] = (uint32_t)st->table_len + 1;
+    st->table_len += len + 1;
+    return st->slots[h];
+}
+
+static bool write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+bool pith_cache_store(const char *cache_path, const char *source, size_t len,
+                      PithUnit *unit) {
+    size_t count = unit->token_count;
+    if (count == 0 || count > UINT32_MAX) return false;
+
+    /* Records and interned texts */
+    StringTable st = {0};
+    st.capacity = 64;
+    while (st.capacity < count * 2) st.capacity *= 2;
+    st.slots = calloc(st.capacity, sizeof(uint32_t));
+    st.table_capacity = 4096;
+    st.table = malloc(st.table_capacity);
+    st.table[0] = '\0';     /* Table is never empty, so it always ends in NUL */
+    st.table_len = 1;
+
+    PithCacheToken *records = malloc(count * sizeof(PithCacheToken));
+    bool fits = true;
+    for (size_t i = 0; i < count && fits; i++) {
+        PithToken *tok = &unit->tokens[i];
+        fits = tok->line <= UINT32_MAX && tok->column <= UINT32_MAX &&
+               st.table_len < UINT32_MAX / 2;
+        records[i].type = (uint32_t)tok->type;
+        records[i].text = tok->text ? string_table_add(&st, tok->text) : 0;
+        records[i].line = (uint32_t)tok->line;
+        records[i].column = (uint32_t)tok->column;
+    }
+
+    PithCacheHeader header = {0};
+    memcpy(header.magic, PITH_CACHE_MAGIC, sizeof(PITH_CACHE_MAGIC));
+    header.version = PITH_CACHE_VERSION;
+    header.token_size = sizeof(PithCacheToken);
+    header.source_hash = pith_cache_hash(source, len);
+    header.source_length = len;
+    header.token_count = count;
+    header.string_bytes = st.table_len;
+
+    bool ok = false;
+    /* A name that does not fit could point outside .cache, so skip the store */
+    char temp_path[PATH_MAX + 64];
+    fits = fits && pith_fs_temp_path(temp_path, sizeof(temp_path), cache_path);
+    int fd = fits ? open(temp_path, O_WRONLY | O_CREAT | O_EXCL, 0644) : -1;
+    if (fd >= 0) {
+        ok = write_all(fd, &header, sizeof(header)) &&
+             write_all(fd, records, count * sizeof(PithCacheToken)) &&
+             write_all(fd, st.table, st.table_len);
+        close(fd);
+        ok = ok && rename(temp_path, cache_path) == 0;
+        if (!ok) unlink(temp_path);
+    }
+
+    free(records);
+    free(st.slots);
+    free(st.table);
+    return ok;
+}
+
+#else /* _WIN32: no mmap, always lex */
+
+bool pith_cache_load(const char *cache_path, const char *source, size_t len,
+                     PithUnit *unit) {
+    (void)cache_path; (void)source; (void)len; (void)unit;
+    return false;
+}
+
+bool pith_cache_store(const char *cache_path, const char *source, size_t len,
+                      PithUnit *unit) {
+    (void)cache_path; (void)source; (void)len; (void)unit;
+    return false;
+}
+
+void pith_cache_release(PithUnit *unit) {
+    (void)unit;
+}
+
+#endif
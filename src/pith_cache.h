@@ -0,0 +1,42 @@
+/*
+ * pith_cache.h - On-disk token cache for fast project startup
+ *
+ * Each project file's tokens are saved in a binary cache file, keyed by
+ * a hash of the source text. On the next launch the cache file is mapped
+ * into memory and checked once; the tokens then point straight into the
+ * mapping, so nothing is lexed and token texts are not copied.
+ *
+ * File layout (native byte order, all offsets from the start of file):
+ *
+ *   PithCacheHeader
+ *   PithCacheToken[token_count]
+ *   string table (string_bytes bytes of NUL-terminated texts, each
+ *                 distinct text stored once)
+ */
+
+#ifndef PITH_CACHE_H
+#define PITH_CACHE_H
+
+#include "pith_runtime.h"
+
+#define PITH_CACHE_MAGIC    "PITHTOK"
+#define PITH_CACHE_VERSION  1
+
+/* Hash of a source text (FNV-1a, 64 bit) */
+uint64_t pith_cache_hash(const char *source, size_t len);
+
+/* Fill an empty unit from a cache file. Returns false (leaving the unit
+ * empty) if the file is missing, malformed or was made from a different
+ * source. */
+bool pith_cache_load(const char *cache_path, const char *source, size_t len,
+                     PithUnit *unit);
+
+/* Save a unit's tokens. Writes a temporary file and renames it into
+ * place, so readers never see a partial cache. */
+bool pith_cache_store(const char *cache_path, const char *source, size_t len,
+                      PithUnit *unit);
+
+/* Unmap a unit's cache file (its token texts point into the mapping) */
+void pith_cache_release(PithUnit *unit);
+
+#endif /* PITH_CACHE_H */
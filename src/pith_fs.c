@@ -0,0 +1,581 @@
+/*
+ * pith_fs.c - Bundled PithFileSystem implementations
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "pith_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <limits.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/* ========================================================================
+   NATIVE FILE SYSTEM
+   ======================================================================== */
+
+static char* native_read_file(const char *path, size_t *len, void *userdata) {
+    (void)userdata;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    char *contents = malloc((size_t)size + 1);
+    if (!contents) {
+        fclose(f);
+        return NULL;
+    }
+
+    size_t n = fread(contents, 1, (size_t)size, f);
+    contents[n] = '\0';
+    fclose(f);
+
+    if (len) *len = n;
+    return contents;
+}
+
+/* Temp files get the writer's pid and a per-process count, so threads
+ * and processes saving the same path never share one */
+static atomic_uint temp_count;
+
+bool pith_fs_temp_path(char *temp, size_t size, const char *path) {
+#ifdef _WIN32
+    long pid = (long)GetCurrentProcessId();
+#else
+    long pid = (long)getpid();
+#endif
+    int n = snprintf(temp, size, "%s.%ld.%u.tmp", path, pid,
+                     atomic_fetch_add(&temp_count, 1));
+    return n >= 0 && (size_t)n < size;
+}
+
+#ifndef _WIN32
+
+/* Saves run on I/O threads, where a signal can interrupt write */
+static bool write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/* Make a rename durable by syncing the directory that holds it */
+static void sync_parent(const char *path) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash == dir) {
+        dir[1] = '\0';
+    } else if (slash) {
+        *slash = '\0';
+    } else {
+        snprintf(dir, sizeof(dir), ".");
+    }
+    int fd = open(dir, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+/* Write a temp file next to the target and rename it over the target, so
+ * readers and crashes see the old file or the new one, never a torn one */
+static bool native_write_file(const char *path, const char *contents, size_t len,
+                              int flags, void *userdata) {
+    (void)userdata;
+
+    /* Replace what a symlink points at, not the link */
+    char target[PATH_MAX];
+    struct stat st;
+    bool exists = lstat(path, &st) == 0;
+    if (exists && S_ISLNK(st.st_mode) && realpath(path, target)) {
+        path = target;
+        exists = stat(path, &st) == 0;
+    }
+
+    char temp[PATH_MAX + 64];
+    if (!pith_fs_temp_path(temp, sizeof(temp), path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    int fd = open(temp, O_WRONLY | O_CREAT | O_EXCL, exists ? (st.st_mode & 07777) : 0666);
+    if (fd < 0) return false;
+
+    bool ok = write_all(fd, contents, len);
+    if (ok && (flags & PITH_WRITE_SYNC)) ok = fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(temp, path) == 0;
+    if (!ok) {
+        int err = errno;
+        unlink(temp);
+        errno = err;
+        return false;
+    }
+    if (flags & PITH_WRITE_SYNC) sync_parent(path);
+    return true;
+}
+
+static bool native_append_file(const char *path, const char *contents, size_t len, void *userdata) {
+    (void)userdata;
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+    if (fd < 0) return false;
+    bool ok = write_all(fd, contents, len);
+    return close(fd) == 0 && ok;
+}
+
+#else /* _WIN32 */
+
+static bool native_write_file(const char *path, const char *contents, size_t len,
+                              int flags, void *userdata) {
+    (void)userdata;
+
+    char temp[MAX_PATH + 64];
+    if (!pith_fs_temp_path(temp, sizeof(temp), path)) return false;
+    FILE *f = fopen(temp, "wb");
+    if (!f) return false;
+
+    bool ok = fwrite(contents, 1, len, f) == len && fflush(f) == 0;
+    if (ok && (flags & PITH_WRITE_SYNC)) ok = _commit(_fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    DWORD move = MOVEFILE_REPLACE_EXISTING;
+    if (flags & PITH_WRITE_SYNC) move |= MOVEFILE_WRITE_THROUGH;
+    ok = ok && MoveFileExA(temp, path, move);
+    if (!ok) remove(temp);
+    return ok;
+}
+
+static bool native_append_file(const char *path, const char *contents, size_t len, void *userdata) {
+    (void)userdata;
+    FILE *f = fopen(path, "ab");
+    if (!f) return false;
+    size_t written = fwrite(contents, 1, len, f);
+    bool closed = fclose(f) == 0;
+    return written == len && closed;
+}
+
+#endif
+
+static bool native_file_exists(const char *path, void *userdata) {
+    (void)userdata;
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+static bool native_stat_file(const char *path, PithFileStat *out, void *userdata) {
+    (void)userdata;
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+
+    out->is_dir = S_ISDIR(st.st_mode);
+    out->size = out->is_dir ? 0 : (size_t)st.st_size;
+    out->modified = (double)st.st_mtime;
+    return true;
+}
+
+#ifndef _WIN32
+
+static const char *const empty_map = "";
+
+static const char* native_map_file(const char *path, size_t *len, void *userdata) {
+    (void)userdata;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || S_ISDIR(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+    *len = (size_t)st.st_size;
+    if (*len == 0) {
+        /* mmap rejects empty ranges */
+        close(fd);
+        return empty_map;
+    }
+
+    void *map = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+static void native_unmap_file(const char *data, size_t len, void *userdata) {
+    (void)userdata;
+    if (data && data != empty_map) munmap((void *)data, len);
+}
+
+#else /* _WIN32: no mmap, read a private copy */
+
+static const char* native_map_file(const char *path, size_t *len, void *userdata) {
+    return native_read_file(path, len, userdata);
+}
+
+static void native_unmap_file(const char *data, size_t len, void *userdata) {
+    (void)len; (void)userdata;
+    free((void *)data);
+}
+
+#endif
+
+static char** native_list_dir(const char *path, size_t *count, void *userdata) {
+    (void)userdata;
+
+    *count = 0;
+
+#ifdef _WIN32
+    char search_path[512];
+    snprintf(search_path, sizeof(search_path), "%s\\*", path);
+
+    WIN32_FIND_DATA fd;
+    HANDLE h = FindFirstFile(search_path, &fd);
+    if (h == INVALID_HANDLE_VALUE) return NULL;
+
+    size_t capacity = 16;
+    char **entries = malloc(capacity * sizeof(char*));
+
+    do {
+        if (strcmp(fd.cFileName, ".") == 0 || strcmp(fd.cFileName, "..") == 0) {
+            continue;
+        }
+
+        if (*count >= capacity) {
+            capacity *= 2;
+            entries = realloc(entries, capacity * sizeof(char*));
+        }
+
+        char full_path[512];
+        snprintf(full_path, sizeof(full_path), "%s\\%s", path, fd.cFileName);
+        entries[(*count)++] = strdup(full_path);
+
+    } while (FindNextFile(h, &fd));
+
+    FindClose(h);
+    return entries;
+#else
+    DIR *dir = opendir(path);
+    if (!dir) return NULL;
+
+    size_t capacity = 16;
+    char **entries = malloc(capacity * sizeof(char*));
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+
+        if (*count >= capacity) {
+            capacity *= 2;
+            entries = realloc(entries, capacity * sizeof(char*));
+        }
+
+        char full_path[512];
+        snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
+        entries[(*count)++] = strdup(full_path);
+    }
+
+    closedir(dir);
+    return entries;
+#endif
+}
+
+PithFileSystem pith_fs_native(void) {
+    return (PithFileSystem){
+        .read_file = native_read_file,
+        .write_file = native_write_file,
+        .file_exists = native_file_exists,
+        .list_dir = native_list_dir,
+        .append_file = native_append_file,
+        .stat_file = native_stat_file,
+        .map_file = native_map_file,
+        .unmap_file = native_unmap_file,
+    };
+}
+
+/* ========================================================================
+   IN-MEMORY FILE SYSTEM
+   ======================================================================== */
+
+/* File contents, shared by the store and any mappings of it */
+typedef struct {
+    atomic_size_t refs;
+    size_t len;
+    char data[];                /* len bytes and a NUL */
+} MemBlob;
+
+typedef struct {
+    char *path;
+    MemBlob *blob;
+    double modified;
+} MemFile;
+
+struct PithMemFS {
+    pthread_mutex_t lock;
+    MemFile *files;
+    size_t count;
+    size_t capacity;
+};
+
+static MemBlob* blob_new(size_t len) {
+    MemBlob *blob = malloc(sizeof(MemBlob) + len + 1);
+    atomic_init(&blob->refs, 1);
+    blob->len = len;
+    blob->data[len] = '\0';
+    return blob;
+}
+
+static void blob_release(MemBlob *blob) {
+    if (blob && atomic_fetch_sub(&blob->refs, 1) == 1) free(blob);
+}
+
+/* Called with the lock held */
+static MemFile* memfs_find(PithMemFS *mfs, const char *path) {
+    for (size_t i = 0; i < mfs->count; i++) {
+        if (strcmp(mfs->files[i].path, path) == 0) return &mfs->files[i];
+    }
+    return NULL;
+}
+
+/* Does some file live below dir? Called with the lock held. */
+static bool memfs_is_dir(PithMemFS *mfs, const char *dir) {
+    size_t n = strlen(dir);
+    for (size_t i = 0; i < mfs->count; i++) {
+        const char *p = mfs->files[i].path;
+        if (strncmp(p, dir, n) == 0 && p[n] == '/') return true;
+    }
+    return false;
+}
+
+/* Replace (or create) the file at path, taking over blob. Called with the
+ * lock held. */
+static void memfs_store(PithMemFS *mfs, const char *path, MemBlob *blob) {
+    MemFile *file = memfs_find(mfs, path);
+    if (!file) {
+        if (mfs->count >= mfs->capacity) {
+            mfs->capacity = mfs->capacity ? mfs->capacity * 2 : 16;
+            mfs->files = realloc(mfs->files, mfs->capacity * sizeof(MemFile));
+        }
+        file = &mfs->files[mfs->count++];
+        file->path = strdup(path);
+        file->blob = NULL;
+    }
+    blob_release(file->blob);
+    file->blob = blob;
+    file->modified = (double)time(NULL);
+}
+
+static char* memfs_read_file(const char *path, size_t *len, void *userdata) {
+    PithMemFS *mfs = userdata;
+    char *contents = NULL;
+
+    pthread_mutex_lock(&mfs->lock);
+    MemFile *file = memfs_find(mfs, path);
+    if (file) {
+        contents = malloc(file->blob->len + 1);
+        memcpy(contents, file->blob->data, file->blob->len + 1);
+        if (len) *len = file->blob->len;
+    }
+    pthread_mutex_unlock(&mfs->lock);
+    return contents;
+}
+
+static bool memfs_write_file(const char *path, const char *contents, size_t len,
+                             int flags, void *userdata) {
+    (void)flags;
+    PithMemFS *mfs = userdata;
+    MemBlob *blob = blob_new(len);
+    memcpy(blob->data, contents, len);
+
+    pthread_mutex_lock(&mfs->lock);
+    memfs_store(mfs, path, blob);
+    pthread_mutex_unlock(&mfs->lock);
+    return true;
+}
+
+static bool memfs_append_file(const char *path, const char *contents, size_t len, void *userdata) {
+    PithMemFS *mfs = userdata;
+
+    pthread_mutex_lock(&mfs->lock);
+    MemFile *file = memfs_find(mfs, path);
+    size_t old_len = file ? file->blob->len : 0;
+    MemBlob *blob = blob_new(old_len + len);
+    if (file) memcpy(blob->data, file->blob->data, old_len);
+    memcpy(blob->data + old_len, contents, len);
+    memfs_store(mfs, path, blob);
+    pthread_mutex_unlock(&mfs->lock);
+    return true;
+}
+
+static bool memfs_file_exists(const char *path, void *userdata) {
+    PithMemFS *mfs = userdata;
+    pthread_mutex_lock(&mfs->lock);
+    bool exists = memfs_find(mfs, path) || memfs_is_dir(mfs, path);
+    pthread_mutex_unlock(&mfs->lock);
+    return exists;
+}
+
+static bool memfs_stat_file(const char *path, PithFileStat *st, void *userdata) {
+    PithMemFS *mfs = userdata;
+    bool found = true;
+
+    pthread_mutex_lock(&mfs->lock);
+    MemFile *file = memfs_find(mfs, path);
+    if (file) {
+        st->size = file->blob->len;
+        st->modified = file->modified;
+        st->is_dir = false;
+    } else if (memfs_is_dir(mfs, path)) {
+        st->size = 0;
+        st->modified = 0;
+        st->is_dir = true;
+    } else {
+        found = false;
+    }
+    pthread_mutex_unlock(&mfs->lock);
+    return found;
+}
+
+/* Mappings share the stored blob, so reading a file costs no copy */
+static const char* memfs_map_file(const char *path, size_t *len, void *userdata) {
+    PithMemFS *mfs = userdata;
+    const char *data = NULL;
+
+    pthread_mutex_lock(&mfs->lock);
+    MemFile *file = memfs_find(mfs, path);
+    if (file) {
+        atomic_fetch_add(&file->blob->refs, 1);
+        data = file->blob->data;
+        *len = file->blob->len;
+    }
+    pthread_mutex_unlock(&mfs->lock);
+    return data;
+}
+
+static void memfs_unmap_file(const char *data, size_t len, void *userdata) {
+    (void)len; (void)userdata;
+    if (data) blob_release((MemBlob *)(data - offsetof(MemBlob, data)));
+}
+
+/* Files and directories directly below path, as full paths */
+static char** memfs_list_dir(const char *path, size_t *count, void *userdata) {
+    PithMemFS *mfs = userdata;
+    size_t n = strlen(path);
+    size_t capacity = 16;
+    char **entries = NULL;
+    *count = 0;
+
+    pthread_mutex_lock(&mfs->lock);
+    for (size_t i = 0; i < mfs->count; i++) {
+        const char *p = mfs->files[i].path;
+        if (strncmp(p, path, n) != 0 || p[n] != '/') continue;
+
+        /* A deeper file names the directory it sits in */
+        const char *slash = strchr(p + n + 1, '/');
+        size_t len = slash ? (size_t)(slash - p) : strlen(p);
+        bool seen = false;
+        for (size_t j = 0; j < *count && !seen; j++) {
+            seen = strncmp(entries[j], p, len) == 0 && entries[j][len] == '\0';
+        }
+        if (seen) continue;
+
+        if (!entries) entries = malloc(capacity * sizeof(char*));
+        if (*count >= capacity) {
+            capacity *= 2;
+            entries = realloc(entries, capacity * sizeof(char*));
+        }
+        entries[(*count)++] = strndup(p, len);
+    }
+    pthread_mutex_unlock(&mfs->lock);
+
+    /* Directories only exist while they hold files, so an empty result
+     * means missing (NULL, like the native list) */
+    return entries;
+}
+
+PithMemFS* pith_memfs_new(void) {
+    PithMemFS *mfs = calloc(1, sizeof(PithMemFS));
+    pthread_mutex_init(&mfs->lock, NULL);
+    return mfs;
+}
+
+void pith_memfs_free(PithMemFS *mfs) {
+    if (!mfs) return;
+    for (size_t i = 0; i < mfs->count; i++) {
+        free(mfs->files[i].path);
+        blob_release(mfs->files[i].blob);
+    }
+    free(mfs->files);
+    pthread_mutex_destroy(&mfs->lock);
+    free(mfs);
+}
+
+PithFileSystem pith_memfs_filesystem(PithMemFS *mfs) {
+    return (PithFileSystem){
+        .read_file = memfs_read_file,
+        .write_file = memfs_write_file,
+        .file_exists = memfs_file_exists,
+        .list_dir = memfs_list_dir,
+        .append_file = memfs_append_file,
+        .stat_file = memfs_stat_file,
+        .map_file = memfs_map_file,
+        .unmap_file = memfs_unmap_file,
+        .userdata = mfs,
+    };
+}
+
+void pith_memfs_add(PithMemFS *mfs, const char *path, const char *data, size_t len) {
+    memfs_write_file(path, data, len, 0, mfs);
+}
+
+size_t pith_memfs_load_dir(PithMemFS *mfs, const char *dir) {
+    size_t count = 0;
+    char **entries = native_list_dir(dir, &count, NULL);
+    size_t loaded = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        PithFileStat st;
+        if (native_stat_file(entries[i], &st, NULL)) {
+            if (st.is_dir) {
+                loaded += pith_memfs_load_dir(mfs, entries[i]);
+            } else {
+                size_t len;
+                char *contents = native_read_file(entries[i], &len, NULL);
+                if (contents) {
+                    pith_memfs_add(mfs, entries[i], contents, len);
+                    loaded++;
+                }
+                free(contents);
+            }
+        }
+        free(entries[i]);
+    }
+    free(entries);
+    return loaded;
+}
@@ -0,0 +1,45 @@
+/*
+ * pith_fs.h - Bundled PithFileSystem implementations
+ *
+ * pith_fs_native() works on the real disk. A PithMemFS keeps every file
+ * in memory, so benchmarks and tests can run a program without disk
+ * noise, and embedders have a starting point for a read cache. Both are
+ * safe to call from several threads at once.
+ */
+
+#ifndef PITH_FS_H
+#define PITH_FS_H
+
+#include "pith_runtime.h"
+
+/* Callbacks for the disk (userdata is unused) */
+PithFileSystem pith_fs_native(void);
+
+/* Name a temp file next to path that no other thread or process is
+ * writing. Returns false if the name does not fit in size bytes. */
+bool pith_fs_temp_path(char *temp, size_t size, const char *path);
+
+/* ========================================================================
+   IN-MEMORY FILE SYSTEM
+
+   Files are flat byte blobs keyed by path; directories exist implicitly
+   whenever a file lives below them. A mapped file stays valid after it
+   is overwritten or the PithMemFS is freed, until it is unmapped.
+   ======================================================================== */
+
+typedef struct PithMemFS PithMemFS;
+
+PithMemFS* pith_memfs_new(void);
+void pith_memfs_free(PithMemFS *mfs);
+
+/* Callbacks reading and writing mfs */
+PithFileSystem pith_memfs_filesystem(PithMemFS *mfs);
+
+/* Store a copy of len bytes as the file at path, replacing any old one */
+void pith_memfs_add(PithMemFS *mfs, const char *path, const char *data, size_t len);
+
+/* Copy every file under a disk directory (recursively) into mfs under
+ * the same paths. Returns the number of files copied. */
+size_t pith_memfs_load_dir(PithMemFS *mfs, const char *dir);
+
+#endif /* PITH_FS_H */
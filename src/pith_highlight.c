@@ -0,0 +1,279 @@
+/*
+ * pith_highlight.c - Incremental syntax highlighting for text buffers
+ */
+
+#include "pith_highlight.h"
+#include "pith_runtime.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* ========================================================================
+   PITH GRAMMAR
+   Follows the rules of the runtime lexer (lexer_next). The only construct
+   that spans lines is a string, so the line state is just "in a string".
+   ======================================================================== */
+
+enum {
+    PITH_LEX_NORMAL = 0,
+    PITH_LEX_STRING = 1
+};
+
+static void emit_run(PithHighlightRun *runs, size_t max_runs, size_t *run_count,
+                     size_t start, size_t length, PithHighlightKind kind) {
+    if (length == 0) return;
+    if (*run_count < max_runs) {
+        runs[*run_count].start = start;
+        runs[*run_count].length = length;
+        runs[*run_count].kind = kind;
+    }
+    (*run_count)++;
+}
+
+/* Scan a string body starting at i; returns the index after the closing
+ * quote, or len if the string continues on the next line */
+static size_t scan_string(const char *line, size_t len, size_t i, bool *closed) {
+    while (i < len) {
+        if (line[i] == '\\') {
+            i += 2;
+            continue;
+        }
+        if (line[i] == '"') {
+            *closed = true;
+            return i + 1;
+        }
+        i++;
+    }
+    *closed = false;
+    return len;
+}
+
+static uint8_t pith_lex_line(const char *line, size_t len, uint8_t state,
+                             PithHighlightRun *runs, size_t max_runs,
+                             size_t *run_count) {
+    size_t i = 0;
+
+    /* Finish a string carried over from the previous line */
+    if (state == PITH_LEX_STRING) {
+        bool closed;
+        i = scan_string(line, len, 0, &closed);
+        emit_run(runs, max_runs, run_count, 0, i, HL_STRING);
+        if (!closed) return PITH_LEX_STRING;
+    }
+
+    while (i < len) {
+        char c = line[i];
+        size_t start = i;
+
+        if (c == ' ' || c == '\t' || c == '\r' || c == ',') {
+            i++;
+            continue;
+        }
+
+        if (c == '#') {
+            emit_run(runs, max_runs, run_count, start, len - start, HL_COMMENT);
+            break;
+        }
+
+        if (c == ':' || c == '.' || c == '[' || c == ']' || c == '{' || c == '}') {
+            emit_run(runs, max_runs, run_count, start, 1, HL_PUNCTUATION);
+            i++;
+            continue;
+        }
+
+        if (c == '"') {
+            bool closed;
+            i = scan_string(line, len, i + 1, &closed);
+            emit_run(runs, max_runs, run_count, start, i - start, HL_STRING);
+            if (!closed) return PITH_LEX_STRING;
+            continue;
+        }
+
+        if (isdigit((unsigned char)c) ||
+            (c == '-' && i + 1 < len && isdigit((unsigned char)line[i + 1]))) {
+            i++;
+            while (i < len && isdigit((unsigned char)line[i])) i++;
+            if (i < len && line[i] == '.') {
+                i++;
+                while (i < len && isdigit((unsigned char)line[i])) i++;
+            }
+            emit_run(runs, max_runs, run_count, start, i - start, HL_NUMBER);
+            continue;
+        }
+
+        if (pith_is_word_char(c)) {
+            while (i < len && pith_is_word_char(line[i])) i++;
+            PithHighlightKind kind = HL_PLAIN;
+            if (pith_keyword_type(line + start, i - start) != TOK_WORD) {
+                kind = HL_KEYWORD;
+            } else if (i < len && line[i] == ':') {
+                kind = HL_DEFINITION;
+            }
+            emit_run(runs, max_runs, run_count, start, i - start, kind);
+            continue;
+        }
+
+        /* Anything else (the lexer would reject it) is left plain */
+        i++;
+        while (i < len && !pith_is_word_char(line[i]) && line[i] != ' ' &&
+               line[i] != '"' && line[i] != '#') {
+            i++;
+        }
+        emit_run(runs, max_runs, run_count, start, i - start, HL_PLAIN);
+    }
+
+    return PITH_LEX_NORMAL;
+}
+
+static const PithGrammar grammars[] = {
+    { "pith", pith_lex_line },
+};
+
+const PithGrammar* pith_grammar_find(const char *name) {
+    for (size_t i = 0; i < sizeof(grammars) / sizeof(grammars[0]); i++) {
+        if (strcmp(grammars[i].name, name) == 0) return &grammars[i];
+    }
+    return NULL;
+}
+
+/* ========================================================================
+   HIGHLIGHTER
+   ======================================================================== */
+
+struct PithHighlighter {
+    const PithGrammar *grammar;
+    uint8_t *states;        /* State at the start of each line */
+    size_t valid;           /* states[0..valid) are up to date */
+    size_t capacity;
+    size_t reuse_start;     /* states[reuse_start..reuse_end) predate the */
+    size_t reuse_end;       /* last edit and are reused once lexing converges */
+
+    PithGapBuffer *buffer;  /* Buffer the states describe ... */
+    size_t revision;        /* ... at this revision */
+    size_t line_count;
+
+    char *scratch;          /* Text of the line being lexed */
+    size_t scratch_capacity;
+};
+
+PithHighlighter* pith_highlighter_new(const PithGrammar *grammar) {
+    PithHighlighter *hl = calloc(1, sizeof(PithHighlighter));
+    hl->grammar = grammar;
+    return hl;
+}
+
+void pith_highlighter_free(PithHighlighter *hl) {
+    if (!hl) return;
+    free(hl->states);
+    free(hl->scratch);
+    free(hl);
+}
+
+const PithGrammar* pith_highlighter_grammar(PithHighlighter *hl) {
+    return hl->grammar;
+}
+
+static void highlighter_reserve(PithHighlighter *hl, size_t count) {
+    if (count <= hl->capacity) return;
+    size_t cap = hl->capacity ? hl->capacity : 256;
+    while (cap < count) cap *= 2;
+    hl->states = realloc(hl->states, cap);
+    hl->capacity = cap;
+}
+
+/* Bring the cached states up to date with the buffer's edits */
+static void highlighter_sync(PithHighlighter *hl, PithGapBuffer *gb) {
+    size_t start, end;
+
+    if (hl->buffer != gb) {
+        hl->buffer = gb;
+        hl->valid = 0;
+        hl->reuse_start = hl->reuse_end = 0;
+        pith_gapbuf_changes_since(gb, gb->revision, &start, &end);
+    } else if (hl->revision != gb->revision) {
+        bool known = pith_gapbuf_changes_since(gb, hl->revision, &start, &end);
+        size_t old_valid = hl->valid;
+        hl->reuse_start = hl->reuse_end = 0;
+
+        if (!known) {
+            hl->valid = 0;
+        } else if (start <= end) {
+            size_t first = pith_gapbuf_pos_line(gb, start);
+            size_t last = pith_gapbuf_pos_line(gb, end);
+            size_t count = pith_gapbuf_line_count(gb);
+
+            /* Line i after the edit was line i - delta before it */
+            ptrdiff_t delta = (ptrdiff_t)count - (ptrdiff_t)hl->line_count;
+            ptrdiff_t from = (ptrdiff_t)last + 1 - delta;
+            highlighter_reserve(hl, count + 1);
+            if (from > (ptrdiff_t)first && from < (ptrdiff_t)old_valid) {
+                size_t n = old_valid - (size_t)from;
+                if (last + 1 + n > count) n = count - (last + 1);
+                memmove(hl->states + last + 1, hl->states + from, n);
+                hl->reuse_start = last + 1;
+                hl->reuse_end = last + 1 + n;
+            }
+            if (hl->valid > first + 1) hl->valid = first + 1;
+        }
+    }
+
+    hl->revision = gb->revision;
+    hl->line_count = pith_gapbuf_line_count(gb);
+}
+
+/* Copy a line into the scratch buffer */
+static const char* highlighter_line_text(PithHighlighter *hl, PithGapBuffer *gb,
+                                         size_t line, size_t *out_len) {
+    size_t start = pith_gapbuf_line_start(gb, line);
+    size_t end = pith_gapbuf_line_end(gb, line);
+    size_t len = end - start;
+    if (len + 1 > hl->scratch_capacity) {
+        hl->scratch_capacity = len + 1 > 256 ? len + 1 : 256;
+        hl->scratch = realloc(hl->scratch, hl->scratch_capacity);
+    }
+    pith_gapbuf_copy_range(gb, start, end, hl->scratch);
+    hl->scratch[len] = '\0';
+    *out_len = len;
+    return hl->scratch;
+}
+
+/* Lex forward until the state at the start of `line` is known */
+static void highlighter_ensure(PithHighlighter *hl, PithGapBuffer *gb, size_t line) {
+    highlighter_reserve(hl, hl->line_count + 1);
+    if (hl->valid == 0) {
+        hl->states[0] = PITH_LEX_NORMAL;
+        hl->valid = 1;
+    }
+
+    while (hl->valid <= line) {
+        size_t prev = hl->valid - 1;
+        size_t len, ignored = 0;
+        const char *text = highlighter_line_text(hl, gb, prev, &len);
+        uint8_t state = hl->grammar->lex_line(text, len, hl->states[prev], NULL, 0, &ignored);
+
+        /* Converged with the states from before the edit: reuse the rest */
+        if (hl->valid >= hl->reuse_start && hl->valid < hl->reuse_end &&
+            hl->states[hl->valid] == state) {
+            hl->valid = hl->reuse_end;
+            hl->reuse_start = hl->reuse_end = 0;
+            continue;
+        }
+
+        hl->states[hl->valid++] = state;
+        if (hl->valid >= hl->reuse_end) hl->reuse_start = hl->reuse_end = 0;
+    }
+}
+
+size_t pith_highlight_line(PithHighlighter *hl, PithGapBuffer *gb, size_t line,
+                           PithHighlightRun *runs, size_t max_runs) {
+    if (!hl || !gb) return 0;
+    highlighter_sync(hl, gb);
+    if (line >= hl->line_count) return 0;
+
+    highlighter_ensure(hl, gb, line);
+
+    size_t len, count = 0;
+    const char *text = highlighter_line_text(hl, gb, line, &len);
+    hl->grammar->lex_line(text, len, hl->states[line], runs, max_runs, &count);
+    return count;
+}
@@ -0,0 +1,74 @@
+/*
+ * pith_highlight.h - Incremental syntax highlighting for text buffers
+ *
+ * A highlighter colors one line at a time. It caches the lexer state at
+ * the start of every line (e.g. "inside a string"), so coloring a line
+ * only needs that line's text. After an edit, lines are re-lexed from
+ * the first edited line until the state at a line start matches the
+ * cached state again; everything after that point is reused.
+ */
+
+#ifndef PITH_HIGHLIGHT_H
+#define PITH_HIGHLIGHT_H
+
+#include "pith_types.h"
+
+/* ========================================================================
+   TOKEN CLASSES
+   ======================================================================== */
+
+typedef enum {
+    HL_PLAIN,
+    HL_COMMENT,
+    HL_STRING,
+    HL_NUMBER,
+    HL_KEYWORD,
+    HL_DEFINITION,      /* name: at the start of a slot or dictionary */
+    HL_PUNCTUATION,
+    HL_KIND_COUNT
+} PithHighlightKind;
+
+/* A colored run within one line (byte offsets from the line start) */
+typedef struct {
+    size_t start;
+    size_t length;
+    PithHighlightKind kind;
+} PithHighlightRun;
+
+/* ========================================================================
+   GRAMMARS
+   ======================================================================== */
+
+/* Lex one line that starts in `state`. Every run is counted in run_count,
+ * but only the first max_runs are stored. Returns the state at the start
+ * of the next line. */
+typedef uint8_t (*PithLexLine)(const char *line, size_t len, uint8_t state,
+                               PithHighlightRun *runs, size_t max_runs,
+                               size_t *run_count);
+
+typedef struct {
+    const char *name;
+    PithLexLine lex_line;
+} PithGrammar;
+
+/* Look up a grammar by name (NULL if unknown) */
+const PithGrammar* pith_grammar_find(const char *name);
+
+/* ========================================================================
+   HIGHLIGHTER
+   ======================================================================== */
+
+#define PITH_HIGHLIGHT_MAX_RUNS 256
+
+PithHighlighter* pith_highlighter_new(const PithGrammar *grammar);
+void pith_highlighter_free(PithHighlighter *hl);
+
+/* Grammar the highlighter was created with */
+const PithGrammar* pith_highlighter_grammar(PithHighlighter *hl);
+
+/* Get the runs of one line of the buffer. Returns the line's run count,
+ * which can exceed max_runs; only the first max_runs runs are stored. */
+size_t pith_highlight_line(PithHighlighter *hl, PithGapBuffer *gb, size_t line,
+                           PithHighlightRun *runs, size_t max_runs);
+
+#endif /* PITH_HIGHLIGHT_H */
@@ -2,19 +2,34 @@
  * pith_runtime.c - Platform-independent Pith interpreter
  */
 
+#define _DEFAULT_SOURCE
+
 #include "pith_runtime.h"
 #include "pith_ui.h"
+#include "pith_highlight.h"
+#include "pith_wrap.h"
+#include "pith_cache.h"
+#include "pith_string.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <ctype.h>
 #include <math.h>
-#include <dirent.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
 
 /* Forward declarations */
 static PithDict* pith_find_dict(PithRuntime *rt, const char *name);
+static void save_finished(PithRuntime *rt, const char *path, int err);
+static double saves_next_due(PithRuntime *rt);
+static PithSeq* seq_retain(PithSeq *seq);
+static void seq_release(PithSeq *seq);
 
 /* ========================================================================
    MEMORY HELPERS
@@ -53,24 +68,56 @@ const char* pith_get_error(PithRuntime *rt) {
    STACK OPERATIONS
    ======================================================================== */
 
-/* Global debug flag - declared in main.c */
-extern bool g_debug;
-
-bool pith_push(PithRuntime *rt, PithValue value) {
-    if (rt->stack_top >= PITH_STACK_MAX) {
-        pith_error(rt, "Stack overflow");
-        if (g_debug) {
-            fprintf(stderr, "[DEBUG] Stack overflow! Dumping stack:\n");
-            for (size_t i = 0; i < rt->stack_top && i < 20; i++) {
-                fprintf(stderr, "  [%zu] type=%d\n", i, rt->stack[i].type);
+/* Pushes only compare against stack_limit. It is the capacity, or while
+ * profiling the current peak, so growth and new high-water marks are the
+ * only pushes that get here. */
+static void stack_update_limit(PithRuntime *rt) {
+    rt->stack_limit = rt->stack_capacity;
+    if (rt->stack_profile && rt->stack_peak < rt->stack_limit) {
+        rt->stack_limit = rt->stack_peak;
+    }
+}
+
+static bool stack_reserve(PithRuntime *rt) {
+    if (rt->stack_top >= rt->stack_capacity) {
+        if (rt->stack_capacity >= PITH_STACK_MAX) {
+            pith_error(rt, "Stack overflow: %zu values in '%s'", rt->stack_top,
+                       rt->exec_slot ? rt->exec_slot : "(top level)");
+            if (rt->debug) {
+                fprintf(stderr, "[DEBUG] Stack overflow! Top of stack:\n");
+                for (size_t i = 0; i < rt->stack_top && i < 20; i++) {
+                    size_t at = rt->stack_top - 1 - i;
+                    fprintf(stderr, "  [%zu] type=%d\n", at, rt->stack[at].type);
+                }
             }
+            return false;
         }
+        size_t capacity = rt->stack_capacity ? rt->stack_capacity * 2 : PITH_STACK_INITIAL;
+        if (capacity > PITH_STACK_MAX) capacity = PITH_STACK_MAX;
+        rt->stack = realloc(rt->stack, capacity * sizeof(PithValue));
+        rt->stack_capacity = capacity;
+    }
+    if (rt->stack_profile && rt->stack_top >= rt->stack_peak) {
+        rt->stack_peak = rt->stack_top + 1;
+    }
+    stack_update_limit(rt);
+    return true;
+}
+
+bool pith_push(PithRuntime *rt, PithValue value) {
+    if (rt->stack_top >= rt->stack_limit && !stack_reserve(rt)) {
         return false;
     }
     rt->stack[rt->stack_top++] = value;
     return true;
 }
 
+void pith_stack_profile(PithRuntime *rt, bool enable) {
+    rt->stack_profile = enable;
+    rt->stack_peak = rt->stack_top;
+    stack_update_limit(rt);
+}
+
 PithValue pith_pop(PithRuntime *rt) {
     if (rt->stack_top == 0) {
         pith_error(rt, "Stack underflow");
@@ -91,6 +138,21 @@ bool pith_stack_has(PithRuntime *rt, size_t n) {
     return rt->stack_top >= n;
 }
 
+/* Move the values above `base` into a new array, bottom first. The
+ * stack segment is already in array order, so it is copied in one go. */
+static PithArray* stack_take_array(PithRuntime *rt, size_t base) {
+    PithArray *arr = malloc(sizeof(PithArray));
+    size_t count = rt->stack_top > base ? rt->stack_top - base : 0;
+    arr->items = count ? malloc(count * sizeof(PithValue)) : NULL;
+    arr->length = count;
+    arr->capacity = count;
+    if (count > 0) {
+        memcpy(arr->items, &rt->stack[base], count * sizeof(PithValue));
+        rt->stack_top = base;
+    }
+    return arr;
+}
+
 /* ========================================================================
    ARRAY HELPERS
    ======================================================================== */
@@ -130,6 +192,49 @@ PithValue pith_array_get(PithArray *array, size_t index) {
     return array->items[index];
 }
 
+/* ========================================================================
+   UTF-8 HELPERS
+   ======================================================================== */
+
+/* A codepoint starts at every byte that is not a continuation byte */
+#define UTF8_IS_CONT(c) ((((unsigned char)(c)) & 0xC0) == 0x80)
+
+/* Encode a codepoint, returning the number of bytes written (1-4) */
+size_t pith_utf8_encode(uint32_t codepoint, char *out) {
+    if (codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        codepoint = 0xFFFD;  /* Replacement character */
+    }
+    if (codepoint < 0x80) {
+        out[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = (char)(0xC0 | (codepoint >> 6));
+        out[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        out[0] = (char)(0xE0 | (codepoint >> 12));
+        out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (codepoint >> 18));
+    out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+/* Count the codepoints in len bytes of str */
+size_t pith_utf8_count(const char *str, size_t len) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (!UTF8_IS_CONT(str[i])) count++;
+    }
+    return count;
+}
+
 /* ========================================================================
    GAP BUFFER HELPERS
    ======================================================================== */
@@ -137,6 +242,35 @@ PithValue pith_array_get(PithArray *array, size_t index) {
 #define GAP_BUFFER_INITIAL_SIZE 64
 #define GAP_BUFFER_MIN_GAP 32
 
+/* Line index for a gap buffer, built on first line query and then kept
+ * up to date by insert/delete. Edits confined to one line only touch
+ * that line's column count; the start offsets of the lines after it are
+ * shifted lazily (shift_line/shift) until an edit lands on another line.
+ */
+struct PithLineIndex {
+    size_t *starts;         /* Byte offset where each line begins */
+    size_t *columns;        /* Codepoints in each line (excluding newline) */
+    size_t count;           /* Number of lines (always >= 1) */
+    size_t capacity;
+    size_t shift_line;      /* Starts after this line are stale ... */
+    ptrdiff_t shift;        /* ... by this many bytes */
+
+    /* Byte offset of every column of one line (map[col], col <= columns) */
+    size_t *map;
+    size_t map_capacity;
+    size_t map_line;
+    size_t map_revision;
+    bool map_valid;
+};
+
+static void pith_lines_free(PithLineIndex *li) {
+    if (!li) return;
+    free(li->starts);
+    free(li->columns);
+    free(li->map);
+    free(li);
+}
+
 PithGapBuffer* pith_gapbuf_new(void) {
     PithGapBuffer *gb = malloc(sizeof(PithGapBuffer));
     gb->capacity = GAP_BUFFER_INITIAL_SIZE;
@@ -144,6 +278,13 @@ PithGapBuffer* pith_gapbuf_new(void) {
     gb->gap_start = 0;
     gb->gap_end = gb->capacity;
     gb->scroll_offset = 0;
+    gb->revision = 0;
+    gb->lines = NULL;
+    gb->cursors = NULL;
+    gb->cursor_count = 0;
+    gb->edit_log = NULL;
+    gb->highlighter = NULL;
+    gb->wrap = NULL;
     return gb;
 }
 
@@ -156,6 +297,13 @@ PithGapBuffer* pith_gapbuf_from_string(const char *str) {
     gb->gap_start = 0;
     gb->gap_end = GAP_BUFFER_MIN_GAP;
     gb->scroll_offset = 0;
+    gb->revision = 0;
+    gb->lines = NULL;
+    gb->cursors = NULL;
+    gb->cursor_count = 0;
+    gb->edit_log = NULL;
+    gb->highlighter = NULL;
+    gb->wrap = NULL;
     if (len > 0) {
         memcpy(gb->buffer + gb->gap_end, str, len);
     }
@@ -164,6 +312,11 @@ PithGapBuffer* pith_gapbuf_from_string(const char *str) {
 
 void pith_gapbuf_free(PithGapBuffer *gb) {
     if (!gb) return;
+    pith_lines_free(gb->lines);
+    pith_highlighter_free(gb->highlighter);
+    pith_wrap_free(gb->wrap);
+    free(gb->cursors);
+    free(gb->edit_log);
     free(gb->buffer);
     free(gb);
 }
@@ -177,6 +330,17 @@ PithGapBuffer* pith_gapbuf_copy(PithGapBuffer *gb) {
     copy->gap_start = gb->gap_start;
     copy->gap_end = gb->gap_end;
     copy->scroll_offset = gb->scroll_offset;
+    copy->revision = gb->revision;
+    copy->lines = NULL;  /* Rebuilt on demand */
+    copy->edit_log = NULL;  /* Consumers of the copy start over */
+    copy->highlighter = NULL;
+    copy->wrap = NULL;
+    copy->cursor_count = gb->cursor_count;
+    copy->cursors = NULL;
+    if (gb->cursor_count > 0) {
+        copy->cursors = malloc(gb->cursor_count * sizeof(size_t));
+        memcpy(copy->cursors, gb->cursors, gb->cursor_count * sizeof(size_t));
+    }
     return copy;
 }
 
@@ -185,11 +349,336 @@ size_t pith_gapbuf_length(PithGapBuffer *gb) {
     return gb->capacity - (gb->gap_end - gb->gap_start);
 }
 
+/* Byte at a content position (caller checks bounds) */
+static inline char gapbuf_byte(PithGapBuffer *gb, size_t pos) {
+    return pos < gb->gap_start ? gb->buffer[pos]
+                               : gb->buffer[gb->gap_end + (pos - gb->gap_start)];
+}
+
+/* Count newlines and codepoints (excluding newlines) in [start, end) */
+static void gapbuf_scan_range(PithGapBuffer *gb, size_t start, size_t end,
+                              size_t *newlines, size_t *columns) {
+    size_t nl = 0, cols = 0;
+    for (size_t pos = start; pos < end; pos++) {
+        char c = gapbuf_byte(gb, pos);
+        if (c == '\n') nl++;
+        else if (!UTF8_IS_CONT(c)) cols++;
+    }
+    if (newlines) *newlines = nl;
+    if (columns) *columns = cols;
+}
+
 /* Get the gap size */
 static size_t pith_gapbuf_gap_size(PithGapBuffer *gb) {
     return gb->gap_end - gb->gap_start;
 }
 
+/* ------------------------------------------------------------------------
+   Line index
+   ------------------------------------------------------------------------ */
+
+static void lines_reserve(PithLineIndex *li, size_t count) {
+    if (count <= li->capacity) return;
+    size_t cap = li->capacity ? li->capacity : 64;
+    while (cap < count) cap *= 2;
+    li->starts = realloc(li->starts, cap * sizeof(size_t));
+    li->columns = realloc(li->columns, cap * sizeof(size_t));
+    li->capacity = cap;
+}
+
+static inline size_t lines_start(PithLineIndex *li, size_t line) {
+    size_t start = li->starts[line];
+    if (line > li->shift_line) start += li->shift;
+    return start;
+}
+
+/* Apply the pending shift to every line after shift_line */
+static void lines_flush(PithLineIndex *li) {
+    if (li->shift == 0) return;
+    for (size_t i = li->shift_line + 1; i < li->count; i++) {
+        li->starts[i] += li->shift;
+    }
+    li->shift = 0;
+}
+
+/* Shift the starts of all lines after line by delta bytes */
+static void lines_shift(PithLineIndex *li, size_t line, ptrdiff_t delta) {
+    if (li->shift != 0 && li->shift_line != line) lines_flush(li);
+    li->shift_line = line;
+    li->shift += delta;
+}
+
+/* Find the line containing byte position pos */
+static size_t lines_find(PithLineIndex *li, size_t pos) {
+    size_t lo = 0, hi = li->count - 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo + 1) / 2;
+        if (lines_start(li, mid) <= pos) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+/* Get the line index, building it with one pass over the content */
+static PithLineIndex* gapbuf_lines(PithGapBuffer *gb) {
+    if (gb->lines) return gb->lines;
+
+    PithLineIndex *li = calloc(1, sizeof(PithLineIndex));
+    lines_reserve(li, 64);
+    li->starts[0] = 0;
+    li->count = 1;
+
+    size_t cols = 0;
+    size_t len = pith_gapbuf_length(gb);
+    for (size_t pos = 0; pos < len; pos++) {
+        char c = gapbuf_byte(gb, pos);
+        if (c == '\n') {
+            li->columns[li->count - 1] = cols;
+            lines_reserve(li, li->count + 1);
+            li->starts[li->count++] = pos + 1;
+            cols = 0;
+        } else if (!UTF8_IS_CONT(c)) {
+            cols++;
+        }
+    }
+    li->columns[li->count - 1] = cols;
+
+    gb->lines = li;
+    return li;
+}
+
+/* Update the index after len bytes of str were inserted at pos */
+static void lines_note_insert(PithGapBuffer *gb, size_t pos, const char *str, size_t len) {
+    PithLineIndex *li = gb->lines;
+    if (!li) return;
+
+    size_t line = lines_find(li, pos);
+    size_t newlines = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] == '\n') newlines++;
+    }
+
+    if (newlines == 0) {
+        li->columns[line] += pith_utf8_count(str, len);
+        lines_shift(li, line, (ptrdiff_t)len);
+        return;
+    }
+
+    /* The line is split: its head keeps the line number, the inserted
+     * lines follow, and the old tail ends up on the last new line */
+    lines_flush(li);
+    size_t head_cols;
+    gapbuf_scan_range(gb, lines_start(li, line), pos, NULL, &head_cols);
+    size_t tail_cols = li->columns[line] - head_cols;
+
+    lines_reserve(li, li->count + newlines);
+    size_t after = li->count - line - 1;
+    memmove(li->starts + line + 1 + newlines, li->starts + line + 1, after * sizeof(size_t));
+    memmove(li->columns + line + 1 + newlines, li->columns + line + 1, after * sizeof(size_t));
+    li->count += newlines;
+    for (size_t i = line + 1 + newlines; i < li->count; i++) {
+        li->starts[i] += len;
+    }
+
+    size_t cur = line;
+    size_t seg = 0;
+    size_t cols = head_cols;
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] != '\n') continue;
+        li->columns[cur] = cols + pith_utf8_count(str + seg, i - seg);
+        cur++;
+        li->starts[cur] = pos + i + 1;
+        seg = i + 1;
+        cols = 0;
+    }
+    li->columns[cur] = pith_utf8_count(str + seg, len - seg) + tail_cols;
+}
+
+/* Update the index before the bytes [start, end) are deleted */
+static void lines_note_delete(PithGapBuffer *gb, size_t start, size_t end) {
+    PithLineIndex *li = gb->lines;
+    if (!li || start >= end) return;
+
+    size_t line = lines_find(li, start);
+    size_t newlines, cols;
+    gapbuf_scan_range(gb, start, end, &newlines, &cols);
+
+    if (newlines == 0) {
+        li->columns[line] -= cols;
+        lines_shift(li, line, -(ptrdiff_t)(end - start));
+        return;
+    }
+
+    /* Lines line..last are joined into one */
+    lines_flush(li);
+    size_t last = line + newlines;
+    size_t head_cols, cut_cols;
+    gapbuf_scan_range(gb, lines_start(li, line), start, NULL, &head_cols);
+    gapbuf_scan_range(gb, lines_start(li, last), end, NULL, &cut_cols);
+    li->columns[line] = head_cols + (li->columns[last] - cut_cols);
+
+    size_t after = li->count - last - 1;
+    memmove(li->starts + line + 1, li->starts + last + 1, after * sizeof(size_t));
+    memmove(li->columns + line + 1, li->columns + last + 1, after * sizeof(size_t));
+    li->count -= newlines;
+    for (size_t i = line + 1; i < li->count; i++) {
+        li->starts[i] -= end - start;
+    }
+}
+
+/* Update the index after an edit replaced bytes within lines first..last
+ * (numbered before the edit, with the index flushed) and changed the
+ * content length by delta. Only those lines are rescanned. */
+static void lines_note_replace(PithGapBuffer *gb, size_t first, size_t last, ptrdiff_t delta) {
+    PithLineIndex *li = gb->lines;
+    if (!li) return;
+
+    /* The region runs to the newline ending line last, or to the end */
+    bool to_end = last + 1 >= li->count;
+    size_t start = li->starts[first];
+    size_t end = to_end ? pith_gapbuf_length(gb)
+                        : (size_t)((ptrdiff_t)li->starts[last + 1] + delta);
+    size_t newlines;
+    gapbuf_scan_range(gb, start, end, &newlines, NULL);
+    size_t count = to_end ? newlines + 1 : newlines;
+
+    size_t old_count = last - first + 1;
+    lines_reserve(li, li->count - old_count + count);
+    size_t after = li->count - last - 1;
+    memmove(li->starts + first + count, li->starts + last + 1, after * sizeof(size_t));
+    memmove(li->columns + first + count, li->columns + last + 1, after * sizeof(size_t));
+    li->count = li->count - old_count + count;
+
+    size_t line = first;
+    size_t cols = 0;
+    li->starts[line] = start;
+    for (size_t pos = start; pos < end; pos++) {
+        char c = gapbuf_byte(gb, pos);
+        if (c == '\n') {
+            li->columns[line] = cols;
+            cols = 0;
+            if (line + 1 < first + count) li->starts[++line] = pos + 1;
+        } else if (!UTF8_IS_CONT(c)) {
+            cols++;
+        }
+    }
+    if (to_end) li->columns[line] = cols;
+    lines_shift(li, first + count - 1, delta);
+}
+
+/* Get the column map of a line, rebuilding it if the line or content changed */
+static size_t* lines_column_map(PithGapBuffer *gb, PithLineIndex *li, size_t line) {
+    if (li->map_valid && li->map_line == line && li->map_revision == gb->revision) {
+        return li->map;
+    }
+
+    size_t cols = li->columns[line];
+    if (cols + 1 > li->map_capacity) {
+        li->map_capacity = cols + 1 > 64 ? cols + 1 : 64;
+        li->map = realloc(li->map, li->map_capacity * sizeof(size_t));
+    }
+
+    size_t start = lines_start(li, line);
+    size_t pos = start;
+    for (size_t col = 0; col < cols; col++) {
+        li->map[col] = pos - start;
+        pos = pith_gapbuf_next_char(gb, pos);
+    }
+    li->map[cols] = pos - start;
+
+    li->map_line = line;
+    li->map_revision = gb->revision;
+    li->map_valid = true;
+    return li->map;
+}
+
+/* Log of recent edits, so views can update caches (highlighting, wrap
+ * layout) from just the changed range. The edit that produced revision r
+ * is kept in records[r % PITH_EDIT_LOG_SIZE]. */
+#define PITH_EDIT_LOG_SIZE 64
+
+typedef struct {
+    size_t pos;
+    size_t removed;
+    size_t inserted;
+} PithEditRecord;
+
+struct PithEditLog {
+    PithEditRecord records[PITH_EDIT_LOG_SIZE];
+    size_t start_revision;      /* Revision when logging started */
+};
+
+/* Record the edit that produced the current revision: removed bytes at
+ * pos were replaced by inserted bytes */
+static void gapbuf_log_edit(PithGapBuffer *gb, size_t pos, size_t removed, size_t inserted) {
+    if (!gb->edit_log) return;
+    PithEditRecord *r = &gb->edit_log->records[gb->revision % PITH_EDIT_LOG_SIZE];
+    r->pos = pos;
+    r->removed = removed;
+    r->inserted = inserted;
+}
+
+/* Get the byte range (in current content) covering every edit since
+ * revision `since`; start > end if there were none. Returns false when
+ * the edits are not known, and the caller must treat everything as
+ * changed. The first call on a buffer starts logging. */
+bool pith_gapbuf_changes_since(PithGapBuffer *gb, size_t since, size_t *start, size_t *end) {
+    *start = SIZE_MAX;
+    *end = 0;
+    if (!gb->edit_log) {
+        gb->edit_log = malloc(sizeof(PithEditLog));
+        gb->edit_log->start_revision = gb->revision;
+        return since == gb->revision;
+    }
+    if (since > gb->revision) return false;
+    if (since < gb->edit_log->start_revision) return false;
+    if (gb->revision - since > PITH_EDIT_LOG_SIZE) return false;
+
+    for (size_t rev = since + 1; rev <= gb->revision; rev++) {
+        PithEditRecord *r = &gb->edit_log->records[rev % PITH_EDIT_LOG_SIZE];
+        size_t edit_end = r->pos + r->inserted;
+        if (*start > *end) {
+            *start = r->pos;
+            *end = edit_end;
+            continue;
+        }
+        /* Carry the range so far through this edit, then add the edit */
+        if (*end >= r->pos + r->removed) *end = *end - r->removed + r->inserted;
+        else if (*end > r->pos) *end = edit_end;
+        if (*start >= r->pos + r->removed) *start = *start - r->removed + r->inserted;
+        else if (*start > r->pos) *start = r->pos;
+        if (r->pos < *start) *start = r->pos;
+        if (edit_end > *end) *end = edit_end;
+    }
+    return true;
+}
+
+/* Sort extra cursors and drop duplicates and any on the primary cursor */
+static void gapbuf_normalize_cursors(PithGapBuffer *gb) {
+    size_t *c = gb->cursors;
+    size_t n = gb->cursor_count;
+    for (size_t i = 1; i < n; i++) {
+        size_t v = c[i];
+        size_t j = i;
+        while (j > 0 && c[j - 1] > v) {
+            c[j] = c[j - 1];
+            j--;
+        }
+        c[j] = v;
+    }
+    size_t out = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (c[i] == gb->gap_start) continue;
+        if (out > 0 && c[out - 1] == c[i]) continue;
+        c[out++] = c[i];
+    }
+    gb->cursor_count = out;
+}
+
+/* ------------------------------------------------------------------------
+   Editing
+   ------------------------------------------------------------------------ */
+
 /* Ensure the gap is at least min_size bytes */
 static void pith_gapbuf_expand_gap(PithGapBuffer *gb, size_t min_size) {
     size_t gap_size = pith_gapbuf_gap_size(gb);
@@ -218,8 +707,6 @@ static void pith_gapbuf_move_gap(PithGapBuffer *gb, size_t pos) {
     if (pos > len) pos = len;
     if (pos == gb->gap_start) return;
 
-    size_t gap_size = pith_gapbuf_gap_size(gb);
-
     if (pos < gb->gap_start) {
         /* Move gap left: shift content right into gap */
         size_t shift = gb->gap_start - pos;
@@ -243,38 +730,65 @@ void pith_gapbuf_insert(PithGapBuffer *gb, const char *str) {
     size_t len = strlen(str);
     if (len == 0) return;
 
+    size_t pos = gb->gap_start;
     pith_gapbuf_expand_gap(gb, len);
     memcpy(gb->buffer + gb->gap_start, str, len);
     gb->gap_start += len;
+    gb->revision++;
+    gapbuf_log_edit(gb, pos, 0, len);
+    lines_note_insert(gb, pos, str, len);
+
+    /* Extra cursors after the insertion point move with the text */
+    for (size_t i = 0; i < gb->cursor_count; i++) {
+        if (gb->cursors[i] > pos) gb->cursors[i] += len;
+    }
 }
 
-/* Delete n characters: positive = forward (after cursor), negative = backward */
+/* Delete n characters (codepoints): positive = forward, negative = backward */
 void pith_gapbuf_delete(PithGapBuffer *gb, int n) {
+    size_t start = gb->gap_start;
+    size_t end = gb->gap_start;
     if (n > 0) {
-        /* Delete forward: expand gap to the right */
-        size_t post_gap = gb->capacity - gb->gap_end;
-        if ((size_t)n > post_gap) n = post_gap;
-        gb->gap_end += n;
+        for (int i = 0; i < n; i++) end = pith_gapbuf_next_char(gb, end);
     } else if (n < 0) {
-        /* Delete backward: expand gap to the left */
-        size_t avail = gb->gap_start;
-        if ((size_t)(-n) > avail) n = -(int)avail;
-        gb->gap_start += n;  /* n is negative, so this decreases gap_start */
+        for (int i = 0; i < -n; i++) start = pith_gapbuf_prev_char(gb, start);
+    }
+    if (start == end) return;
+
+    lines_note_delete(gb, start, end);
+    /* Expand the gap over the deleted bytes on either side of the cursor */
+    gb->gap_end += end - gb->gap_start;
+    gb->gap_start = start;
+    gb->revision++;
+    gapbuf_log_edit(gb, start, end - start, 0);
+
+    /* Extra cursors inside the deleted range collapse onto its start */
+    if (gb->cursor_count > 0) {
+        for (size_t i = 0; i < gb->cursor_count; i++) {
+            size_t *c = &gb->cursors[i];
+            if (*c >= end) *c -= end - start;
+            else if (*c > start) *c = start;
+        }
+        gapbuf_normalize_cursors(gb);
     }
 }
 
-/* Move cursor by delta positions */
+/* Move cursor by delta characters (codepoints) */
 void pith_gapbuf_move(PithGapBuffer *gb, int delta) {
-    size_t len = pith_gapbuf_length(gb);
-    int new_pos = (int)gb->gap_start + delta;
-    if (new_pos < 0) new_pos = 0;
-    if ((size_t)new_pos > len) new_pos = len;
-    pith_gapbuf_move_gap(gb, new_pos);
+    size_t pos = gb->gap_start;
+    if (delta > 0) {
+        for (int i = 0; i < delta; i++) pos = pith_gapbuf_next_char(gb, pos);
+    } else {
+        for (int i = 0; i < -delta; i++) pos = pith_gapbuf_prev_char(gb, pos);
+    }
+    pith_gapbuf_move_gap(gb, pos);
+    if (gb->cursor_count > 0) gapbuf_normalize_cursors(gb);
 }
 
 /* Move cursor to absolute position */
 void pith_gapbuf_goto(PithGapBuffer *gb, size_t pos) {
     pith_gapbuf_move_gap(gb, pos);
+    if (gb->cursor_count > 0) gapbuf_normalize_cursors(gb);
 }
 
 /* Get cursor position */
@@ -286,12 +800,51 @@ size_t pith_gapbuf_cursor(PithGapBuffer *gb) {
 char pith_gapbuf_char_at(PithGapBuffer *gb, size_t pos) {
     size_t len = pith_gapbuf_length(gb);
     if (pos >= len) return '\0';
+    return gapbuf_byte(gb, pos);
+}
 
-    if (pos < gb->gap_start) {
-        return gb->buffer[pos];
-    } else {
-        return gb->buffer[gb->gap_end + (pos - gb->gap_start)];
+/* Position of the codepoint after the one starting at pos */
+size_t pith_gapbuf_next_char(PithGapBuffer *gb, size_t pos) {
+    size_t len = pith_gapbuf_length(gb);
+    if (pos >= len) return len;
+    pos++;
+    while (pos < len && UTF8_IS_CONT(gapbuf_byte(gb, pos))) pos++;
+    return pos;
+}
+
+/* Position of the codepoint before pos */
+size_t pith_gapbuf_prev_char(PithGapBuffer *gb, size_t pos) {
+    if (pos == 0) return 0;
+    pos--;
+    while (pos > 0 && UTF8_IS_CONT(gapbuf_byte(gb, pos))) pos--;
+    return pos;
+}
+
+/* Copy the bytes [start, end) into out (not terminated) */
+void pith_gapbuf_copy_range(PithGapBuffer *gb, size_t start, size_t end, char *out) {
+    size_t len = pith_gapbuf_length(gb);
+    if (end > len) end = len;
+    if (start >= end) return;
+
+    if (start < gb->gap_start) {
+        size_t pre_end = end < gb->gap_start ? end : gb->gap_start;
+        memcpy(out, gb->buffer + start, pre_end - start);
+        out += pre_end - start;
+        start = pre_end;
     }
+    if (start < end) {
+        memcpy(out, gb->buffer + gb->gap_end + (start - gb->gap_start), end - start);
+    }
+}
+
+/* Contents as a string value, allocated with pith_string_alloc */
+char* pith_gapbuf_to_value_string(PithGapBuffer *gb) {
+    size_t len = pith_gapbuf_length(gb);
+    char *str = pith_string_alloc(len);
+    memcpy(str, gb->buffer, gb->gap_start);
+    memcpy(str + gb->gap_start, gb->buffer + gb->gap_end,
+           gb->capacity - gb->gap_end);
+    return str;
 }
 
 /* Convert to string */
@@ -311,78 +864,72 @@ char* pith_gapbuf_to_string(PithGapBuffer *gb) {
 
 /* ========================================================================
    LINE NAVIGATION HELPERS (for multiline text editing)
+   Lines and columns are answered from the line index; columns count
+   codepoints, positions are byte offsets.
    ======================================================================== */
 
+/* Get the line number containing byte position pos (0-indexed) */
+size_t pith_gapbuf_pos_line(PithGapBuffer *gb, size_t pos) {
+    return lines_find(gapbuf_lines(gb), pos);
+}
+
+/* Get the column of byte position pos (0-indexed, in codepoints) */
+size_t pith_gapbuf_pos_column(PithGapBuffer *gb, size_t pos) {
+    PithLineIndex *li = gapbuf_lines(gb);
+    size_t line = lines_find(li, pos);
+    size_t offset = pos - lines_start(li, line);
+    size_t *map = lines_column_map(gb, li, line);
+
+    /* Last column whose offset is <= the byte offset */
+    size_t lo = 0, hi = li->columns[line];
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo + 1) / 2;
+        if (map[mid] <= offset) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
 /* Get the line number at cursor position (0-indexed) */
 size_t pith_gapbuf_cursor_line(PithGapBuffer *gb) {
-    size_t cursor = pith_gapbuf_cursor(gb);
-    size_t line = 0;
-    for (size_t i = 0; i < cursor; i++) {
-        if (pith_gapbuf_char_at(gb, i) == '\n') {
-            line++;
-        }
-    }
-    return line;
+    return pith_gapbuf_pos_line(gb, gb->gap_start);
 }
 
-/* Get the column at cursor position (0-indexed) */
+/* Get the column at cursor position (0-indexed, in codepoints) */
 size_t pith_gapbuf_cursor_column(PithGapBuffer *gb) {
-    size_t cursor = pith_gapbuf_cursor(gb);
-    size_t col = 0;
-    /* Scan backward to find start of line */
-    for (size_t i = cursor; i > 0; i--) {
-        if (pith_gapbuf_char_at(gb, i - 1) == '\n') {
-            break;
-        }
-        col++;
-    }
-    return col;
+    return pith_gapbuf_pos_column(gb, gb->gap_start);
 }
 
 /* Get position of start of line n (0-indexed) */
 size_t pith_gapbuf_line_start(PithGapBuffer *gb, size_t line) {
-    size_t len = pith_gapbuf_length(gb);
-    size_t current_line = 0;
-    size_t pos = 0;
-
-    while (pos < len && current_line < line) {
-        if (pith_gapbuf_char_at(gb, pos) == '\n') {
-            current_line++;
-        }
-        pos++;
-    }
-    return pos;
+    PithLineIndex *li = gapbuf_lines(gb);
+    if (line >= li->count) return pith_gapbuf_length(gb);
+    return lines_start(li, line);
 }
 
 /* Get position of end of line n (position of \n or buffer end) */
 size_t pith_gapbuf_line_end(PithGapBuffer *gb, size_t line) {
-    size_t start = pith_gapbuf_line_start(gb, line);
-    size_t len = pith_gapbuf_length(gb);
-    size_t pos = start;
-
-    while (pos < len && pith_gapbuf_char_at(gb, pos) != '\n') {
-        pos++;
-    }
-    return pos;
+    PithLineIndex *li = gapbuf_lines(gb);
+    if (line + 1 >= li->count) return pith_gapbuf_length(gb);
+    return lines_start(li, line + 1) - 1;
 }
 
-/* Get length of line n (excluding newline) */
+/* Get length of line n in bytes (excluding newline) */
 size_t pith_gapbuf_line_length(PithGapBuffer *gb, size_t line) {
     size_t start = pith_gapbuf_line_start(gb, line);
     size_t end = pith_gapbuf_line_end(gb, line);
     return end - start;
 }
 
+/* Get width of line n in codepoints (excluding newline) */
+size_t pith_gapbuf_line_columns(PithGapBuffer *gb, size_t line) {
+    PithLineIndex *li = gapbuf_lines(gb);
+    return line < li->count ? li->columns[line] : 0;
+}
+
 /* Count total lines in the buffer */
 size_t pith_gapbuf_line_count(PithGapBuffer *gb) {
-    size_t len = pith_gapbuf_length(gb);
-    size_t lines = 1;  /* At least one line */
-    for (size_t i = 0; i < len; i++) {
-        if (pith_gapbuf_char_at(gb, i) == '\n') {
-            lines++;
-        }
-    }
-    return lines;
+    return gapbuf_lines(gb)->count;
 }
 
 /* Move cursor up n lines, preserving column position */
@@ -395,11 +942,7 @@ void pith_gapbuf_move_up(PithGapBuffer *gb, int n) {
     if (current_line == 0) return;  /* Already at first line */
 
     size_t target_line = current_line > (size_t)n ? current_line - n : 0;
-    size_t target_line_len = pith_gapbuf_line_length(gb, target_line);
-    size_t target_col = current_col < target_line_len ? current_col : target_line_len;
-
-    size_t new_pos = pith_gapbuf_line_start(gb, target_line) + target_col;
-    pith_gapbuf_goto(gb, new_pos);
+    pith_gapbuf_goto(gb, pith_gapbuf_pos_from_line_col(gb, target_line, current_col));
 }
 
 /* Move cursor down n lines, preserving column position */
@@ -415,11 +958,7 @@ void pith_gapbuf_move_down(PithGapBuffer *gb, int n) {
     size_t target_line = current_line + n;
     if (target_line >= total_lines) target_line = total_lines - 1;
 
-    size_t target_line_len = pith_gapbuf_line_length(gb, target_line);
-    size_t target_col = current_col < target_line_len ? current_col : target_line_len;
-
-    size_t new_pos = pith_gapbuf_line_start(gb, target_line) + target_col;
-    pith_gapbuf_goto(gb, new_pos);
+    pith_gapbuf_goto(gb, pith_gapbuf_pos_from_line_col(gb, target_line, current_col));
 }
 
 /* Move cursor to start of current line */
@@ -436,12 +975,233 @@ void pith_gapbuf_line_end_move(PithGapBuffer *gb) {
     pith_gapbuf_goto(gb, line_end);
 }
 
-/* Convert (line, col) to buffer position */
+/* Convert (line, col) to buffer position; col counts codepoints */
 size_t pith_gapbuf_pos_from_line_col(PithGapBuffer *gb, size_t line, size_t col) {
-    size_t line_start = pith_gapbuf_line_start(gb, line);
-    size_t line_len = pith_gapbuf_line_length(gb, line);
-    size_t actual_col = col < line_len ? col : line_len;
-    return line_start + actual_col;
+    PithLineIndex *li = gapbuf_lines(gb);
+    if (line >= li->count) return pith_gapbuf_length(gb);
+    size_t cols = li->columns[line];
+    if (col > cols) col = cols;
+    if (col == 0) return lines_start(li, line);
+    return lines_start(li, line) + lines_column_map(gb, li, line)[col];
+}
+
+/* ========================================================================
+   BATCH EDITS AND MULTIPLE CURSORS
+   A batch of sorted, non-overlapping edits is applied in place in one
+   sweep: the gap only moves forward from edit to edit, so each byte
+   between the first and last edit moves once, and the line index is
+   rescanned for just that span. Multi-cursor editing and replace-all
+   build on it.
+   ======================================================================== */
+
+/* Map a position through sorted edits. Positions inside a replaced
+ * range, or exactly at an insertion, end up after the new text. */
+static size_t edits_map_pos(const PithGapEdit *edits, size_t count, size_t pos) {
+    ptrdiff_t delta = 0;
+    for (size_t i = 0; i < count; i++) {
+        const PithGapEdit *e = &edits[i];
+        if (e->pos > pos) break;
+        if (pos < e->pos + e->del) {
+            return (size_t)((ptrdiff_t)e->pos + delta) + e->len;
+        }
+        delta += (ptrdiff_t)e->len - (ptrdiff_t)e->del;
+    }
+    return (size_t)((ptrdiff_t)pos + delta);
+}
+
+/* Apply edits (sorted by pos, non-overlapping, positions in the current
+ * content) in a single pass. All cursors are carried through the edits. */
+void pith_gapbuf_apply_edits(PithGapBuffer *gb, const PithGapEdit *edits, size_t count) {
+    if (count == 0) return;
+
+    size_t cursor = edits_map_pos(edits, count, gb->gap_start);
+    for (size_t i = 0; i < gb->cursor_count; i++) {
+        gb->cursors[i] = edits_map_pos(edits, count, gb->cursors[i]);
+    }
+
+    /* Lines touched by the edits, rescanned once they are all applied */
+    size_t first_line = 0, last_line = 0;
+    if (gb->lines) {
+        lines_flush(gb->lines);
+        first_line = lines_find(gb->lines, edits[0].pos);
+        last_line = lines_find(gb->lines, edits[count - 1].pos + edits[count - 1].del);
+    }
+
+    /* The gap must hold the most the content grows part way through */
+    ptrdiff_t growth = 0, peak = 0;
+    for (size_t i = 0; i < count; i++) {
+        growth += (ptrdiff_t)edits[i].len - (ptrdiff_t)edits[i].del;
+        if (growth > peak) peak = growth;
+    }
+    pith_gapbuf_expand_gap(gb, (size_t)peak);
+
+    ptrdiff_t delta = 0;
+    for (size_t i = 0; i < count; i++) {
+        pith_gapbuf_move_gap(gb, (size_t)((ptrdiff_t)edits[i].pos + delta));
+        gb->gap_end += edits[i].del;
+        memcpy(gb->buffer + gb->gap_start, edits[i].text, edits[i].len);
+        gb->gap_start += edits[i].len;
+        delta += (ptrdiff_t)edits[i].len - (ptrdiff_t)edits[i].del;
+    }
+    pith_gapbuf_move_gap(gb, cursor);
+
+    gb->revision++;
+    size_t span = edits[count - 1].pos + edits[count - 1].del - edits[0].pos;
+    gapbuf_log_edit(gb, edits[0].pos, span, (size_t)((ptrdiff_t)span + delta));
+    lines_note_replace(gb, first_line, last_line, delta);
+    gapbuf_normalize_cursors(gb);
+}
+
+/* Add an extra cursor at pos */
+void pith_gapbuf_add_cursor(PithGapBuffer *gb, size_t pos) {
+    size_t len = pith_gapbuf_length(gb);
+    if (pos > len) pos = len;
+    gb->cursors = realloc(gb->cursors, (gb->cursor_count + 1) * sizeof(size_t));
+    gb->cursors[gb->cursor_count++] = pos;
+    gapbuf_normalize_cursors(gb);
+}
+
+/* Drop all extra cursors */
+void pith_gapbuf_clear_cursors(PithGapBuffer *gb) {
+    gb->cursor_count = 0;
+}
+
+/* All cursor positions (primary and extra) in ascending order */
+static size_t* gapbuf_all_cursors(PithGapBuffer *gb, size_t *out_count) {
+    size_t n = gb->cursor_count + 1;
+    size_t *all = malloc(n * sizeof(size_t));
+    size_t j = 0;
+    bool placed = false;
+    for (size_t i = 0; i < gb->cursor_count; i++) {
+        if (!placed && gb->gap_start < gb->cursors[i]) {
+            all[j++] = gb->gap_start;
+            placed = true;
+        }
+        all[j++] = gb->cursors[i];
+    }
+    if (!placed) all[j++] = gb->gap_start;
+    *out_count = n;
+    return all;
+}
+
+/* Insert text at every cursor */
+void pith_gapbuf_multi_insert(PithGapBuffer *gb, const char *str) {
+    if (gb->cursor_count == 0) {
+        pith_gapbuf_insert(gb, str);
+        return;
+    }
+    if (!str || !*str) return;
+
+    size_t n;
+    size_t *all = gapbuf_all_cursors(gb, &n);
+    PithGapEdit *edits = malloc(n * sizeof(PithGapEdit));
+    size_t len = strlen(str);
+    for (size_t i = 0; i < n; i++) {
+        edits[i] = (PithGapEdit){ .pos = all[i], .del = 0, .text = str, .len = len };
+    }
+    pith_gapbuf_apply_edits(gb, edits, n);
+    free(edits);
+    free(all);
+}
+
+/* Delete n characters at every cursor (see pith_gapbuf_delete) */
+void pith_gapbuf_multi_delete(PithGapBuffer *gb, int n) {
+    if (gb->cursor_count == 0) {
+        pith_gapbuf_delete(gb, n);
+        return;
+    }
+
+    size_t count;
+    size_t *all = gapbuf_all_cursors(gb, &count);
+    PithGapEdit *edits = malloc(count * sizeof(PithGapEdit));
+    size_t edit_count = 0;
+    size_t prev_end = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t start = all[i];
+        size_t end = all[i];
+        if (n > 0) {
+            for (int k = 0; k < n; k++) end = pith_gapbuf_next_char(gb, end);
+        } else {
+            for (int k = 0; k < -n; k++) start = pith_gapbuf_prev_char(gb, start);
+        }
+        /* Ranges of neighbouring cursors may overlap; clip to keep them disjoint */
+        if (start < prev_end) start = prev_end;
+        if (start >= end) continue;
+        edits[edit_count++] = (PithGapEdit){ .pos = start, .del = end - start, .text = "", .len = 0 };
+        prev_end = end;
+    }
+    pith_gapbuf_apply_edits(gb, edits, edit_count);
+    free(edits);
+    free(all);
+}
+
+/* Move every cursor by delta characters */
+void pith_gapbuf_multi_move(PithGapBuffer *gb, int delta) {
+    for (size_t i = 0; i < gb->cursor_count; i++) {
+        size_t pos = gb->cursors[i];
+        if (delta > 0) {
+            for (int k = 0; k < delta; k++) pos = pith_gapbuf_next_char(gb, pos);
+        } else {
+            for (int k = 0; k < -delta; k++) pos = pith_gapbuf_prev_char(gb, pos);
+        }
+        gb->cursors[i] = pos;
+    }
+    pith_gapbuf_move(gb, delta);
+}
+
+/* Whether the content at pos starts with the n bytes of str */
+static bool gapbuf_matches(PithGapBuffer *gb, size_t pos, const char *str, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (gapbuf_byte(gb, pos + i) != str[i]) return false;
+    }
+    return true;
+}
+
+/* Replace every occurrence of find with replace; returns the count.
+ * The text before and after the gap is searched where it lies. */
+size_t pith_gapbuf_replace_all(PithGapBuffer *gb, const char *find, const char *replace) {
+    size_t find_len = strlen(find);
+    if (find_len == 0) return 0;
+    size_t replace_len = strlen(replace);
+    size_t len = pith_gapbuf_length(gb);
+    if (len < find_len) return 0;
+
+    PithGapEdit *edits = NULL;
+    size_t count = 0, capacity = 0;
+    size_t last = len - find_len;
+    size_t pos = 0;
+    while (pos <= last) {
+        /* Look for the first byte within the half pos is in */
+        bool before_gap = pos < gb->gap_start;
+        size_t half_end = before_gap ? gb->gap_start : len;
+        size_t stop = half_end <= last ? half_end : last + 1;
+        const char *base = before_gap ? gb->buffer
+                                      : gb->buffer + (gb->gap_end - gb->gap_start);
+        const char *hit = memchr(base + pos, find[0], stop - pos);
+        if (!hit) {
+            pos = stop;
+            continue;
+        }
+        size_t at = (size_t)(hit - base);
+        bool match = at + find_len <= half_end ? memcmp(hit, find, find_len) == 0
+                                               : gapbuf_matches(gb, at, find, find_len);
+        if (!match) {
+            pos = at + 1;
+            continue;
+        }
+        if (count >= capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            edits = realloc(edits, capacity * sizeof(PithGapEdit));
+        }
+        edits[count++] = (PithGapEdit){
+            .pos = at, .del = find_len, .text = replace, .len = replace_len
+        };
+        pos = at + find_len;
+    }
+
+    pith_gapbuf_apply_edits(gb, edits, count);
+    free(edits);
+    return count;
 }
 
 /* ========================================================================
@@ -455,6 +1215,7 @@ PithSignal* pith_signal_new(PithRuntime *rt, PithValue initial) {
     sig->subscriber_count = 0;
     sig->subscriber_capacity = 0;
     sig->dirty = false;
+    sig->version = 0;
 
     /* Register signal with runtime for dirty checking */
     if (rt) {
@@ -480,6 +1241,7 @@ void pith_signal_set(PithSignal *sig, PithValue value) {
     pith_value_free(sig->value);
     sig->value = value;
     sig->dirty = true;
+    sig->version++;
 }
 
 PithValue pith_signal_get(PithSignal *sig) {
@@ -488,6 +1250,7 @@ PithValue pith_signal_get(PithSignal *sig) {
 }
 
 bool pith_runtime_has_dirty_signals(PithRuntime *rt) {
+    if (rt->view_stale) return true;
     for (size_t i = 0; i < rt->signal_count; i++) {
         if (rt->all_signals[i]->dirty) {
             return true;
@@ -497,6 +1260,7 @@ bool pith_runtime_has_dirty_signals(PithRuntime *rt) {
 }
 
 void pith_runtime_clear_dirty(PithRuntime *rt) {
+    rt->view_stale = false;
     for (size_t i = 0; i < rt->signal_count; i++) {
         rt->all_signals[i]->dirty = false;
     }
@@ -569,7 +1333,7 @@ PithValue pith_value_copy(PithValue value) {
             return value;
             
         case VAL_STRING:
-            return PITH_STRING(pith_strdup(value.as.string));
+            return PITH_STRING(pith_string_copy(value.as.string));
             
         case VAL_ARRAY: {
             PithArray *copy = pith_array_new();
@@ -604,6 +1368,13 @@ PithValue pith_value_copy(PithValue value) {
 
         case VAL_GAPBUF:
             return PITH_GAPBUF(pith_gapbuf_copy(value.as.gapbuf));
+
+        case VAL_BUILDER:
+            return PITH_BUILDER(pith_string_copy(value.as.string));
+
+        case VAL_SEQ:
+            /* Sequences are immutable recipes, shared by reference count */
+            return PITH_SEQ(seq_retain(value.as.seq));
     }
     return PITH_NIL();
 }
@@ -611,8 +1382,8 @@ PithValue pith_value_copy(PithValue value) {
 /* Free an outline node and its children recursively */
 static void pith_outline_node_free(PithOutlineNode *node) {
     if (!node) return;
-    free(node->label);
-    free(node->icon);
+    pith_string_free(node->label);
+    pith_string_free(node->icon);
     if (node->on_click) free(node->on_click);
     for (size_t i = 0; i < node->child_count; i++) {
         pith_outline_node_free(node->children[i]);
@@ -624,7 +1395,8 @@ static void pith_outline_node_free(PithOutlineNode *node) {
 void pith_value_free(PithValue value) {
     switch (value.type) {
         case VAL_STRING:
-            free(value.as.string);
+        case VAL_BUILDER:
+            pith_string_free(value.as.string);
             break;
         case VAL_ARRAY:
             pith_array_free(value.as.array);
@@ -644,6 +1416,9 @@ void pith_value_free(PithValue value) {
         case VAL_OUTLINE_NODE:
             pith_outline_node_free(value.as.outline_node);
             break;
+        case VAL_SEQ:
+            seq_release(value.as.seq);
+            break;
         default:
             break;
     }
@@ -680,6 +1455,10 @@ char* pith_value_to_string(PithValue value) {
         case VAL_OUTLINE_NODE:
             return pith_strdup(value.as.outline_node->label ?
                 value.as.outline_node->label : "[outline-node]");
+        case VAL_BUILDER:
+            return pith_strdup(value.as.string);
+        case VAL_SEQ:
+            return pith_strdup("[sequence]");
     }
     return pith_strdup("?");
 }
@@ -694,7 +1473,7 @@ bool pith_value_equal(PithValue a, PithValue b) {
         case VAL_NUMBER:
             return a.as.number == b.as.number;
         case VAL_STRING:
-            return strcmp(a.as.string, b.as.string) == 0;
+            return pith_string_equal(a.as.string, b.as.string);
         default:
             return false; /* Reference equality for complex types */
     }
@@ -731,7 +1510,8 @@ void pith_dict_set_parent(PithDict *dict, PithDict *parent) {
     dict->parent = parent;
 }
 
-bool pith_dict_add_slot(PithDict *dict, const char *name, size_t body_start, size_t body_end) {
+bool pith_dict_add_slot(PithDict *dict, const char *name, PithUnit *unit,
+                        size_t body_start, size_t body_end) {
     if (dict->slot_count >= dict->slot_capacity) {
         dict->slot_capacity = dict->slot_capacity ? dict->slot_capacity * 2 : 8;
         dict->slots = realloc(dict->slots, dict->slot_capacity * sizeof(PithSlot));
@@ -739,9 +1519,12 @@ bool pith_dict_add_slot(PithDict *dict, const char *name, size_t body_start, siz
     
     PithSlot *slot = &dict->slots[dict->slot_count++];
     slot->name = pith_strdup(name);
+    slot->unit = unit;
     slot->body_start = body_start;
     slot->body_end = body_end;
     slot->is_cached = false;
+    slot->calls = 0;
+    slot->stack_high = 0;
     
     return true;
 }
@@ -773,6 +1556,7 @@ static void pith_dict_set_value(PithDict *dict, const char *name, PithValue valu
             }
             dict->slots[i].is_cached = true;
             dict->slots[i].cached = value;
+            dict->slots[i].unit = NULL;
             dict->slots[i].body_start = 0;
             dict->slots[i].body_end = 0;
             return;
@@ -787,10 +1571,13 @@ static void pith_dict_set_value(PithDict *dict, const char *name, PithValue valu
 
     PithSlot *slot = &dict->slots[dict->slot_count++];
     slot->name = pith_strdup(name);
+    slot->unit = NULL;
     slot->body_start = 0;
     slot->body_end = 0;
     slot->is_cached = true;
     slot->cached = value;
+    slot->calls = 0;
+    slot->stack_high = 0;
 }
 
 /* Copy a dict (shallow copy of slots) */
@@ -803,7 +1590,7 @@ static PithDict* pith_dict_copy(PithDict *src) {
         if (s->is_cached) {
             pith_dict_set_value(copy, s->name, pith_value_copy(s->cached));
         } else {
-            pith_dict_add_slot(copy, s->name, s->body_start, s->body_end);
+            pith_dict_add_slot(copy, s->name, s->unit, s->body_start, s->body_end);
         }
     }
 
@@ -1017,6 +1804,8 @@ typedef struct {
     const char *current;
     size_t line;
     size_t column;
+    bool has_error;
+    char error[PITH_ERROR_MAX];
 } Lexer;
 
 static void lexer_init(Lexer *lex, const char *source) {
@@ -1024,6 +1813,8 @@ static void lexer_init(Lexer *lex, const char *source) {
     lex->current = source;
     lex->line = 1;
     lex->column = 1;
+    lex->has_error = false;
+    lex->error[0] = '\0';
 }
 
 static char lexer_peek(Lexer *lex) {
@@ -1057,12 +1848,26 @@ static void lexer_skip_whitespace(Lexer *lex) {
     }
 }
 
-static bool is_word_char(char c) {
-    return isalnum(c) || c == '_' || c == '-' || c == '?' || c == '!' ||
+bool pith_is_word_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '-' || c == '?' || c == '!' ||
            c == '=' || c == '<' || c == '>' || c == '+' || c == '*' || c == '/';
 }
 
-static PithToken lexer_next(Lexer *lex, PithRuntime *rt) {
+/* Token type for a word: a keyword type, or TOK_WORD */
+PithTokenType pith_keyword_type(const char *text, size_t len) {
+    static const struct { const char *name; PithTokenType type; } keywords[] = {
+        {"end", TOK_END}, {"if", TOK_IF}, {"else", TOK_ELSE}, {"do", TOK_DO},
+        {"true", TOK_TRUE}, {"false", TOK_FALSE}, {"nil", TOK_NIL},
+    };
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        if (strlen(keywords[i].name) == len && memcmp(keywords[i].name, text, len) == 0) {
+            return keywords[i].type;
+        }
+    }
+    return TOK_WORD;
+}
+
+static PithToken lexer_next(Lexer *lex) {
     lexer_skip_whitespace(lex);
     
     PithToken token = {0};
@@ -1142,62 +1947,106 @@ static PithToken lexer_next(Lexer *lex, PithRuntime *rt) {
     }
     
     /* Word or keyword */
-    if (is_word_char(c)) {
+    if (pith_is_word_char(c)) {
         const char *start = lex->current;
-        while (is_word_char(lexer_peek(lex))) lexer_advance(lex);
+        while (pith_is_word_char(lexer_peek(lex))) lexer_advance(lex);
         size_t len = lex->current - start;
         token.text = malloc(len + 1);
         memcpy(token.text, start, len);
         token.text[len] = '\0';
         
         /* Check for keywords */
-        if (strcmp(token.text, "end") == 0) token.type = TOK_END;
-        else if (strcmp(token.text, "if") == 0) token.type = TOK_IF;
-        else if (strcmp(token.text, "else") == 0) token.type = TOK_ELSE;
-        else if (strcmp(token.text, "do") == 0) token.type = TOK_DO;
-        else if (strcmp(token.text, "true") == 0) token.type = TOK_TRUE;
-        else if (strcmp(token.text, "false") == 0) token.type = TOK_FALSE;
-        else if (strcmp(token.text, "nil") == 0) token.type = TOK_NIL;
-        else token.type = TOK_WORD;
+        token.type = pith_keyword_type(token.text, len);
         
         return token;
     }
     
     /* Unknown character */
-    pith_error(rt, "Unexpected character '%c' at line %zu", c, lex->line);
+    snprintf(lex->error, PITH_ERROR_MAX, "Unexpected character '%c' at line %zu", c, lex->line);
+    lex->has_error = true;
     lexer_advance(lex);
-    return lexer_next(lex, rt);
+    return lexer_next(lex);
 }
 
 /* ========================================================================
    PARSER
+   A source is built into its own unit and a staging root dictionary.
+   Building touches nothing shared, so several sources can be built on
+   different threads; the results are merged into rt->root afterwards.
    ======================================================================== */
 
-static bool pith_parse(PithRuntime *rt, const char *source) {
-    Lexer lex;
-    lexer_init(&lex, source);
-    
-    rt->token_count = 0;
-    
-    while (1) {
-        if (rt->token_count >= PITH_TOKEN_MAX) {
-            pith_error(rt, "Too many tokens");
-            return false;
+typedef struct {
+    PithUnit *unit;
+    PithDict *root;         /* Staging root the unit's slots are scanned into */
+    const char *path;       /* Source file, read by the builder (may be NULL) */
+    bool has_error;
+    char error[PITH_ERROR_MAX];
+} UnitBuild;
+
+/* Create an empty compilation unit owned by the runtime */
+static PithUnit* pith_unit_new(PithRuntime *rt, const char *name) {
+    if (rt->unit_count >= rt->unit_capacity) {
+        rt->unit_capacity = rt->unit_capacity ? rt->unit_capacity * 2 : 4;
+        rt->units = realloc(rt->units, rt->unit_capacity * sizeof(PithUnit*));
+    }
+
+    PithUnit *unit = calloc(1, sizeof(PithUnit));
+    unit->name = pith_strdup(name ? name : "");
+    rt->units[rt->unit_count++] = unit;
+    return unit;
+}
+
+static void pith_unit_free(PithUnit *unit) {
+    if (unit->borrowed) {
+        /* The owning unit frees the tokens */
+    } else if (unit->map) {
+        pith_cache_release(unit);
+        free(unit->tokens);
+    } else {
+        for (size_t i = 0; i < unit->token_count; i++) {
+            free(unit->tokens[i].text);
         }
-        
-        PithToken token = lexer_next(&lex, rt);
-        rt->tokens[rt->token_count++] = token;
-        
-        if (token.type == TOK_EOF) break;
-        if (rt->has_error) return false;
+        free(unit->tokens);
     }
-    
-    return true;
+    free(unit->name);
+    free(unit);
 }
 
-/* ========================================================================
-   BUILT-IN WORDS
-   ======================================================================== */
+static void build_error(UnitBuild *b, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(b->error, PITH_ERROR_MAX, fmt, args);
+    va_end(args);
+    b->has_error = true;
+}
+
+static bool pith_parse(UnitBuild *b, const char *source) {
+    PithUnit *unit = b->unit;
+    Lexer lex;
+    lexer_init(&lex, source);
+
+    while (1) {
+        PithToken token = lexer_next(&lex);
+
+        if (unit->token_count >= unit->token_capacity) {
+            unit->token_capacity = unit->token_capacity ? unit->token_capacity * 2 : 256;
+            unit->tokens = realloc(unit->tokens, unit->token_capacity * sizeof(PithToken));
+        }
+        unit->tokens[unit->token_count++] = token;
+
+        if (token.type == TOK_EOF) break;
+        if (lex.has_error) {
+            build_error(b, "%s", lex.error);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* ========================================================================
+   BUILT-IN WORDS
+   ======================================================================== */
 
 /* Stack operations */
 static bool builtin_dup(PithRuntime *rt) {
@@ -1238,6 +2087,16 @@ static bool builtin_rot(PithRuntime *rt) {
     return true;
 }
 
+/* New string holding a followed by b */
+static char* string_concat(const char *a, const char *b) {
+    size_t len_a = pith_string_length(a);
+    size_t len_b = pith_string_length(b);
+    char *result = pith_string_alloc(len_a + len_b);
+    memcpy(result, a, len_a);
+    memcpy(result + len_a, b, len_b);
+    return result;
+}
+
 /* Arithmetic */
 static bool builtin_add(PithRuntime *rt) {
     if (!pith_stack_has(rt, 2)) return false;
@@ -1247,10 +2106,7 @@ static bool builtin_add(PithRuntime *rt) {
         return pith_push(rt, PITH_NUMBER(a.as.number + b.as.number));
     }
     if (PITH_IS_STRING(a) && PITH_IS_STRING(b)) {
-        size_t len = strlen(a.as.string) + strlen(b.as.string) + 1;
-        char *result = malloc(len);
-        strcpy(result, a.as.string);
-        strcat(result, b.as.string);
+        char *result = string_concat(a.as.string, b.as.string);
         pith_value_free(a);
         pith_value_free(b);
         return pith_push(rt, PITH_STRING(result));
@@ -1434,7 +2290,7 @@ static bool builtin_length(PithRuntime *rt) {
     if (!pith_stack_has(rt, 1)) return false;
     PithValue a = pith_pop(rt);
     if (PITH_IS_STRING(a)) {
-        size_t len = strlen(a.as.string);
+        size_t len = pith_string_length(a.as.string);
         pith_value_free(a);
         return pith_push(rt, PITH_NUMBER((double)len));
     }
@@ -1458,11 +2314,7 @@ static bool builtin_concat(PithRuntime *rt) {
         pith_value_free(b);
         return false;
     }
-    size_t len_a = strlen(a.as.string);
-    size_t len_b = strlen(b.as.string);
-    char *result = malloc(len_a + len_b + 1);
-    memcpy(result, a.as.string, len_a);
-    memcpy(result + len_a, b.as.string, len_b + 1);
+    char *result = string_concat(a.as.string, b.as.string);
     pith_value_free(a);
     pith_value_free(b);
     return pith_push(rt, PITH_STRING(result));
@@ -1479,29 +2331,25 @@ static bool builtin_split(PithRuntime *rt) {
         return false;
     }
     PithArray *array = pith_array_new();
-    char *copy = pith_strdup(str.as.string);
-    char *token = copy;
-    char *next;
-    size_t delim_len = strlen(delim.as.string);
+    const char *token = str.as.string;
+    const char *end = token + pith_string_length(str.as.string);
+    const char *next;
+    size_t delim_len = pith_string_length(delim.as.string);
 
     if (delim_len == 0) {
         // Split into individual characters
-        for (size_t i = 0; copy[i]; i++) {
-            char *ch = malloc(2);
-            ch[0] = copy[i];
-            ch[1] = '\0';
-            pith_array_push(array, PITH_STRING(ch));
+        for (; token < end; token++) {
+            pith_array_push(array, PITH_STRING(pith_string_new(token, 1)));
         }
     } else {
-        while ((next = strstr(token, delim.as.string)) != NULL) {
-            *next = '\0';
-            pith_array_push(array, PITH_STRING(pith_strdup(token)));
+        while ((next = pith_string_find(token, end - token,
+                                        delim.as.string, delim_len)) != NULL) {
+            pith_array_push(array, PITH_STRING(pith_string_new(token, next - token)));
             token = next + delim_len;
         }
-        pith_array_push(array, PITH_STRING(pith_strdup(token)));
+        pith_array_push(array, PITH_STRING(pith_string_new(token, end - token)));
     }
 
-    free(copy);
     pith_value_free(str);
     pith_value_free(delim);
     return pith_push(rt, PITH_ARRAY(array));
@@ -1520,16 +2368,15 @@ static bool builtin_join(PithRuntime *rt) {
 
     // Calculate total length
     size_t total = 0;
-    size_t delim_len = strlen(delim.as.string);
+    size_t delim_len = pith_string_length(delim.as.string);
     for (size_t i = 0; i < arr.as.array->length; i++) {
         if (PITH_IS_STRING(arr.as.array->items[i])) {
-            total += strlen(arr.as.array->items[i].as.string);
+            total += pith_string_length(arr.as.array->items[i].as.string);
         }
         if (i > 0) total += delim_len;
     }
 
-    char *result = malloc(total + 1);
-    result[0] = '\0';
+    char *result = pith_string_alloc(total);
     size_t pos = 0;
 
     for (size_t i = 0; i < arr.as.array->length; i++) {
@@ -1538,12 +2385,11 @@ static bool builtin_join(PithRuntime *rt) {
             pos += delim_len;
         }
         if (PITH_IS_STRING(arr.as.array->items[i])) {
-            size_t len = strlen(arr.as.array->items[i].as.string);
+            size_t len = pith_string_length(arr.as.array->items[i].as.string);
             memcpy(result + pos, arr.as.array->items[i].as.string, len);
             pos += len;
         }
     }
-    result[pos] = '\0';
 
     pith_value_free(arr);
     pith_value_free(delim);
@@ -1560,15 +2406,11 @@ static bool builtin_trim(PithRuntime *rt) {
     }
 
     const char *start = str.as.string;
-    while (*start && isspace((unsigned char)*start)) start++;
+    const char *end = start + pith_string_length(str.as.string);
+    while (start < end && isspace((unsigned char)*start)) start++;
+    while (end > start && isspace((unsigned char)end[-1])) end--;
 
-    const char *end = str.as.string + strlen(str.as.string) - 1;
-    while (end > start && isspace((unsigned char)*end)) end--;
-
-    size_t len = end - start + 1;
-    char *result = malloc(len + 1);
-    memcpy(result, start, len);
-    result[len] = '\0';
+    char *result = pith_string_new(start, end - start);
 
     pith_value_free(str);
     return pith_push(rt, PITH_STRING(result));
@@ -1588,7 +2430,7 @@ static bool builtin_substring(PithRuntime *rt) {
         return false;
     }
 
-    size_t len = strlen(str.as.string);
+    size_t len = pith_string_length(str.as.string);
     int start = (int)start_val.as.number;
     int end = (int)end_val.as.number;
 
@@ -1599,10 +2441,7 @@ static bool builtin_substring(PithRuntime *rt) {
     if ((size_t)end > len) end = len;
     if (start > end) start = end;
 
-    size_t sub_len = end - start;
-    char *result = malloc(sub_len + 1);
-    memcpy(result, str.as.string + start, sub_len);
-    result[sub_len] = '\0';
+    char *result = pith_string_new(str.as.string + start, end - start);
 
     pith_value_free(str);
     return pith_push(rt, PITH_STRING(result));
@@ -1614,7 +2453,10 @@ static bool builtin_contains(PithRuntime *rt) {
     PithValue container = pith_pop(rt);
 
     if (PITH_IS_STRING(container) && PITH_IS_STRING(search)) {
-        bool found = strstr(container.as.string, search.as.string) != NULL;
+        bool found = pith_string_find(container.as.string,
+                                      pith_string_length(container.as.string),
+                                      search.as.string,
+                                      pith_string_length(search.as.string)) != NULL;
         pith_value_free(container);
         pith_value_free(search);
         return pith_push(rt, PITH_BOOL(found));
@@ -1653,12 +2495,12 @@ static bool builtin_replace(PithRuntime *rt) {
         return false;
     }
 
-    size_t old_len = strlen(old_str.as.string);
-    size_t new_len = strlen(new_str.as.string);
+    size_t old_len = pith_string_length(old_str.as.string);
+    size_t new_len = pith_string_length(new_str.as.string);
 
     if (old_len == 0) {
         // Can't replace empty string
-        char *result = pith_strdup(str.as.string);
+        char *result = pith_string_copy(str.as.string);
         pith_value_free(str);
         pith_value_free(old_str);
         pith_value_free(new_str);
@@ -1666,22 +2508,24 @@ static bool builtin_replace(PithRuntime *rt) {
     }
 
     // Count occurrences
+    size_t len = pith_string_length(str.as.string);
+    const char *end = str.as.string + len;
     size_t count = 0;
     const char *p = str.as.string;
-    while ((p = strstr(p, old_str.as.string)) != NULL) {
+    while ((p = pith_string_find(p, end - p, old_str.as.string, old_len)) != NULL) {
         count++;
         p += old_len;
     }
 
     // Allocate result
-    size_t result_len = strlen(str.as.string) + count * (new_len - old_len);
-    char *result = malloc(result_len + 1);
+    size_t result_len = len + count * (new_len - old_len);
+    char *result = pith_string_alloc(result_len);
 
     // Build result
     char *dest = result;
     p = str.as.string;
     const char *found;
-    while ((found = strstr(p, old_str.as.string)) != NULL) {
+    while ((found = pith_string_find(p, end - p, old_str.as.string, old_len)) != NULL) {
         size_t prefix_len = found - p;
         memcpy(dest, p, prefix_len);
         dest += prefix_len;
@@ -1689,7 +2533,7 @@ static bool builtin_replace(PithRuntime *rt) {
         dest += new_len;
         p = found + old_len;
     }
-    strcpy(dest, p);
+    memcpy(dest, p, end - p);
 
     pith_value_free(str);
     pith_value_free(old_str);
@@ -1706,9 +2550,10 @@ static bool builtin_uppercase(PithRuntime *rt) {
         return false;
     }
 
-    char *result = pith_strdup(str.as.string);
-    for (char *p = result; *p; p++) {
-        *p = toupper((unsigned char)*p);
+    char *result = pith_string_copy(str.as.string);
+    size_t len = pith_string_length(result);
+    for (size_t i = 0; i < len; i++) {
+        result[i] = toupper((unsigned char)result[i]);
     }
 
     pith_value_free(str);
@@ -1724,9 +2569,10 @@ static bool builtin_lowercase(PithRuntime *rt) {
         return false;
     }
 
-    char *result = pith_strdup(str.as.string);
-    for (char *p = result; *p; p++) {
-        *p = tolower((unsigned char)*p);
+    char *result = pith_string_copy(str.as.string);
+    size_t len = pith_string_length(result);
+    for (size_t i = 0; i < len; i++) {
+        result[i] = tolower((unsigned char)result[i]);
     }
 
     pith_value_free(str);
@@ -1744,21 +2590,19 @@ static bool builtin_lines(PithRuntime *rt) {
     }
 
     PithArray *array = pith_array_new();
-    char *copy = pith_strdup(str.as.string);
-    char *line = copy;
-    char *next;
+    const char *line = str.as.string;
+    const char *end = line + pith_string_length(str.as.string);
+    const char *next;
 
-    while ((next = strchr(line, '\n')) != NULL) {
-        *next = '\0';
-        pith_array_push(array, PITH_STRING(pith_strdup(line)));
+    while ((next = memchr(line, '\n', end - line)) != NULL) {
+        pith_array_push(array, PITH_STRING(pith_string_new(line, next - line)));
         line = next + 1;
     }
     // Add the last line (or only line if no newlines)
-    if (*line || array->length == 0) {
-        pith_array_push(array, PITH_STRING(pith_strdup(line)));
+    if (line < end || array->length == 0) {
+        pith_array_push(array, PITH_STRING(pith_string_new(line, end - line)));
     }
 
-    free(copy);
     pith_value_free(str);
     return pith_push(rt, PITH_ARRAY(array));
 }
@@ -1773,31 +2617,71 @@ static bool builtin_words(PithRuntime *rt) {
     }
 
     PithArray *array = pith_array_new();
-    char *copy = pith_strdup(str.as.string);
-    char *p = copy;
+    const char *p = str.as.string;
+    const char *end = p + pith_string_length(str.as.string);
 
-    while (*p) {
+    while (p < end) {
         // Skip whitespace
-        while (*p && isspace((unsigned char)*p)) p++;
-        if (!*p) break;
+        while (p < end && isspace((unsigned char)*p)) p++;
+        if (p == end) break;
 
         // Find end of word
-        char *start = p;
-        while (*p && !isspace((unsigned char)*p)) p++;
+        const char *start = p;
+        while (p < end && !isspace((unsigned char)*p)) p++;
 
         // Extract word
-        size_t len = p - start;
-        char *word = malloc(len + 1);
-        memcpy(word, start, len);
-        word[len] = '\0';
-        pith_array_push(array, PITH_STRING(word));
+        pith_array_push(array, PITH_STRING(pith_string_new(start, p - start)));
     }
 
-    free(copy);
     pith_value_free(str);
     return pith_push(rt, PITH_ARRAY(array));
 }
 
+/* String Builders */
+/* A builder is a string with spare capacity that is appended to in place,
+ * so building text piece by piece is linear in the total length. */
+static bool builtin_string_builder(PithRuntime *rt) {
+    return pith_push(rt, PITH_BUILDER(pith_string_alloc(0)));
+}
+
+static bool sb_append(PithRuntime *rt, const char *name, bool newline) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue str = pith_pop(rt);
+    PithValue sb = pith_pop(rt);
+    if (!PITH_IS_BUILDER(sb) || !PITH_IS_STRING(str)) {
+        pith_error(rt, "%s requires a string builder and a string", name);
+        pith_value_free(sb);
+        pith_value_free(str);
+        return false;
+    }
+
+    sb.as.string = pith_string_append(sb.as.string, str.as.string,
+                                      pith_string_length(str.as.string));
+    if (newline) sb.as.string = pith_string_append(sb.as.string, "\n", 1);
+    pith_value_free(str);
+    return pith_push(rt, sb);
+}
+
+static bool builtin_sb_append(PithRuntime *rt) {
+    return sb_append(rt, "sb-append", false);
+}
+
+static bool builtin_sb_append_line(PithRuntime *rt) {
+    return sb_append(rt, "sb-append-line", true);
+}
+
+/* The builder's storage becomes the string, nothing is copied */
+static bool builtin_sb_to_string(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue sb = pith_pop(rt);
+    if (!PITH_IS_BUILDER(sb)) {
+        pith_error(rt, "sb-to-string requires a string builder");
+        pith_value_free(sb);
+        return false;
+    }
+    return pith_push(rt, PITH_STRING(sb.as.string));
+}
+
 /* Type Checking */
 static bool builtin_type(PithRuntime *rt) {
     if (!pith_stack_has(rt, 1)) return false;
@@ -1813,10 +2697,12 @@ static bool builtin_type(PithRuntime *rt) {
         case VAL_DICT: type_name = "dict"; break;
         case VAL_BLOCK: type_name = "block"; break;
         case VAL_GAPBUF: type_name = "gapbuf"; break;
+        case VAL_BUILDER: type_name = "string-builder"; break;
+        case VAL_SEQ: type_name = "sequence"; break;
         default: type_name = "unknown"; break;
     }
     pith_value_free(a);
-    return pith_push(rt, PITH_STRING(pith_strdup(type_name)));
+    return pith_push(rt, PITH_STRING(pith_string_dup(type_name)));
 }
 
 static bool builtin_is_string(PithRuntime *rt) {
@@ -1871,9 +2757,12 @@ static bool builtin_is_nil(PithRuntime *rt) {
 static bool builtin_to_string(PithRuntime *rt) {
     if (!pith_stack_has(rt, 1)) return false;
     PithValue a = pith_pop(rt);
+    if (PITH_IS_STRING(a)) return pith_push(rt, a);
     char *str = pith_value_to_string(a);
+    char *result = pith_string_dup(str);
+    free(str);
     pith_value_free(a);
-    return pith_push(rt, PITH_STRING(str));
+    return pith_push(rt, PITH_STRING(result));
 }
 
 static bool builtin_to_number(PithRuntime *rt) {
@@ -1980,7 +2869,7 @@ static bool builtin_map_keys(PithRuntime *rt) {
     PithArray *array = pith_array_new();
     PithDict *dict = map.as.dict;
     for (size_t i = 0; i < dict->slot_count; i++) {
-        pith_array_push(array, PITH_STRING(pith_strdup(dict->slots[i].name)));
+        pith_array_push(array, PITH_STRING(pith_string_dup(dict->slots[i].name)));
     }
 
     return pith_push(rt, PITH_ARRAY(array));
@@ -2087,6 +2976,7 @@ static bool builtin_map_merge(PithRuntime *rt) {
 
 /* Forward declaration for recursive sanitize */
 static PithValue pith_value_sanitize(PithValue value);
+static PithValue seq_sanitize(PithSeq *seq);
 
 static PithDict* pith_dict_sanitize(PithDict *src) {
     PithDict *copy = pith_dict_new(src->name);
@@ -2113,20 +3003,34 @@ static PithArray* pith_array_sanitize(PithArray *src) {
     return copy;
 }
 
+static PithMap* pith_map_sanitize(PithMap *src) {
+    PithMap *copy = pith_map_new();
+    for (size_t i = 0; i < src->length; i++) {
+        pith_map_set(copy, src->entries[i].key, pith_value_sanitize(src->entries[i].value));
+    }
+    return copy;
+}
+
 static PithValue pith_value_sanitize(PithValue value) {
     switch (value.type) {
         case VAL_DICT:
             return PITH_DICT(pith_dict_sanitize(value.as.dict));
         case VAL_ARRAY:
             return PITH_ARRAY(pith_array_sanitize(value.as.array));
+        case VAL_MAP:
+            return PITH_MAP(pith_map_sanitize(value.as.map));
         case VAL_BLOCK:
             /* Blocks are executable - return nil */
             return PITH_NIL();
+        case VAL_SEQ:
+            return seq_sanitize(value.as.seq);
         case VAL_VIEW:
-            /* Views are runtime objects - return nil */
+        case VAL_SIGNAL:
+        case VAL_OUTLINE_NODE:
+            /* Views, signals and outline nodes are runtime objects - return nil */
             return PITH_NIL();
         default:
-            /* Primitives: nil, bool, number, string - copy as-is */
+            /* Primitives: nil, bool, number, string, gap buffer - copy as-is */
             return pith_value_copy(value);
     }
 }
@@ -2143,42 +3047,26 @@ static bool builtin_sanitize(PithRuntime *rt) {
 
 /* JSON Serialization */
 typedef struct {
-    char *buf;
-    size_t len;
-    size_t cap;
+    char *buf;                  /* Pith string, appended to in place */
 } JsonBuffer;
 
 static void json_buf_init(JsonBuffer *jb) {
-    jb->cap = 256;
-    jb->buf = malloc(jb->cap);
-    jb->buf[0] = '\0';
-    jb->len = 0;
+    jb->buf = pith_string_alloc(0);
 }
 
 static void json_buf_append(JsonBuffer *jb, const char *str) {
-    size_t slen = strlen(str);
-    while (jb->len + slen + 1 > jb->cap) {
-        jb->cap *= 2;
-        jb->buf = realloc(jb->buf, jb->cap);
-    }
-    memcpy(jb->buf + jb->len, str, slen + 1);
-    jb->len += slen;
+    jb->buf = pith_string_append(jb->buf, str, strlen(str));
 }
 
 static void json_buf_append_char(JsonBuffer *jb, char c) {
-    if (jb->len + 2 > jb->cap) {
-        jb->cap *= 2;
-        jb->buf = realloc(jb->buf, jb->cap);
-    }
-    jb->buf[jb->len++] = c;
-    jb->buf[jb->len] = '\0';
+    jb->buf = pith_string_append(jb->buf, &c, 1);
 }
 
 static void json_serialize_value(JsonBuffer *jb, PithValue value);
 
-static void json_serialize_string(JsonBuffer *jb, const char *str) {
+static void json_serialize_string(JsonBuffer *jb, const char *str, size_t len) {
     json_buf_append_char(jb, '"');
-    for (const char *p = str; *p; p++) {
+    for (const char *p = str; p < str + len; p++) {
         switch (*p) {
             case '"':  json_buf_append(jb, "\\\""); break;
             case '\\': json_buf_append(jb, "\\\\"); break;
@@ -2217,7 +3105,7 @@ static void json_serialize_dict(JsonBuffer *jb, PithDict *dict) {
         if (s->is_cached) {
             if (!first) json_buf_append_char(jb, ',');
             first = false;
-            json_serialize_string(jb, s->name);
+            json_serialize_string(jb, s->name, strlen(s->name));
             json_buf_append_char(jb, ':');
             json_serialize_value(jb, s->cached);
         }
@@ -2239,7 +3127,7 @@ static void json_serialize_value(JsonBuffer *jb, PithValue value) {
             json_buf_append(jb, numbuf);
             break;
         case VAL_STRING:
-            json_serialize_string(jb, value.as.string);
+            json_serialize_string(jb, value.as.string, pith_string_length(value.as.string));
             break;
         case VAL_ARRAY:
             json_serialize_array(jb, value.as.array);
@@ -2286,6 +3174,39 @@ static void json_skip_ws(JsonParser *jp) {
 
 static PithValue json_parse_value(JsonParser *jp);
 
+/* Four hex digits after \u; stops early at a non-hex character */
+static unsigned json_parse_hex4(JsonParser *jp) {
+    unsigned cp = 0;
+    for (int i = 0; i < 4 && isxdigit((unsigned char)jp->src[jp->pos]); i++) {
+        char h = jp->src[jp->pos++];
+        cp = cp * 16 + (unsigned)(isdigit((unsigned char)h) ? h - '0' : (tolower((unsigned char)h) - 'a' + 10));
+    }
+    return cp;
+}
+
+static size_t json_utf8_encode(unsigned cp, char *out) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
 static PithValue json_parse_string(JsonParser *jp) {
     if (jp->src[jp->pos] != '"') {
         snprintf(jp->error, sizeof(jp->error), "Expected '\"'");
@@ -2310,14 +3231,27 @@ static PithValue json_parse_string(JsonParser *jp) {
                 case 'n':  c = '\n'; break;
                 case 'r':  c = '\r'; break;
                 case 't':  c = '\t'; break;
-                case 'u':
-                    /* Simple unicode escape - just skip for now */
-                    if (jp->src[jp->pos]) jp->pos++;
-                    if (jp->src[jp->pos]) jp->pos++;
-                    if (jp->src[jp->pos]) jp->pos++;
-                    if (jp->src[jp->pos]) jp->pos++;
-                    c = '?';
-                    break;
+                case 'u': {
+                    /* Decode to UTF-8 (\u0000 becomes a NUL byte) */
+                    unsigned cp = json_parse_hex4(jp);
+                    if (cp >= 0xD800 && cp < 0xDC00 &&
+                        jp->src[jp->pos] == '\\' && jp->src[jp->pos + 1] == 'u') {
+                        size_t save = jp->pos;
+                        jp->pos += 2;
+                        unsigned lo = json_parse_hex4(jp);
+                        if (lo >= 0xDC00 && lo < 0xE000) {
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        } else {
+                            jp->pos = save;
+                        }
+                    }
+                    if (len + 5 > cap) {
+                        cap *= 2;
+                        buf = realloc(buf, cap);
+                    }
+                    len += json_utf8_encode(cp, buf + len);
+                    continue;
+                }
                 default: c = esc;
             }
         }
@@ -2327,13 +3261,14 @@ static PithValue json_parse_string(JsonParser *jp) {
         }
         buf[len++] = c;
     }
-    buf[len] = '\0';
 
     if (jp->src[jp->pos] == '"') {
         jp->pos++; /* skip closing quote */
     }
 
-    return PITH_STRING(buf);
+    char *str = pith_string_new(buf, len);
+    free(buf);
+    return PITH_STRING(str);
 }
 
 static PithValue json_parse_number(JsonParser *jp) {
@@ -2538,7 +3473,7 @@ static bool builtin_gap_to_string(PithRuntime *rt) {
         return false;
     }
 
-    char *str = pith_gapbuf_to_string(gb_val.as.gapbuf);
+    char *str = pith_gapbuf_to_value_string(gb_val.as.gapbuf);
     pith_value_free(gb_val);
     return pith_push(rt, PITH_STRING(str));
 }
@@ -2562,7 +3497,7 @@ static bool builtin_gap_insert(PithRuntime *rt) {
     }
 
     PithGapBuffer *gb = pith_gapbuf_copy(gb_val.as.gapbuf);
-    pith_gapbuf_insert(gb, str.as.string);
+    pith_gapbuf_multi_insert(gb, str.as.string);
     pith_value_free(gb_val);
     pith_value_free(str);
     return pith_push(rt, PITH_GAPBUF(gb));
@@ -2587,7 +3522,7 @@ static bool builtin_gap_delete(PithRuntime *rt) {
     }
 
     PithGapBuffer *gb = pith_gapbuf_copy(gb_val.as.gapbuf);
-    pith_gapbuf_delete(gb, (int)n_val.as.number);
+    pith_gapbuf_multi_delete(gb, (int)n_val.as.number);
     pith_value_free(gb_val);
     return pith_push(rt, PITH_GAPBUF(gb));
 }
@@ -2611,7 +3546,7 @@ static bool builtin_gap_move(PithRuntime *rt) {
     }
 
     PithGapBuffer *gb = pith_gapbuf_copy(gb_val.as.gapbuf);
-    pith_gapbuf_move(gb, (int)n_val.as.number);
+    pith_gapbuf_multi_move(gb, (int)n_val.as.number);
     pith_value_free(gb_val);
     return pith_push(rt, PITH_GAPBUF(gb));
 }
@@ -2688,1367 +3623,3940 @@ static bool builtin_gap_char(PithRuntime *rt) {
         return false;
     }
 
-    char c = pith_gapbuf_char_at(gb_val.as.gapbuf, (size_t)pos_val.as.number);
-    pith_value_free(gb_val);
-
-    if (c == '\0') {
+    /* Return the whole codepoint starting at pos */
+    PithGapBuffer *gb = gb_val.as.gapbuf;
+    size_t pos = (size_t)pos_val.as.number;
+    if (pos >= pith_gapbuf_length(gb)) {
+        pith_value_free(gb_val);
         return pith_push(rt, PITH_NIL());
     }
 
-    char *str = malloc(2);
-    str[0] = c;
-    str[1] = '\0';
+    size_t end = pith_gapbuf_next_char(gb, pos);
+    char *str = pith_string_alloc(end - pos);
+    pith_gapbuf_copy_range(gb, pos, end, str);
+    pith_value_free(gb_val);
     return pith_push(rt, PITH_STRING(str));
 }
 
-/* ========================================================================
-   FILE SYSTEM OPERATIONS
-   ======================================================================== */
-
-/* file-read: ( path -- contents ) */
-static bool builtin_file_read(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue path = pith_pop(rt);
+/* ( edits gapbuf -- gapbuf ) where edits is a sorted array of [pos del text] */
+static bool builtin_gap_apply_edits(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue gb_val = pith_pop(rt);
+    PithValue edits_val = pith_pop(rt);
 
-    if (!PITH_IS_STRING(path)) {
-        pith_error(rt, "file-read requires a string path");
-        pith_value_free(path);
+    if (!PITH_IS_GAPBUF(gb_val)) {
+        pith_error(rt, "gap-apply-edits requires a gap buffer");
+        pith_value_free(gb_val);
+        pith_value_free(edits_val);
+        return false;
+    }
+    if (!PITH_IS_ARRAY(edits_val)) {
+        pith_error(rt, "gap-apply-edits requires an array of edits");
+        pith_value_free(gb_val);
+        pith_value_free(edits_val);
         return false;
     }
 
-    FILE *f = fopen(path.as.string, "rb");
-    if (!f) {
-        pith_value_free(path);
-        return pith_push(rt, PITH_NIL());
+    PithArray *list = edits_val.as.array;
+    size_t len = pith_gapbuf_length(gb_val.as.gapbuf);
+    PithGapEdit *edits = malloc((list->length ? list->length : 1) * sizeof(PithGapEdit));
+    size_t prev_end = 0;
+    for (size_t i = 0; i < list->length; i++) {
+        PithValue item = list->items[i];
+        PithArray *e = PITH_IS_ARRAY(item) ? item.as.array : NULL;
+        if (!e || e->length != 3 || !PITH_IS_NUMBER(e->items[0]) ||
+            !PITH_IS_NUMBER(e->items[1]) || !PITH_IS_STRING(e->items[2]) ||
+            e->items[0].as.number < 0 || e->items[1].as.number < 0) {
+            pith_error(rt, "gap-apply-edits: edit %zu must be [pos del text]", i);
+            free(edits);
+            pith_value_free(gb_val);
+            pith_value_free(edits_val);
+            return false;
+        }
+        size_t pos = (size_t)e->items[0].as.number;
+        size_t del = (size_t)e->items[1].as.number;
+        if (pos < prev_end || pos + del > len) {
+            pith_error(rt, "gap-apply-edits: edit %zu is out of order or out of range", i);
+            free(edits);
+            pith_value_free(gb_val);
+            pith_value_free(edits_val);
+            return false;
+        }
+        const char *text = e->items[2].as.string;
+        edits[i] = (PithGapEdit){ .pos = pos, .del = del, .text = text, .len = strlen(text) };
+        prev_end = pos + del;
     }
 
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    PithGapBuffer *gb = pith_gapbuf_copy(gb_val.as.gapbuf);
+    pith_gapbuf_apply_edits(gb, edits, list->length);
+    free(edits);
+    pith_value_free(gb_val);
+    pith_value_free(edits_val);
+    return pith_push(rt, PITH_GAPBUF(gb));
+}
+
+/* ( find replace gapbuf -- gapbuf ) */
+static bool builtin_gap_replace_all(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 3)) return false;
+    PithValue gb_val = pith_pop(rt);
+    PithValue replace = pith_pop(rt);
+    PithValue find = pith_pop(rt);
 
-    char *contents = malloc(size + 1);
-    if (!contents) {
-        fclose(f);
-        pith_value_free(path);
-        pith_error(rt, "file-read: out of memory");
+    if (!PITH_IS_GAPBUF(gb_val)) {
+        pith_error(rt, "gap-replace-all requires a gap buffer");
+        pith_value_free(gb_val);
+        pith_value_free(replace);
+        pith_value_free(find);
+        return false;
+    }
+    if (!PITH_IS_STRING(find) || !PITH_IS_STRING(replace)) {
+        pith_error(rt, "gap-replace-all requires a search string and a replacement");
+        pith_value_free(gb_val);
+        pith_value_free(replace);
+        pith_value_free(find);
         return false;
     }
 
-    size_t read = fread(contents, 1, size, f);
-    contents[read] = '\0';
-    fclose(f);
-    pith_value_free(path);
-
-    return pith_push(rt, PITH_STRING(contents));
+    PithGapBuffer *gb = pith_gapbuf_copy(gb_val.as.gapbuf);
+    pith_gapbuf_replace_all(gb, find.as.string, replace.as.string);
+    pith_value_free(gb_val);
+    pith_value_free(replace);
+    pith_value_free(find);
+    return pith_push(rt, PITH_GAPBUF(gb));
 }
 
-/* file-write: ( contents path -- ) */
-static bool builtin_file_write(PithRuntime *rt) {
+/* ( pos gapbuf -- gapbuf ) */
+static bool builtin_gap_add_cursor(PithRuntime *rt) {
     if (!pith_stack_has(rt, 2)) return false;
-    PithValue path = pith_pop(rt);
-    PithValue contents = pith_pop(rt);
+    PithValue gb_val = pith_pop(rt);
+    PithValue pos_val = pith_pop(rt);
 
-    if (!PITH_IS_STRING(path)) {
-        pith_error(rt, "file-write requires a string path");
-        pith_value_free(path);
-        pith_value_free(contents);
+    if (!PITH_IS_GAPBUF(gb_val)) {
+        pith_error(rt, "gap-add-cursor requires a gap buffer");
+        pith_value_free(gb_val);
+        pith_value_free(pos_val);
         return false;
     }
-    if (!PITH_IS_STRING(contents)) {
-        pith_error(rt, "file-write requires string contents");
-        pith_value_free(path);
-        pith_value_free(contents);
+    if (!PITH_IS_NUMBER(pos_val) || pos_val.as.number < 0) {
+        pith_error(rt, "gap-add-cursor requires a position");
+        pith_value_free(gb_val);
+        pith_value_free(pos_val);
         return false;
     }
 
-    FILE *f = fopen(path.as.string, "wb");
-    if (!f) {
-        pith_error(rt, "file-write: could not open file for writing");
-        pith_value_free(path);
-        pith_value_free(contents);
+    PithGapBuffer *gb = pith_gapbuf_copy(gb_val.as.gapbuf);
+    pith_gapbuf_add_cursor(gb, (size_t)pos_val.as.number);
+    pith_value_free(gb_val);
+    return pith_push(rt, PITH_GAPBUF(gb));
+}
+
+/* ( gapbuf -- positions ) all cursor positions in ascending order */
+static bool builtin_gap_cursors(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue gb_val = pith_pop(rt);
+
+    if (!PITH_IS_GAPBUF(gb_val)) {
+        pith_error(rt, "gap-cursors requires a gap buffer");
+        pith_value_free(gb_val);
         return false;
     }
 
-    size_t len = strlen(contents.as.string);
-    fwrite(contents.as.string, 1, len, f);
-    fclose(f);
+    size_t count;
+    size_t *all = gapbuf_all_cursors(gb_val.as.gapbuf, &count);
+    PithArray *result = pith_array_new();
+    for (size_t i = 0; i < count; i++) {
+        pith_array_push(result, PITH_NUMBER((double)all[i]));
+    }
+    free(all);
+    pith_value_free(gb_val);
+    return pith_push(rt, PITH_ARRAY(result));
+}
+
+/* ========================================================================
+   INCREMENTAL SEARCH
+   ======================================================================== */
 
-    pith_value_free(path);
-    pith_value_free(contents);
+/* Buffer contents as (up to) two contiguous segments, so gap buffers
+ * can be scanned in place without moving the gap (the cursor). */
+typedef struct {
+    const char *seg[2];
+    size_t seg_len[2];
+} SearchText;
+
+static void search_text_get(PithSearchTarget *tg, SearchText *t) {
+    PithValue v = tg->source->value;
+    t->seg[0] = t->seg[1] = NULL;
+    t->seg_len[0] = t->seg_len[1] = 0;
+    if (PITH_IS_GAPBUF(v)) {
+        PithGapBuffer *gb = v.as.gapbuf;
+        t->seg[0] = gb->buffer;
+        t->seg_len[0] = gb->gap_start;
+        t->seg[1] = gb->buffer + gb->gap_end;
+        t->seg_len[1] = gb->capacity - gb->gap_end;
+    } else if (PITH_IS_STRING(v)) {
+        t->seg[0] = v.as.string;
+        t->seg_len[0] = tg->length;
+    }
+}
+
+static bool search_match_at(const SearchText *t, size_t pos, const char *q, size_t qlen) {
+    if (pos + qlen > t->seg_len[0] + t->seg_len[1]) return false;
+    for (size_t i = 0; i < qlen; i++) {
+        size_t p = pos + i;
+        char c = p < t->seg_len[0] ? t->seg[0][p] : t->seg[1][p - t->seg_len[0]];
+        if (c != q[i]) return false;
+    }
     return true;
 }
 
-/* file-exists: ( path -- bool ) */
-static bool builtin_file_exists(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue path = pith_pop(rt);
+static void search_target_add(PithSearchTarget *tg, size_t pos) {
+    if (tg->match_count >= tg->match_capacity) {
+        tg->match_capacity = tg->match_capacity ? tg->match_capacity * 2 : 16;
+        tg->matches = realloc(tg->matches, tg->match_capacity * sizeof(size_t));
+    }
+    tg->matches[tg->match_count++] = pos;
+}
+
+/* Does the cached match state still describe the signal's contents? */
+static bool search_target_current(PithSearchTarget *tg) {
+    PithValue v = tg->source->value;
+    PithGapBuffer *gb = PITH_IS_GAPBUF(v) ? v.as.gapbuf : NULL;
+    return tg->version == tg->source->version &&
+           tg->buffer == gb &&
+           (!gb || gb->revision == tg->revision);
+}
+
+static void search_target_reset(PithSearchTarget *tg) {
+    PithValue v = tg->source->value;
+    tg->version = tg->source->version;
+    tg->buffer = PITH_IS_GAPBUF(v) ? v.as.gapbuf : NULL;
+    tg->revision = tg->buffer ? tg->buffer->revision : 0;
+    if (tg->buffer) tg->length = pith_gapbuf_length(tg->buffer);
+    else if (PITH_IS_STRING(v)) tg->length = pith_string_length(v.as.string);
+    else tg->length = 0;
+    tg->scanned = 0;
+    tg->match_count = 0;
+}
+
+/* Scan start positions [tg->scanned, to), using memchr to skip to
+ * candidates for the first query byte within each segment. */
+static void search_target_scan(PithSearchTarget *tg, const SearchText *t,
+                               size_t to, const char *q, size_t qlen) {
+    size_t pos = tg->scanned;
+    size_t base = 0;
+    for (int s = 0; s < 2 && pos < to; s++) {
+        size_t seg_end = base + t->seg_len[s];
+        while (pos < to && pos < seg_end) {
+            size_t stop = to < seg_end ? to : seg_end;
+            const char *hit = memchr(t->seg[s] + (pos - base), q[0], stop - pos);
+            if (!hit) {
+                pos = stop;
+                break;
+            }
+            pos = base + (size_t)(hit - t->seg[s]);
+            if (search_match_at(t, pos, q, qlen)) {
+                search_target_add(tg, pos);
+            }
+            pos++;
+        }
+        base = seg_end;
+    }
+    tg->scanned = to;
+}
 
-    if (!PITH_IS_STRING(path)) {
-        pith_error(rt, "file-exists requires a string path");
-        pith_value_free(path);
+/* Re-read the query signal. A query that extends the previous one keeps
+ * only the existing matches that still match; anything else restarts.
+ * Returns true if the match state changed. */
+static bool search_sync_query(PithSearch *s) {
+    PithValue v = s->query->value;
+    PithGapBuffer *gb = PITH_IS_GAPBUF(v) ? v.as.gapbuf : NULL;
+    if (s->text && s->query_version == s->query->version &&
+        s->query_buffer == gb && (!gb || s->query_revision == gb->revision)) {
         return false;
     }
+    s->query_version = s->query->version;
+    s->query_buffer = gb;
+    s->query_revision = gb ? gb->revision : 0;
 
-    struct stat st;
-    bool exists = (stat(path.as.string, &st) == 0);
-    pith_value_free(path);
-
-    return pith_push(rt, PITH_BOOL(exists));
-}
-
-/* dir-list: ( path -- array ) */
-static bool builtin_dir_list(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue path = pith_pop(rt);
+    char *text = gb ? pith_gapbuf_to_string(gb)
+                    : pith_strdup(PITH_IS_STRING(v) ? v.as.string : "");
+    size_t text_len = strlen(text);
 
-    if (!PITH_IS_STRING(path)) {
-        pith_error(rt, "dir-list requires a string path");
-        pith_value_free(path);
+    if (s->text && strcmp(text, s->text) == 0) {
+        free(text);
         return false;
     }
 
-    DIR *dir = opendir(path.as.string);
-    if (!dir) {
-        pith_value_free(path);
-        return pith_push(rt, PITH_NIL());
+    bool refine = s->text && s->text_len > 0 &&
+                  strncmp(text, s->text, s->text_len) == 0;
+
+    for (size_t i = 0; i < s->target_count; i++) {
+        PithSearchTarget *tg = &s->targets[i];
+        if (!refine || !search_target_current(tg)) {
+            search_target_reset(tg);
+            continue;
+        }
+        SearchText t;
+        search_text_get(tg, &t);
+        size_t kept = 0;
+        for (size_t m = 0; m < tg->match_count; m++) {
+            if (search_match_at(&t, tg->matches[m], text, text_len)) {
+                tg->matches[kept++] = tg->matches[m];
+            }
+        }
+        tg->match_count = kept;
     }
 
+    free(s->text);
+    s->text = text;
+    s->text_len = text_len;
+    return true;
+}
+
+static void search_publish(PithSearch *s) {
     PithArray *arr = pith_array_new();
-    struct dirent *entry;
+    for (size_t i = 0; i < s->target_count; i++) {
+        PithSearchTarget *tg = &s->targets[i];
+        for (size_t m = 0; m < tg->match_count; m++) {
+            if (arr->length >= PITH_SEARCH_MAX_RESULTS) break;
+            PithArray *match = pith_array_new();
+            pith_array_push(match, PITH_NUMBER((double)i));
+            pith_array_push(match, PITH_NUMBER((double)tg->matches[m]));
+            pith_array_push(arr, PITH_ARRAY(match));
+        }
+    }
+    pith_signal_set(s->results, PITH_ARRAY(arr));
+}
 
-    while ((entry = readdir(dir)) != NULL) {
-        /* Skip . and .. */
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
+/* Advance one search; returns true if text remains to be scanned */
+static bool search_step(PithSearch *s, size_t *budget) {
+    bool changed = search_sync_query(s);
+    bool pending = false;
+
+    for (size_t i = 0; i < s->target_count; i++) {
+        PithSearchTarget *tg = &s->targets[i];
+        if (!search_target_current(tg)) {
+            search_target_reset(tg);
+            changed = true;
         }
-        pith_array_push(arr, PITH_STRING(pith_strdup(entry->d_name)));
+        if (s->text_len == 0 || tg->length < s->text_len) continue;
+
+        size_t limit = tg->length - s->text_len + 1;
+        if (tg->scanned < limit && *budget > 0) {
+            size_t chunk = limit - tg->scanned;
+            if (chunk > *budget) chunk = *budget;
+            size_t before = tg->match_count;
+            SearchText t;
+            search_text_get(tg, &t);
+            search_target_scan(tg, &t, tg->scanned + chunk, s->text, s->text_len);
+            *budget -= chunk;
+            if (tg->match_count != before) changed = true;
+        }
+        if (tg->scanned < limit) pending = true;
     }
 
-    closedir(dir);
-    pith_value_free(path);
+    if (changed) {
+        search_publish(s);
+    }
+    return pending;
+}
 
-    return pith_push(rt, PITH_ARRAY(arr));
+bool pith_runtime_search_step(PithRuntime *rt, size_t budget) {
+    bool pending = false;
+    for (size_t i = 0; i < rt->search_count; i++) {
+        if (search_step(rt->searches[i], &budget)) {
+            pending = true;
+        }
+    }
+    return pending;
 }
 
-/* file-append: ( contents path -- ) */
-static bool builtin_file_append(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 2)) return false;
-    PithValue path = pith_pop(rt);
-    PithValue contents = pith_pop(rt);
+static void search_free(PithSearch *s) {
+    if (!s) return;
+    for (size_t i = 0; i < s->target_count; i++) {
+        free(s->targets[i].matches);
+    }
+    free(s->targets);
+    free(s->text);
+    free(s);
+}
 
-    if (!PITH_IS_STRING(path)) {
-        pith_error(rt, "file-append requires a string path");
-        pith_value_free(path);
-        pith_value_free(contents);
+/* live-search: ( query-signal buffers results-signal -- )
+ * Registers (or re-targets) a live search publishing into results-signal */
+static bool builtin_live_search(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 3)) return false;
+    PithValue results = pith_pop(rt);
+    PithValue buffers = pith_pop(rt);
+    PithValue query = pith_pop(rt);
+
+    if (!PITH_IS_SIGNAL(query) || !PITH_IS_SIGNAL(results)) {
+        pith_error(rt, "live-search requires query and results signals");
+        pith_value_free(buffers);
         return false;
     }
-    if (!PITH_IS_STRING(contents)) {
-        pith_error(rt, "file-append requires string contents");
-        pith_value_free(path);
-        pith_value_free(contents);
+    if (!PITH_IS_ARRAY(buffers)) {
+        pith_error(rt, "live-search requires an array of buffer signals");
+        pith_value_free(buffers);
         return false;
     }
+    PithArray *arr = buffers.as.array;
+    for (size_t i = 0; i < arr->length; i++) {
+        if (!PITH_IS_SIGNAL(arr->items[i])) {
+            pith_error(rt, "live-search requires an array of buffer signals");
+            pith_value_free(buffers);
+            return false;
+        }
+    }
 
-    FILE *f = fopen(path.as.string, "ab");
-    if (!f) {
-        pith_error(rt, "file-append: could not open file for appending");
-        pith_value_free(path);
-        pith_value_free(contents);
-        return false;
+    /* Re-registering for the same results signal replaces the old search,
+     * keeping match state for buffers that are still being searched */
+    PithSearch *old = NULL;
+    size_t index = rt->search_count;
+    for (size_t i = 0; i < rt->search_count; i++) {
+        if (rt->searches[i]->results == results.as.signal) {
+            old = rt->searches[i];
+            index = i;
+            break;
+        }
     }
 
-    size_t len = strlen(contents.as.string);
-    fwrite(contents.as.string, 1, len, f);
-    fclose(f);
+    PithSearch *s = malloc(sizeof(PithSearch));
+    memset(s, 0, sizeof(PithSearch));
+    s->query = query.as.signal;
+    s->results = results.as.signal;
+    s->target_count = arr->length;
+    s->targets = calloc(arr->length ? arr->length : 1, sizeof(PithSearchTarget));
 
-    pith_value_free(path);
-    pith_value_free(contents);
+    for (size_t i = 0; i < arr->length; i++) {
+        PithSearchTarget *tg = &s->targets[i];
+        tg->source = arr->items[i].as.signal;
+        search_target_reset(tg);
+        if (!old || old->query != s->query) continue;
+        for (size_t j = 0; j < old->target_count; j++) {
+            if (old->targets[j].source == tg->source) {
+                *tg = old->targets[j];
+                old->targets[j].matches = NULL;
+                break;
+            }
+        }
+    }
+    if (old && old->query == s->query) {
+        s->text = old->text;
+        s->text_len = old->text_len;
+        s->query_version = old->query_version;
+        s->query_buffer = old->query_buffer;
+        s->query_revision = old->query_revision;
+        old->text = NULL;
+    }
+    search_free(old);
+
+    if (index == rt->search_count) {
+        if (rt->search_count >= rt->search_capacity) {
+            rt->search_capacity = rt->search_capacity ? rt->search_capacity * 2 : 4;
+            rt->searches = realloc(rt->searches, rt->search_capacity * sizeof(PithSearch*));
+        }
+        rt->search_count++;
+    }
+    rt->searches[index] = s;
+
+    pith_value_free(buffers);
+    return true;
+}
+
+/* search-flush: ( -- ) runs pending live searches to completion */
+static bool builtin_search_flush(PithRuntime *rt) {
+    pith_runtime_search_step(rt, (size_t)-1);
     return true;
 }
 
 /* ========================================================================
-   PATH-BASED ACCESS
+   FILE SYSTEM OPERATIONS
    ======================================================================== */
 
-/* set-path: ( value path -- ) sets value at dot-separated path */
-static bool builtin_set_path(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 2)) return false;
+/* write_file flags for the runtime's save-sync setting */
+static int pith_write_flags(PithRuntime *rt) {
+    return rt->save_sync ? PITH_WRITE_SYNC : 0;
+}
+
+/* A whole file as a Pith string, or NULL if it can't be read */
+static char* fs_read_string(const PithFileSystem *fs, const char *path) {
+    size_t len = 0;
+    if (fs->map_file) {
+        const char *data = fs->map_file(path, &len, fs->userdata);
+        if (!data) return NULL;
+        char *contents = pith_string_new(data, len);
+        fs->unmap_file(data, len, fs->userdata);
+        return contents;
+    }
+
+    char *data = fs->read_file(path, &len, fs->userdata);
+    if (!data) return NULL;
+    char *contents = pith_string_new(data, len);
+    free(data);
+    return contents;
+}
+
+/* Append through the file system, rewriting the file if it can't append */
+static bool fs_append(const PithFileSystem *fs, const char *path,
+                      const char *contents, size_t len, int flags) {
+    if (fs->append_file) return fs->append_file(path, contents, len, fs->userdata);
+
+    size_t old_len = 0;
+    char *old = fs->read_file(path, &old_len, fs->userdata);
+    char *joined = malloc(old_len + len + 1);
+    if (old) memcpy(joined, old, old_len);
+    memcpy(joined + old_len, contents, len);
+    joined[old_len + len] = '\0';
+    bool ok = fs->write_file(path, joined, old_len + len, flags, fs->userdata);
+    free(joined);
+    free(old);
+    return ok;
+}
+
+/* file-read: ( path -- contents ) */
+static bool builtin_file_read(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
     PithValue path = pith_pop(rt);
-    PithValue value = pith_pop(rt);
 
     if (!PITH_IS_STRING(path)) {
-        pith_error(rt, "set-path requires a string path");
+        pith_error(rt, "file-read requires a string path");
         pith_value_free(path);
-        pith_value_free(value);
         return false;
     }
 
-    /* Parse path "a.b.c" into parts */
-    char *path_copy = pith_strdup(path.as.string);
-    char *parts[64];
-    int part_count = 0;
+    char *contents = fs_read_string(&rt->fs, path.as.string);
+    pith_value_free(path);
+    if (!contents) return pith_push(rt, PITH_NIL());
 
-    char *token = strtok(path_copy, ".");
-    while (token && part_count < 64) {
-        parts[part_count++] = token;
-        token = strtok(NULL, ".");
-    }
+    return pith_push(rt, PITH_STRING(contents));
+}
 
-    if (part_count == 0) {
-        pith_error(rt, "set-path: empty path");
-        free(path_copy);
+/* file-write: ( contents path -- ) */
+static bool builtin_file_write(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue path = pith_pop(rt);
+    PithValue contents = pith_pop(rt);
+
+    if (!PITH_IS_STRING(path)) {
+        pith_error(rt, "file-write requires a string path");
         pith_value_free(path);
-        pith_value_free(value);
+        pith_value_free(contents);
         return false;
     }
-
-    /* Find the root dictionary */
-    PithDict *current = pith_find_dict(rt, parts[0]);
-    if (!current) {
-        pith_error(rt, "set-path: unknown dictionary '%s'", parts[0]);
-        free(path_copy);
+    if (!PITH_IS_STRING(contents)) {
+        pith_error(rt, "file-write requires string contents");
         pith_value_free(path);
-        pith_value_free(value);
+        pith_value_free(contents);
         return false;
     }
 
-    /* Traverse to the parent of the final slot */
-    for (int i = 1; i < part_count - 1; i++) {
-        PithSlot *slot = pith_dict_lookup(current, parts[i]);
-        if (!slot) {
-            pith_error(rt, "set-path: unknown slot '%s'", parts[i]);
-            free(path_copy);
-            pith_value_free(path);
-            pith_value_free(value);
-            return false;
-        }
+    size_t len = pith_string_length(contents.as.string);
+    bool ok = rt->fs.write_file(path.as.string, contents.as.string, len,
+                                pith_write_flags(rt), rt->fs.userdata);
+    pith_value_free(path);
+    pith_value_free(contents);
+    if (!ok) {
+        pith_error(rt, "file-write: could not write file");
+        return false;
+    }
+    return true;
+}
 
-        if (slot->is_cached && slot->cached.type == VAL_DICT) {
-            current = slot->cached.as.dict;
-        } else if (!slot->is_cached) {
-            /* Execute slot to get value */
-            PithDict *saved_dict = rt->current_dict;
-            rt->current_dict = current;
-            if (!pith_execute_slot(rt, slot)) {
-                rt->current_dict = saved_dict;
-                free(path_copy);
-                pith_value_free(path);
-                pith_value_free(value);
-                return false;
-            }
-            rt->current_dict = saved_dict;
+/* file-exists: ( path -- bool ) */
+static bool builtin_file_exists(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue path = pith_pop(rt);
 
-            PithValue val = pith_pop(rt);
-            if (val.type != VAL_DICT) {
-                pith_error(rt, "set-path: '%s' is not a dictionary", parts[i]);
-                pith_value_free(val);
-                free(path_copy);
-                pith_value_free(path);
-                pith_value_free(value);
-                return false;
-            }
-            current = val.as.dict;
-            /* Don't free val - we're using its dict pointer */
-        } else {
-            pith_error(rt, "set-path: '%s' is not a dictionary", parts[i]);
-            free(path_copy);
-            pith_value_free(path);
-            pith_value_free(value);
-            return false;
-        }
+    if (!PITH_IS_STRING(path)) {
+        pith_error(rt, "file-exists requires a string path");
+        pith_value_free(path);
+        return false;
     }
 
-    /* Set the final slot */
-    const char *final_name = parts[part_count - 1];
-    pith_dict_set_value(current, final_name, value);
-
-    free(path_copy);
+    bool exists = rt->fs.file_exists(path.as.string, rt->fs.userdata);
     pith_value_free(path);
-    return true;
+
+    return pith_push(rt, PITH_BOOL(exists));
 }
 
-/* get-path: ( path -- value ) gets value at dot-separated path */
-static bool builtin_get_path(PithRuntime *rt) {
+/* file-stat: ( path -- map ) size, modified (seconds since the epoch) and
+ * dir of a path, or nil if it doesn't exist */
+static bool builtin_file_stat(PithRuntime *rt) {
     if (!pith_stack_has(rt, 1)) return false;
     PithValue path = pith_pop(rt);
 
     if (!PITH_IS_STRING(path)) {
-        pith_error(rt, "get-path requires a string path");
+        pith_error(rt, "file-stat requires a string path");
         pith_value_free(path);
         return false;
     }
 
-    /* Parse path "a.b.c" into parts */
-    char *path_copy = pith_strdup(path.as.string);
-    char *parts[64];
-    int part_count = 0;
-
-    char *token = strtok(path_copy, ".");
-    while (token && part_count < 64) {
-        parts[part_count++] = token;
-        token = strtok(NULL, ".");
+    PithFileStat st = {0};
+    bool found;
+    if (rt->fs.stat_file) {
+        found = rt->fs.stat_file(path.as.string, &st, rt->fs.userdata);
+    } else {
+        /* Without stat, only the size of a readable file is known */
+        char *data = rt->fs.read_file(path.as.string, &st.size, rt->fs.userdata);
+        found = data || rt->fs.file_exists(path.as.string, rt->fs.userdata);
+        st.is_dir = found && !data;
+        free(data);
     }
+    pith_value_free(path);
+    if (!found) return pith_push(rt, PITH_NIL());
 
-    if (part_count == 0) {
-        pith_error(rt, "get-path: empty path");
-        free(path_copy);
+    PithDict *map = pith_dict_new(NULL);
+    pith_dict_set_value(map, "size", PITH_NUMBER((double)st.size));
+    pith_dict_set_value(map, "modified", PITH_NUMBER(st.modified));
+    pith_dict_set_value(map, "dir", PITH_BOOL(st.is_dir));
+    return pith_push(rt, PITH_DICT(map));
+}
+
+/* dir-list: ( path -- array ) */
+static bool builtin_dir_list(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue path = pith_pop(rt);
+
+    if (!PITH_IS_STRING(path)) {
+        pith_error(rt, "dir-list requires a string path");
         pith_value_free(path);
         return false;
     }
 
-    /* Find the root dictionary */
-    PithDict *current = pith_find_dict(rt, parts[0]);
-    if (!current) {
-        pith_error(rt, "get-path: unknown dictionary '%s'", parts[0]);
-        free(path_copy);
-        pith_value_free(path);
-        return false;
+    size_t count = 0;
+    char **entries = NULL;
+    if (rt->fs.list_dir) {
+        entries = rt->fs.list_dir(path.as.string, &count, rt->fs.userdata);
     }
+    pith_value_free(path);
+    if (!entries) return pith_push(rt, PITH_NIL());
 
-    /* Traverse to the final slot */
-    for (int i = 1; i < part_count; i++) {
-        PithSlot *slot = pith_dict_lookup(current, parts[i]);
-        if (!slot) {
-            pith_error(rt, "get-path: unknown slot '%s'", parts[i]);
-            free(path_copy);
-            pith_value_free(path);
-            return false;
+    /* The file system gives full paths; dir-list gives names */
+    PithArray *arr = pith_array_new();
+    for (size_t i = 0; i < count; i++) {
+        const char *name = entries[i];
+        for (const char *p = entries[i]; *p; p++) {
+            if (*p == '/' || *p == '\\') name = p + 1;
         }
+        pith_array_push(arr, PITH_STRING(pith_string_dup(name)));
+        free(entries[i]);
+    }
+    free(entries);
 
-        if (i == part_count - 1) {
-            /* Final slot - return its value */
-            if (slot->is_cached) {
-                free(path_copy);
-                pith_value_free(path);
-                return pith_push(rt, pith_value_copy(slot->cached));
-            } else {
-                /* Execute slot to get value */
-                PithDict *saved_dict = rt->current_dict;
-                rt->current_dict = current;
-                bool result = pith_execute_slot(rt, slot);
-                rt->current_dict = saved_dict;
-                free(path_copy);
-                pith_value_free(path);
-                return result;
-            }
-        } else {
-            /* Intermediate slot - must be a dictionary */
-            if (slot->is_cached && slot->cached.type == VAL_DICT) {
-                current = slot->cached.as.dict;
-            } else {
-                pith_error(rt, "get-path: '%s' is not a dictionary", parts[i]);
-                free(path_copy);
-                pith_value_free(path);
-                return false;
-            }
-        }
+    return pith_push(rt, PITH_ARRAY(arr));
+}
+
+/* file-append: ( contents path -- ) */
+static bool builtin_file_append(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue path = pith_pop(rt);
+    PithValue contents = pith_pop(rt);
+
+    if (!PITH_IS_STRING(path)) {
+        pith_error(rt, "file-append requires a string path");
+        pith_value_free(path);
+        pith_value_free(contents);
+        return false;
+    }
+    if (!PITH_IS_STRING(contents)) {
+        pith_error(rt, "file-append requires string contents");
+        pith_value_free(path);
+        pith_value_free(contents);
+        return false;
     }
 
-    /* Should not reach here, but handle single-part path */
-    free(path_copy);
+    size_t len = pith_string_length(contents.as.string);
+    bool ok = fs_append(&rt->fs, path.as.string, contents.as.string, len, pith_write_flags(rt));
     pith_value_free(path);
-    pith_error(rt, "get-path: invalid path");
-    return false;
+    pith_value_free(contents);
+    if (!ok) {
+        pith_error(rt, "file-append: could not append to file");
+        return false;
+    }
+    return true;
 }
 
-/* Printing */
-static bool builtin_print(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue a = pith_pop(rt);
-    char *str = pith_value_to_string(a);
-    printf("%s\n", str);
-    free(str);
-    pith_value_free(a);
-    return true;
+/* ========================================================================
+   SEQUENCES
+   A sequence value is a recipe for items, not a cursor: every word that
+   walks it starts from the beginning, so dup'd copies behave like arrays.
+   Walking produces one item at a time, so a sequence over a file never
+   holds more than the current line.
+
+   map, filter, take and skip on a sequence only add a stage in front of
+   their source. The stages run when the result is walked, item by item,
+   so a pipeline is a single pass that stops as soon as its consumer does.
+   ======================================================================== */
+
+typedef enum {
+    SEQ_FILE_LINES,
+    SEQ_RANGE,
+    SEQ_ARRAY,
+    SEQ_MAP,
+    SEQ_FILTER,
+    SEQ_TAKE,
+    SEQ_SKIP,
+} PithSeqKind;
+
+struct PithSeq {
+    atomic_size_t refs;         /* Copies may be freed on worker threads */
+    PithSeqKind kind;
+    char *path;                 /* SEQ_FILE_LINES */
+    double start, end;          /* SEQ_RANGE, end excluded */
+    PithArray *array;           /* SEQ_ARRAY, never modified */
+    PithSeq *source;            /* Stages: the sequence they read from */
+    PithBlock *block;           /* SEQ_MAP, SEQ_FILTER */
+    size_t count;               /* SEQ_TAKE, SEQ_SKIP */
+};
+
+static PithSeq* seq_new(PithSeqKind kind) {
+    PithSeq *seq = calloc(1, sizeof(PithSeq));
+    atomic_init(&seq->refs, 1);
+    seq->kind = kind;
+    return seq;
 }
 
-/* UI primitives */
-static bool builtin_text(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue a = pith_pop(rt);
-    if (!PITH_IS_STRING(a)) {
-        pith_error(rt, "text requires string");
-        return false;
+static PithSeq* seq_retain(PithSeq *seq) {
+    atomic_fetch_add(&seq->refs, 1);
+    return seq;
+}
+
+static void seq_release(PithSeq *seq) {
+    while (seq && atomic_fetch_sub(&seq->refs, 1) == 1) {
+        PithSeq *source = seq->source;
+        free(seq->path);
+        if (seq->array) pith_array_free(seq->array);
+        free(seq->block);
+        free(seq);
+        seq = source;
     }
-    PithView *view = pith_view_text(a.as.string);
-    pith_value_free(a);
-    return pith_push(rt, PITH_VIEW(view));
 }
 
-static bool builtin_textfield(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue a = pith_pop(rt);
+/* A sequence reading from source (an array or sequence value, consumed) */
+static PithSeq* seq_stage(PithSeqKind kind, PithValue source) {
+    PithSeq *seq = seq_new(kind);
+    if (PITH_IS_SEQ(source)) {
+        seq->source = source.as.seq;
+    } else {
+        seq->source = seq_new(SEQ_ARRAY);
+        seq->source->array = source.as.array;
+    }
+    return seq;
+}
 
-    PithView *view = NULL;
-    PithSignal *source_signal = NULL;
+/* Sequences whose stages hold blocks can't leave their runtime */
+static PithValue seq_sanitize(PithSeq *seq) {
+    for (PithSeq *s = seq; s; s = s->source) {
+        if (s->block) return PITH_NIL();
+    }
+    if (seq->kind == SEQ_ARRAY) {
+        PithSeq *copy = seq_new(SEQ_ARRAY);
+        copy->array = pith_array_sanitize(seq->array);
+        return PITH_SEQ(copy);
+    }
+    if (seq->source) {
+        PithValue source = seq_sanitize(seq->source);
+        PithSeq *copy = seq_new(seq->kind);
+        copy->source = source.as.seq;
+        copy->count = seq->count;
+        return PITH_SEQ(copy);
+    }
+    return PITH_SEQ(seq_retain(seq));
+}
 
-    if (PITH_IS_SIGNAL(a)) {
-        /* Create textfield from signal - store reference for blur updates */
-        source_signal = a.as.signal;
-        PithValue val = pith_signal_get(source_signal);
+/* Walks an array or a sequence one item at a time */
+typedef struct PithIter PithIter;
+struct PithIter {
+    PithArray *array;           /* Set when walking an array */
+    size_t index;
 
-        /* If signal contains a string, convert to gap buffer and store back */
-        if (PITH_IS_STRING(val)) {
-            PithGapBuffer *gb = pith_gapbuf_from_string(val.as.string);
-            pith_signal_set(source_signal, PITH_GAPBUF(gb));
-            val = pith_signal_get(source_signal);
-        }
+    PithSeq *seq;
+    PithIter *inner;            /* Walk of a stage's source */
+    double next;                /* SEQ_RANGE */
+    size_t count;               /* Items taken or skipped so far */
 
-        /* Use the gap buffer from the signal directly (signal owns it) */
-        if (PITH_IS_GAPBUF(val)) {
-            view = malloc(sizeof(PithView));
-            memset(view, 0, sizeof(PithView));
-            view->type = VIEW_TEXTFIELD;
-            view->as.textfield.buffer = val.as.gapbuf;  /* Reference, not copy */
-            view->as.textfield.on_change = NULL;
-            view->as.textfield.source_signal = source_signal;
-        } else {
-            /* Fallback for unexpected types */
-            view = pith_view_textfield("", NULL);
-            view->as.textfield.source_signal = source_signal;
-        }
-    } else if (PITH_IS_STRING(a)) {
-        /* Create textfield from string */
-        view = pith_view_textfield(a.as.string, NULL);
-        pith_value_free(a);
-    } else if (PITH_IS_GAPBUF(a)) {
-        /* Create textfield with existing gap buffer */
-        view = malloc(sizeof(PithView));
-        memset(view, 0, sizeof(PithView));
-        view->type = VIEW_TEXTFIELD;
-        view->as.textfield.buffer = pith_gapbuf_copy(a.as.gapbuf);
-        view->as.textfield.on_change = NULL;
-        pith_value_free(a);
+    const PithFileSystem *fs;   /* SEQ_FILE_LINES */
+    const char *data;           /* File contents (mapped or read) */
+    size_t len;
+    size_t pos;
+    bool mapped;
+    bool started;               /* A line has been produced */
+    bool done;
+};
+
+static bool iter_source_ok(PithValue source) {
+    return PITH_IS_ARRAY(source) || PITH_IS_SEQ(source);
+}
+
+static void iter_close(PithIter *it);
+
+static bool iter_open_seq(PithRuntime *rt, PithIter *it, PithSeq *seq, const char *word) {
+    memset(it, 0, sizeof(PithIter));
+    it->seq = seq;
+    switch (seq->kind) {
+        case SEQ_ARRAY:
+            it->array = seq->array;
+            return true;
+        case SEQ_RANGE:
+            it->next = seq->start;
+            return true;
+        case SEQ_FILE_LINES:
+            it->fs = &rt->fs;
+            if (it->fs->map_file) {
+                it->data = it->fs->map_file(seq->path, &it->len, it->fs->userdata);
+                it->mapped = true;
+            } else {
+                it->data = it->fs->read_file(seq->path, &it->len, it->fs->userdata);
+            }
+            if (!it->data) {
+                pith_error(rt, "%s: could not read '%s'", word, seq->path);
+                return false;
+            }
+            return true;
+        default:
+            it->inner = malloc(sizeof(PithIter));
+            if (!iter_open_seq(rt, it->inner, seq->source, word)) {
+                free(it->inner);
+                it->inner = NULL;
+                return false;
+            }
+            return true;
+    }
+}
+
+/* Start walking source (an array or sequence, which must outlive the walk) */
+static bool iter_open(PithRuntime *rt, PithIter *it, PithValue source, const char *word) {
+    if (PITH_IS_ARRAY(source)) {
+        memset(it, 0, sizeof(PithIter));
+        it->array = source.as.array;
+        return true;
+    }
+    return iter_open_seq(rt, it, source.as.seq, word);
+}
+
+/* Next item as a value the caller owns, or false at the end (or when a
+ * stage's block fails). Lines split the way the lines word does. */
+static bool iter_next(PithRuntime *rt, PithIter *it, PithValue *out) {
+    if (it->array) {
+        if (it->index >= it->array->length) return false;
+        *out = pith_value_copy(it->array->items[it->index++]);
+        return true;
+    }
+
+    PithSeq *seq = it->seq;
+    switch (seq->kind) {
+        case SEQ_RANGE:
+            if (it->next >= seq->end) return false;
+            *out = PITH_NUMBER(it->next);
+            it->next += 1;
+            return true;
+
+        case SEQ_MAP:
+            while (iter_next(rt, it->inner, out)) {
+                pith_push(rt, *out);
+                pith_execute_block(rt, seq->block);
+                if (rt->has_error) return false;
+                /* Like map on arrays, a block that leaves nothing drops the item */
+                if (pith_stack_has(rt, 1)) {
+                    *out = pith_pop(rt);
+                    return true;
+                }
+            }
+            return false;
+
+        case SEQ_FILTER:
+            while (iter_next(rt, it->inner, out)) {
+                pith_push(rt, pith_value_copy(*out));
+                pith_execute_block(rt, seq->block);
+                bool keep = false;
+                if (!rt->has_error && pith_stack_has(rt, 1)) {
+                    PithValue result = pith_pop(rt);
+                    if (PITH_IS_BOOL(result)) keep = result.as.boolean;
+                    else if (PITH_IS_NUMBER(result)) keep = result.as.number != 0;
+                    else if (!PITH_IS_NIL(result)) keep = true;
+                    pith_value_free(result);
+                }
+                if (keep) return true;
+                pith_value_free(*out);
+                if (rt->has_error) return false;
+            }
+            return false;
+
+        case SEQ_TAKE:
+            if (it->count >= seq->count) return false;
+            it->count++;
+            return iter_next(rt, it->inner, out);
+
+        case SEQ_SKIP:
+            while (it->count < seq->count) {
+                if (!iter_next(rt, it->inner, out)) return false;
+                pith_value_free(*out);
+                it->count++;
+            }
+            return iter_next(rt, it->inner, out);
+
+        case SEQ_FILE_LINES:
+        default:
+            break;
+    }
+
+    if (it->done) return false;
+    const char *line = it->data + it->pos;
+    const char *nl = memchr(line, '\n', it->len - it->pos);
+    if (nl) {
+        *out = PITH_STRING(pith_string_new(line, nl - line));
+        it->pos = nl - it->data + 1;
+        it->started = true;
+        return true;
+    }
+    it->done = true;
+    if (it->pos < it->len || !it->started) {
+        *out = PITH_STRING(pith_string_new(line, it->len - it->pos));
+        return true;
+    }
+    return false;
+}
+
+static void iter_close(PithIter *it) {
+    if (it->inner) {
+        iter_close(it->inner);
+        free(it->inner);
+    }
+    if (!it->data) return;
+    if (it->mapped) {
+        it->fs->unmap_file(it->data, it->len, it->fs->userdata);
     } else {
-        pith_error(rt, "textfield requires string, gapbuf, or signal");
+        free((char *)it->data);
+    }
+}
+
+/* file-lines: ( path -- seq ) the lines of a file, read as they are
+ * walked by each, filter, reduce or find; nil if the file doesn't exist */
+static bool builtin_file_lines(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue path = pith_pop(rt);
+
+    if (!PITH_IS_STRING(path)) {
+        pith_error(rt, "file-lines requires a string path");
+        pith_value_free(path);
         return false;
     }
+    if (!rt->fs.file_exists(path.as.string, rt->fs.userdata)) {
+        pith_value_free(path);
+        return pith_push(rt, PITH_NIL());
+    }
 
-    return pith_push(rt, PITH_VIEW(view));
+    PithSeq *seq = seq_new(SEQ_FILE_LINES);
+    seq->path = pith_strdup(path.as.string);
+    pith_value_free(path);
+    return pith_push(rt, PITH_SEQ(seq));
 }
 
-static bool builtin_textarea(PithRuntime *rt) {
+/* range: ( start end -- seq ) the numbers start, start+1, ... below end */
+static bool builtin_range(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue end = pith_pop(rt);
+    PithValue start = pith_pop(rt);
+
+    if (!PITH_IS_NUMBER(start) || !PITH_IS_NUMBER(end)) {
+        pith_error(rt, "range requires two numbers");
+        pith_value_free(start);
+        pith_value_free(end);
+        return false;
+    }
+
+    PithSeq *seq = seq_new(SEQ_RANGE);
+    seq->start = start.as.number;
+    seq->end = end.as.number;
+    return pith_push(rt, PITH_SEQ(seq));
+}
+
+/* lazy: ( array -- seq ) so map and filter on it become stages */
+static bool builtin_lazy(PithRuntime *rt) {
     if (!pith_stack_has(rt, 1)) return false;
-    PithValue a = pith_pop(rt);
+    PithValue source = pith_pop(rt);
 
-    PithView *view = NULL;
-    PithSignal *source_signal = NULL;
+    if (PITH_IS_SEQ(source)) return pith_push(rt, source);
+    if (!PITH_IS_ARRAY(source)) {
+        pith_error(rt, "lazy requires an array");
+        pith_value_free(source);
+        return false;
+    }
 
-    if (PITH_IS_SIGNAL(a)) {
-        /* Create textarea from signal - store reference for blur updates */
-        source_signal = a.as.signal;
-        PithValue val = pith_signal_get(source_signal);
+    PithSeq *seq = seq_new(SEQ_ARRAY);
+    seq->array = source.as.array;
+    return pith_push(rt, PITH_SEQ(seq));
+}
 
-        /* If signal contains a string, convert to gap buffer and store back */
-        if (PITH_IS_STRING(val)) {
-            PithGapBuffer *gb = pith_gapbuf_from_string(val.as.string);
-            pith_signal_set(source_signal, PITH_GAPBUF(gb));
-            val = pith_signal_get(source_signal);
-        }
+/* take / skip: ( seq n -- seq ) the first n items, or all but them */
+static bool seq_push_count_stage(PithRuntime *rt, PithSeqKind kind, const char *word) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue n = pith_pop(rt);
+    PithValue source = pith_pop(rt);
 
-        /* Use the gap buffer from the signal directly (signal owns it) */
-        if (PITH_IS_GAPBUF(val)) {
-            view = malloc(sizeof(PithView));
-            memset(view, 0, sizeof(PithView));
-            view->type = VIEW_TEXTAREA;
-            view->as.textarea.buffer = val.as.gapbuf;  /* Reference, not copy */
-            view->as.textarea.on_change = NULL;
-            view->as.textarea.scroll_offset = 0;
-            view->as.textarea.source_signal = source_signal;
-        } else {
-            /* Fallback for unexpected types */
-            view = pith_view_textarea("", NULL);
-            view->as.textarea.source_signal = source_signal;
-        }
-    } else if (PITH_IS_STRING(a)) {
-        view = pith_view_textarea(a.as.string, NULL);
-        pith_value_free(a);
-    } else if (PITH_IS_GAPBUF(a)) {
-        view = malloc(sizeof(PithView));
-        memset(view, 0, sizeof(PithView));
-        view->type = VIEW_TEXTAREA;
-        view->as.textarea.buffer = pith_gapbuf_copy(a.as.gapbuf);
-        view->as.textarea.on_change = NULL;
-        view->as.textarea.scroll_offset = 0;
-        pith_value_free(a);
-    } else {
-        pith_error(rt, "textarea requires string, gapbuf, or signal");
+    if (!iter_source_ok(source) || !PITH_IS_NUMBER(n)) {
+        pith_error(rt, "%s requires an array or sequence and a number", word);
+        pith_value_free(source);
+        pith_value_free(n);
         return false;
     }
 
-    return pith_push(rt, PITH_VIEW(view));
+    PithSeq *seq = seq_stage(kind, source);
+    seq->count = n.as.number > 0 ? (size_t)n.as.number : 0;
+    return pith_push(rt, PITH_SEQ(seq));
 }
 
-static bool builtin_signal(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue initial = pith_pop(rt);
-    PithSignal *sig = pith_signal_new(rt, initial);
-    return pith_push(rt, PITH_SIGNAL(sig));
+static bool builtin_take(PithRuntime *rt) {
+    return seq_push_count_stage(rt, SEQ_TAKE, "take");
 }
 
-static bool builtin_deref(PithRuntime *rt) {
-    /* Dereference a signal to get its value. Non-signals pass through unchanged. */
+static bool builtin_skip(PithRuntime *rt) {
+    return seq_push_count_stage(rt, SEQ_SKIP, "skip");
+}
+
+/* collect: ( seq -- array ) walk a sequence into an array */
+static bool builtin_collect(PithRuntime *rt) {
     if (!pith_stack_has(rt, 1)) return false;
-    PithValue a = pith_pop(rt);
-    if (PITH_IS_SIGNAL(a)) {
-        PithValue val = pith_value_copy(pith_signal_get(a.as.signal));
-        return pith_push(rt, val);
+    PithValue source = pith_pop(rt);
+
+    if (PITH_IS_ARRAY(source)) return pith_push(rt, source);
+    if (!PITH_IS_SEQ(source)) {
+        pith_error(rt, "collect requires a sequence");
+        pith_value_free(source);
+        return false;
     }
-    /* Non-signal values pass through */
-    return pith_push(rt, a);
+
+    PithIter it;
+    if (!iter_open(rt, &it, source, "collect")) {
+        pith_value_free(source);
+        return false;
+    }
+    PithArray *output = pith_array_new();
+    PithValue item;
+    while (!rt->has_error && iter_next(rt, &it, &item)) {
+        pith_array_push(output, item);
+    }
+    iter_close(&it);
+    pith_value_free(source);
+
+    if (rt->has_error) {
+        pith_array_free(output);
+        return false;
+    }
+    return pith_push(rt, PITH_ARRAY(output));
 }
 
-static bool builtin_button(PithRuntime *rt) {
-    /* ( label block -- view ) or ( label -- view ) */
-    if (!pith_stack_has(rt, 1)) return false;
+/* ========================================================================
+   PATH-BASED ACCESS
+   ======================================================================== */
 
-    PithBlock *on_click = NULL;
-    PithValue top = pith_peek(rt);
+/* Split "a.b.c" in place on dots, skipping empty parts (like strtok,
+ * but without its hidden state, so runtimes on other threads are safe) */
+static int split_path(char *path, char **parts, int max) {
+    int count = 0;
+    char *p = path;
+    while (*p && count < max) {
+        while (*p == '.') p++;
+        if (!*p) break;
+        parts[count++] = p;
+        while (*p && *p != '.') p++;
+        if (*p) *p++ = '\0';
+    }
+    return count;
+}
 
-    /* Check if top of stack is a block (on-click handler) */
-    if (PITH_IS_BLOCK(top)) {
-        on_click = malloc(sizeof(PithBlock));
-        *on_click = *pith_pop(rt).as.block;
-        if (!pith_stack_has(rt, 1)) {
-            free(on_click);
-            pith_error(rt, "button requires label");
-            return false;
-        }
+/* set-path: ( value path -- ) sets value at dot-separated path */
+static bool builtin_set_path(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue path = pith_pop(rt);
+    PithValue value = pith_pop(rt);
+
+    if (!PITH_IS_STRING(path)) {
+        pith_error(rt, "set-path requires a string path");
+        pith_value_free(path);
+        pith_value_free(value);
+        return false;
     }
 
-    PithValue label_val = pith_pop(rt);
-    if (!PITH_IS_STRING(label_val)) {
-        free(on_click);
-        pith_error(rt, "button requires string label");
+    /* Parse path "a.b.c" into parts */
+    char *path_copy = pith_strdup(path.as.string);
+    char *parts[64];
+    int part_count = split_path(path_copy, parts, 64);
+
+    if (part_count == 0) {
+        pith_error(rt, "set-path: empty path");
+        free(path_copy);
+        pith_value_free(path);
+        pith_value_free(value);
         return false;
     }
 
-    PithView *view = pith_view_button(label_val.as.string, on_click);
-    pith_value_free(label_val);
-    return pith_push(rt, PITH_VIEW(view));
+    /* Find the root dictionary */
+    PithDict *current = pith_find_dict(rt, parts[0]);
+    if (!current) {
+        pith_error(rt, "set-path: unknown dictionary '%s'", parts[0]);
+        free(path_copy);
+        pith_value_free(path);
+        pith_value_free(value);
+        return false;
+    }
+
+    /* Traverse to the parent of the final slot */
+    for (int i = 1; i < part_count - 1; i++) {
+        PithSlot *slot = pith_dict_lookup(current, parts[i]);
+        if (!slot) {
+            pith_error(rt, "set-path: unknown slot '%s'", parts[i]);
+            free(path_copy);
+            pith_value_free(path);
+            pith_value_free(value);
+            return false;
+        }
+
+        if (slot->is_cached && slot->cached.type == VAL_DICT) {
+            current = slot->cached.as.dict;
+        } else if (!slot->is_cached) {
+            /* Execute slot to get value */
+            PithDict *saved_dict = rt->current_dict;
+            rt->current_dict = current;
+            if (!pith_execute_slot(rt, slot)) {
+                rt->current_dict = saved_dict;
+                free(path_copy);
+                pith_value_free(path);
+                pith_value_free(value);
+                return false;
+            }
+            rt->current_dict = saved_dict;
+
+            PithValue val = pith_pop(rt);
+            if (val.type != VAL_DICT) {
+                pith_error(rt, "set-path: '%s' is not a dictionary", parts[i]);
+                pith_value_free(val);
+                free(path_copy);
+                pith_value_free(path);
+                pith_value_free(value);
+                return false;
+            }
+            current = val.as.dict;
+            /* Don't free val - we're using its dict pointer */
+        } else {
+            pith_error(rt, "set-path: '%s' is not a dictionary", parts[i]);
+            free(path_copy);
+            pith_value_free(path);
+            pith_value_free(value);
+            return false;
+        }
+    }
+
+    /* Set the final slot */
+    const char *final_name = parts[part_count - 1];
+    pith_dict_set_value(current, final_name, value);
+
+    free(path_copy);
+    pith_value_free(path);
+    return true;
+}
+
+/* get-path: ( path -- value ) gets value at dot-separated path */
+static bool builtin_get_path(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue path = pith_pop(rt);
+
+    if (!PITH_IS_STRING(path)) {
+        pith_error(rt, "get-path requires a string path");
+        pith_value_free(path);
+        return false;
+    }
+
+    /* Parse path "a.b.c" into parts */
+    char *path_copy = pith_strdup(path.as.string);
+    char *parts[64];
+    int part_count = split_path(path_copy, parts, 64);
+
+    if (part_count == 0) {
+        pith_error(rt, "get-path: empty path");
+        free(path_copy);
+        pith_value_free(path);
+        return false;
+    }
+
+    /* Find the root dictionary */
+    PithDict *current = pith_find_dict(rt, parts[0]);
+    if (!current) {
+        pith_error(rt, "get-path: unknown dictionary '%s'", parts[0]);
+        free(path_copy);
+        pith_value_free(path);
+        return false;
+    }
+
+    /* Traverse to the final slot */
+    for (int i = 1; i < part_count; i++) {
+        PithSlot *slot = pith_dict_lookup(current, parts[i]);
+        if (!slot) {
+            pith_error(rt, "get-path: unknown slot '%s'", parts[i]);
+            free(path_copy);
+            pith_value_free(path);
+            return false;
+        }
+
+        if (i == part_count - 1) {
+            /* Final slot - return its value */
+            if (slot->is_cached) {
+                free(path_copy);
+                pith_value_free(path);
+                return pith_push(rt, pith_value_copy(slot->cached));
+            } else {
+                /* Execute slot to get value */
+                PithDict *saved_dict = rt->current_dict;
+                rt->current_dict = current;
+                bool result = pith_execute_slot(rt, slot);
+                rt->current_dict = saved_dict;
+                free(path_copy);
+                pith_value_free(path);
+                return result;
+            }
+        } else {
+            /* Intermediate slot - must be a dictionary */
+            if (slot->is_cached && slot->cached.type == VAL_DICT) {
+                current = slot->cached.as.dict;
+            } else {
+                pith_error(rt, "get-path: '%s' is not a dictionary", parts[i]);
+                free(path_copy);
+                pith_value_free(path);
+                return false;
+            }
+        }
+    }
+
+    /* Should not reach here, but handle single-part path */
+    free(path_copy);
+    pith_value_free(path);
+    pith_error(rt, "get-path: invalid path");
+    return false;
+}
+
+/* Printing */
+static bool builtin_print(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue a = pith_pop(rt);
+    if (PITH_IS_STRING(a)) {
+        fwrite(a.as.string, 1, pith_string_length(a.as.string), rt->out);
+        fputc('\n', rt->out);
+    } else {
+        char *str = pith_value_to_string(a);
+        fprintf(rt->out, "%s\n", str);
+        free(str);
+    }
+    pith_value_free(a);
+    return true;
+}
+
+/* UI primitives */
+static bool builtin_text(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue a = pith_pop(rt);
+    if (!PITH_IS_STRING(a)) {
+        pith_error(rt, "text requires string");
+        return false;
+    }
+    PithView *view = pith_view_text(a.as.string);
+    pith_value_free(a);
+    return pith_push(rt, PITH_VIEW(view));
+}
+
+static bool builtin_textfield(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue a = pith_pop(rt);
+
+    PithView *view = NULL;
+    PithSignal *source_signal = NULL;
+
+    if (PITH_IS_SIGNAL(a)) {
+        /* Create textfield from signal - store reference for blur updates */
+        source_signal = a.as.signal;
+        PithValue val = pith_signal_get(source_signal);
+
+        /* If signal contains a string, convert to gap buffer and store back */
+        if (PITH_IS_STRING(val)) {
+            PithGapBuffer *gb = pith_gapbuf_from_string(val.as.string);
+            pith_signal_set(source_signal, PITH_GAPBUF(gb));
+            val = pith_signal_get(source_signal);
+        }
+
+        /* Use the gap buffer from the signal directly (signal owns it) */
+        if (PITH_IS_GAPBUF(val)) {
+            view = malloc(sizeof(PithView));
+            memset(view, 0, sizeof(PithView));
+            view->type = VIEW_TEXTFIELD;
+            view->as.textfield.buffer = val.as.gapbuf;  /* Reference, not copy */
+            view->as.textfield.on_change = NULL;
+            view->as.textfield.source_signal = source_signal;
+        } else {
+            /* Fallback for unexpected types */
+            view = pith_view_textfield("", NULL);
+            view->as.textfield.source_signal = source_signal;
+        }
+    } else if (PITH_IS_STRING(a)) {
+        /* Create textfield from string */
+        view = pith_view_textfield(a.as.string, NULL);
+        pith_value_free(a);
+    } else if (PITH_IS_GAPBUF(a)) {
+        /* Create textfield with existing gap buffer */
+        view = malloc(sizeof(PithView));
+        memset(view, 0, sizeof(PithView));
+        view->type = VIEW_TEXTFIELD;
+        view->as.textfield.buffer = pith_gapbuf_copy(a.as.gapbuf);
+        view->as.textfield.on_change = NULL;
+        pith_value_free(a);
+    } else {
+        pith_error(rt, "textfield requires string, gapbuf, or signal");
+        return false;
+    }
+
+    return pith_push(rt, PITH_VIEW(view));
+}
+
+static bool builtin_textarea(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue a = pith_pop(rt);
+
+    PithView *view = NULL;
+    PithSignal *source_signal = NULL;
+
+    if (PITH_IS_SIGNAL(a)) {
+        /* Create textarea from signal - store reference for blur updates */
+        source_signal = a.as.signal;
+        PithValue val = pith_signal_get(source_signal);
+
+        /* If signal contains a string, convert to gap buffer and store back */
+        if (PITH_IS_STRING(val)) {
+            PithGapBuffer *gb = pith_gapbuf_from_string(val.as.string);
+            pith_signal_set(source_signal, PITH_GAPBUF(gb));
+            val = pith_signal_get(source_signal);
+        }
+
+        /* Use the gap buffer from the signal directly (signal owns it) */
+        if (PITH_IS_GAPBUF(val)) {
+            view = malloc(sizeof(PithView));
+            memset(view, 0, sizeof(PithView));
+            view->type = VIEW_TEXTAREA;
+            view->as.textarea.buffer = val.as.gapbuf;  /* Reference, not copy */
+            view->as.textarea.on_change = NULL;
+            view->as.textarea.scroll_offset = 0;
+            view->as.textarea.source_signal = source_signal;
+        } else {
+            /* Fallback for unexpected types */
+            view = pith_view_textarea("", NULL);
+            view->as.textarea.source_signal = source_signal;
+        }
+    } else if (PITH_IS_STRING(a)) {
+        view = pith_view_textarea(a.as.string, NULL);
+        pith_value_free(a);
+    } else if (PITH_IS_GAPBUF(a)) {
+        view = malloc(sizeof(PithView));
+        memset(view, 0, sizeof(PithView));
+        view->type = VIEW_TEXTAREA;
+        view->as.textarea.buffer = pith_gapbuf_copy(a.as.gapbuf);
+        view->as.textarea.on_change = NULL;
+        view->as.textarea.scroll_offset = 0;
+        pith_value_free(a);
+    } else {
+        pith_error(rt, "textarea requires string, gapbuf, or signal");
+        return false;
+    }
+
+    return pith_push(rt, PITH_VIEW(view));
+}
+
+static bool builtin_signal(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue initial = pith_pop(rt);
+    PithSignal *sig = pith_signal_new(rt, initial);
+    return pith_push(rt, PITH_SIGNAL(sig));
+}
+
+static bool builtin_deref(PithRuntime *rt) {
+    /* Dereference a signal to get its value. Non-signals pass through unchanged. */
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue a = pith_pop(rt);
+    if (PITH_IS_SIGNAL(a)) {
+        PithValue val = pith_value_copy(pith_signal_get(a.as.signal));
+        return pith_push(rt, val);
+    }
+    /* Non-signal values pass through */
+    return pith_push(rt, a);
+}
+
+static bool builtin_button(PithRuntime *rt) {
+    /* ( label block -- view ) or ( label -- view ) */
+    if (!pith_stack_has(rt, 1)) return false;
+
+    PithBlock *on_click = NULL;
+    PithValue top = pith_peek(rt);
+
+    /* Check if top of stack is a block (on-click handler) */
+    if (PITH_IS_BLOCK(top)) {
+        on_click = malloc(sizeof(PithBlock));
+        *on_click = *pith_pop(rt).as.block;
+        if (!pith_stack_has(rt, 1)) {
+            free(on_click);
+            pith_error(rt, "button requires label");
+            return false;
+        }
+    }
+
+    PithValue label_val = pith_pop(rt);
+    if (!PITH_IS_STRING(label_val)) {
+        free(on_click);
+        pith_error(rt, "button requires string label");
+        return false;
+    }
+
+    PithView *view = pith_view_button(label_val.as.string, on_click);
+    pith_value_free(label_val);
+    return pith_push(rt, PITH_VIEW(view));
+}
+
+/* Build a stack view that takes over the array's storage: the view
+ * pointers are compacted in place to the front of the items buffer,
+ * which becomes the children list. Non-view items are freed. */
+static PithView* view_stack_from_array(PithViewType type, PithArray *arr) {
+    PithView **children = (PithView **)arr->items;
+    size_t count = 0;
+    for (size_t i = 0; i < arr->length; i++) {
+        PithValue item = arr->items[i];
+        if (PITH_IS_VIEW(item)) {
+            children[count++] = item.as.view;
+        } else {
+            pith_value_free(item);
+        }
+    }
+    free(arr);
+
+    PithView *view = malloc(sizeof(PithView));
+    memset(view, 0, sizeof(PithView));
+    view->type = type;
+    view->as.stack.children = children;
+    view->as.stack.count = count;
+    return view;
+}
+
+static bool builtin_vstack(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue a = pith_pop(rt);
+    if (!PITH_IS_ARRAY(a)) {
+        pith_error(rt, "vstack requires array");
+        return false;
+    }
+
+    PithView *view = view_stack_from_array(VIEW_VSTACK, a.as.array);
+    return pith_push(rt, PITH_VIEW(view));
+}
+
+static bool builtin_hstack(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue a = pith_pop(rt);
+    if (!PITH_IS_ARRAY(a)) {
+        pith_error(rt, "hstack requires array");
+        return false;
+    }
+
+    PithView *view = view_stack_from_array(VIEW_HSTACK, a.as.array);
+    return pith_push(rt, PITH_VIEW(view));
+}
+
+static bool builtin_spacer(PithRuntime *rt) {
+    PithView *view = malloc(sizeof(PithView));
+    memset(view, 0, sizeof(PithView));
+    view->type = VIEW_SPACER;
+    view->style.fill = true;
+    return pith_push(rt, PITH_VIEW(view));
+}
+
+/* view-switch: [views-or-blocks] index -> view */
+/* Returns the view at the given index. Blocks are only run when selected,
+ * so hidden branches are never built. */
+static bool builtin_view_switch(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+
+    PithValue index_val = pith_pop(rt);
+    PithValue arr_val = pith_pop(rt);
+
+    if (!PITH_IS_ARRAY(arr_val)) {
+        pith_error(rt, "view-switch requires array as first argument");
+        pith_value_free(arr_val);
+        pith_value_free(index_val);
+        return false;
+    }
+
+    if (!PITH_IS_NUMBER(index_val)) {
+        pith_error(rt, "view-switch requires number as second argument");
+        pith_value_free(arr_val);
+        pith_value_free(index_val);
+        return false;
+    }
+
+    PithArray *arr = arr_val.as.array;
+    int index = (int)index_val.as.number;
+
+    /* Clamp index to valid range */
+    if (index < 0) index = 0;
+    if (arr->length == 0) {
+        /* Empty array - return a spacer as placeholder */
+        pith_value_free(arr_val);
+        PithView *view = malloc(sizeof(PithView));
+        memset(view, 0, sizeof(PithView));
+        view->type = VIEW_SPACER;
+        return pith_push(rt, PITH_VIEW(view));
+    }
+    if ((size_t)index >= arr->length) index = (int)(arr->length - 1);
+
+    /* Take the selected item, then free the rest */
+    PithValue item = arr->items[index];
+    arr->items[index].type = VAL_NIL;  /* Prevent double-free */
+    for (size_t i = 0; i < arr->length; i++) {
+        if (PITH_IS_VIEW(arr->items[i])) {
+            pith_view_free(arr->items[i].as.view);
+        } else {
+            pith_value_free(arr->items[i]);
+        }
+    }
+    free(arr->items);
+    free(arr);
+
+    /* A block builds its view only now that it is selected */
+    if (PITH_IS_BLOCK(item)) {
+        size_t depth = rt->stack_top;
+        bool ok = pith_execute_block(rt, item.as.block);
+        pith_value_free(item);
+        if (!ok) return false;
+        if (rt->stack_top != depth + 1 || !PITH_IS_VIEW(pith_peek(rt))) {
+            pith_error(rt, "view-switch: block at index %d must leave one view", index);
+            return false;
+        }
+        return true;
+    }
+
+    if (!PITH_IS_VIEW(item)) {
+        pith_error(rt, "view-switch: item at index %d is not a view", index);
+        pith_value_free(item);
+        return false;
+    }
+
+    return pith_push(rt, item);
+}
+
+/* fill: view -> view (with fill=true) */
+static bool builtin_fill(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue v = pith_pop(rt);
+    if (!PITH_IS_VIEW(v)) {
+        pith_error(rt, "fill requires a view");
+        pith_value_free(v);
+        return false;
+    }
+    v.as.view->style.fill = true;
+    return pith_push(rt, v);
+}
+
+/* syntax: view name -> view (highlight a textarea with the named grammar) */
+static bool builtin_syntax(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue name = pith_pop(rt);
+    PithValue v = pith_pop(rt);
+    if (!PITH_IS_VIEW(v) || v.as.view->type != VIEW_TEXTAREA) {
+        pith_error(rt, "syntax requires a textarea");
+        pith_value_free(v);
+        pith_value_free(name);
+        return false;
+    }
+    if (!PITH_IS_STRING(name)) {
+        pith_error(rt, "syntax requires a grammar name");
+        pith_value_free(v);
+        pith_value_free(name);
+        return false;
+    }
+    const PithGrammar *grammar = pith_grammar_find(name.as.string);
+    if (!grammar) {
+        pith_error(rt, "Unknown syntax '%s'", name.as.string);
+        pith_value_free(v);
+        pith_value_free(name);
+        return false;
+    }
+    /* The buffer keeps the highlighter, so its line states outlive the view
+     * and survive the view tree being rebuilt */
+    PithGapBuffer *gb = v.as.view->as.textarea.buffer;
+    if (!gb->highlighter || pith_highlighter_grammar(gb->highlighter) != grammar) {
+        pith_highlighter_free(gb->highlighter);
+        gb->highlighter = pith_highlighter_new(grammar);
+    }
+    v.as.view->as.textarea.highlighter = gb->highlighter;
+    pith_value_free(name);
+    return pith_push(rt, v);
+}
+
+/* wrap: view -> view (soft-wrap long lines in a textarea) */
+static bool builtin_wrap(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue v = pith_pop(rt);
+    if (!PITH_IS_VIEW(v) || v.as.view->type != VIEW_TEXTAREA) {
+        pith_error(rt, "wrap requires a textarea");
+        pith_value_free(v);
+        return false;
+    }
+    /* Kept by the buffer like its highlighter, so rebuilding the view does
+     * not recount every line */
+    PithGapBuffer *gb = v.as.view->as.textarea.buffer;
+    if (!gb->wrap) gb->wrap = pith_wrap_new();
+    v.as.view->as.textarea.wrap = gb->wrap;
+    return pith_push(rt, v);
+}
+
+/* highlight: text name -> runs, each run is [line start length kind] */
+static bool builtin_highlight(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue name = pith_pop(rt);
+    PithValue text = pith_pop(rt);
+    if (!PITH_IS_STRING(text) || !PITH_IS_STRING(name)) {
+        pith_error(rt, "highlight requires a string and a grammar name");
+        pith_value_free(text);
+        pith_value_free(name);
+        return false;
+    }
+    const PithGrammar *grammar = pith_grammar_find(name.as.string);
+    if (!grammar) {
+        pith_error(rt, "Unknown syntax '%s'", name.as.string);
+        pith_value_free(text);
+        pith_value_free(name);
+        return false;
+    }
+
+    static const char *kind_names[HL_KIND_COUNT] = {
+        "plain", "comment", "string", "number", "keyword", "definition", "punctuation"
+    };
+    PithGapBuffer *gb = pith_gapbuf_from_string(text.as.string);
+    PithHighlighter *hl = pith_highlighter_new(grammar);
+    size_t capacity = PITH_HIGHLIGHT_MAX_RUNS;
+    PithHighlightRun *runs = malloc(capacity * sizeof(PithHighlightRun));
+    PithArray *result = pith_array_new();
+    size_t lines = pith_gapbuf_line_count(gb);
+    for (size_t line = 0; line < lines; line++) {
+        size_t n = pith_highlight_line(hl, gb, line, runs, capacity);
+        if (n > capacity) {
+            /* A long line: make room for all of its runs and lex it again */
+            capacity = n;
+            runs = realloc(runs, capacity * sizeof(PithHighlightRun));
+            pith_highlight_line(hl, gb, line, runs, capacity);
+        }
+        for (size_t i = 0; i < n; i++) {
+            PithArray *run = pith_array_new();
+            pith_array_push(run, PITH_NUMBER((double)line));
+            pith_array_push(run, PITH_NUMBER((double)runs[i].start));
+            pith_array_push(run, PITH_NUMBER((double)runs[i].length));
+            pith_array_push(run, PITH_STRING(pith_string_dup(kind_names[runs[i].kind])));
+            pith_array_push(result, PITH_ARRAY(run));
+        }
+    }
+    free(runs);
+    pith_highlighter_free(hl);
+    pith_gapbuf_free(gb);
+    pith_value_free(text);
+    pith_value_free(name);
+    return pith_push(rt, PITH_ARRAY(result));
+}
+
+/* statusbar: view -> view (with statusbar=true) */
+static bool builtin_statusbar(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue v = pith_pop(rt);
+    if (!PITH_IS_VIEW(v)) {
+        pith_error(rt, "statusbar requires a view");
+        pith_value_free(v);
+        return false;
+    }
+    v.as.view->style.has_statusbar = true;
+    v.as.view->style.statusbar = true;
+    return pith_push(rt, v);
+}
+
+/* ========================================================================
+   OUTLINE VIEW BUILTINS
+   ======================================================================== */
+
+/* outline-item: ( label -- node ) or ( icon label -- node ) or ( icon label block -- node )
+ * Creates a leaf node for an outline view.
+ * Variants:
+ *   "file.txt" outline-item                    -> leaf with label
+ *   "f" "file.txt" outline-item                -> leaf with icon and label
+ *   "f" "file.txt" do ... end outline-item     -> leaf with icon, label, and click handler
+ */
+static bool builtin_outline_item(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+
+    PithOutlineNode *node = malloc(sizeof(PithOutlineNode));
+    memset(node, 0, sizeof(PithOutlineNode));
+
+    /* Check what's on the stack */
+    PithValue top = pith_pop(rt);
+
+    if (PITH_IS_BLOCK(top)) {
+        /* ( icon label block -- node ) */
+        if (!pith_stack_has(rt, 2)) {
+            pith_error(rt, "outline-item with block requires icon and label");
+            free(top.as.block);
+            free(node);
+            return false;
+        }
+        node->on_click = top.as.block;
+        PithValue label = pith_pop(rt);
+        PithValue icon = pith_pop(rt);
+        if (!PITH_IS_STRING(label) || !PITH_IS_STRING(icon)) {
+            pith_error(rt, "outline-item requires string icon and label");
+            free(node->on_click);
+            free(node);
+            pith_value_free(label);
+            pith_value_free(icon);
+            return false;
+        }
+        node->label = label.as.string;
+        node->icon = icon.as.string;
+    } else if (PITH_IS_STRING(top)) {
+        /* Could be ( label -- node ) or ( icon label -- node ) */
+        if (pith_stack_has(rt, 1)) {
+            PithValue maybe_icon = pith_peek(rt);
+            if (PITH_IS_STRING(maybe_icon) && pith_string_length(maybe_icon.as.string) <= 2) {
+                /* Looks like an icon (short string) */
+                pith_pop(rt);
+                node->icon = maybe_icon.as.string;
+                node->label = top.as.string;
+            } else {
+                /* Just a label */
+                node->label = top.as.string;
+            }
+        } else {
+            /* Just a label */
+            node->label = top.as.string;
+        }
+    } else {
+        pith_error(rt, "outline-item requires string label");
+        pith_value_free(top);
+        free(node);
+        return false;
+    }
+
+    return pith_push(rt, PITH_OUTLINE_NODE(node));
+}
+
+/* outline-group: ( label children -- node ) or ( icon label children -- node )
+ * Creates a group node (collapsible) for an outline view.
+ */
+static bool builtin_outline_group(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+
+    PithValue children_val = pith_pop(rt);
+    if (!PITH_IS_ARRAY(children_val)) {
+        pith_error(rt, "outline-group requires array of children");
+        pith_value_free(children_val);
+        return false;
+    }
+
+    PithOutlineNode *node = malloc(sizeof(PithOutlineNode));
+    memset(node, 0, sizeof(PithOutlineNode));
+
+    /* Get label and optional icon */
+    PithValue label = pith_pop(rt);
+    if (!PITH_IS_STRING(label)) {
+        pith_error(rt, "outline-group requires string label");
+        pith_value_free(label);
+        pith_value_free(children_val);
+        free(node);
+        return false;
+    }
+    node->label = label.as.string;
+
+    /* Check for icon */
+    if (pith_stack_has(rt, 1)) {
+        PithValue maybe_icon = pith_peek(rt);
+        if (PITH_IS_STRING(maybe_icon) && pith_string_length(maybe_icon.as.string) <= 2) {
+            pith_pop(rt);
+            node->icon = maybe_icon.as.string;
+        }
+    }
+
+    /* Convert array of outline nodes to children */
+    PithArray *arr = children_val.as.array;
+    node->children = malloc(arr->length * sizeof(PithOutlineNode*));
+    node->child_count = 0;
+
+    for (size_t i = 0; i < arr->length; i++) {
+        if (PITH_IS_OUTLINE_NODE(arr->items[i])) {
+            node->children[node->child_count++] = arr->items[i].as.outline_node;
+            arr->items[i].type = VAL_NIL;  /* Prevent double-free */
+        }
+    }
+
+    /* Free the array container (but not the nodes we took) */
+    pith_value_free(children_val);
+
+    return pith_push(rt, PITH_OUTLINE_NODE(node));
+}
+
+/* outline: ( array-of-nodes -- view )
+ * Creates an outline view from an array of root nodes.
+ */
+static bool builtin_outline(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+
+    PithValue arr_val = pith_pop(rt);
+    if (!PITH_IS_ARRAY(arr_val)) {
+        pith_error(rt, "outline requires array of nodes");
+        pith_value_free(arr_val);
+        return false;
+    }
+
+    PithView *view = malloc(sizeof(PithView));
+    memset(view, 0, sizeof(PithView));
+    view->type = VIEW_OUTLINE;
+
+    PithArray *arr = arr_val.as.array;
+    view->as.outline.roots = malloc(arr->length * sizeof(PithOutlineNode*));
+    view->as.outline.root_count = 0;
+
+    for (size_t i = 0; i < arr->length; i++) {
+        if (PITH_IS_OUTLINE_NODE(arr->items[i])) {
+            view->as.outline.roots[view->as.outline.root_count++] =
+                arr->items[i].as.outline_node;
+            arr->items[i].type = VAL_NIL;  /* Prevent double-free */
+        }
+    }
+
+    pith_value_free(arr_val);
+    return pith_push(rt, PITH_VIEW(view));
+}
+
+/* icon-color: ( node color -- node )
+ * Sets the icon color on an outline node.
+ */
+static bool builtin_icon_color(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+
+    PithValue color_val = pith_pop(rt);
+    PithValue node_val = pith_pop(rt);
+
+    if (!PITH_IS_OUTLINE_NODE(node_val)) {
+        pith_error(rt, "icon-color requires outline node");
+        pith_value_free(color_val);
+        pith_value_free(node_val);
+        return false;
+    }
+
+    if (!PITH_IS_STRING(color_val)) {
+        pith_error(rt, "icon-color requires string color");
+        pith_value_free(color_val);
+        return pith_push(rt, node_val);
+    }
+
+    /* Parse color string */
+    node_val.as.outline_node->icon_color = pith_color_parse(color_val.as.string);
+    pith_value_free(color_val);
+
+    return pith_push(rt, node_val);
+}
+
+/* map: array block -> array */
+/* Applies block to each element, collects results */
+/* Array Operations */
+static bool builtin_first(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue arr = pith_pop(rt);
+    if (PITH_IS_SEQ(arr)) {
+        /* Walks only as far as the first item */
+        PithIter it;
+        PithValue result = PITH_NIL();
+        bool ok = iter_open(rt, &it, arr, "first");
+        if (ok) {
+            if (!iter_next(rt, &it, &result)) result = PITH_NIL();
+            iter_close(&it);
+        }
+        pith_value_free(arr);
+        return ok && !rt->has_error && pith_push(rt, result);
+    }
+    if (!PITH_IS_ARRAY(arr)) {
+        pith_error(rt, "first requires an array");
+        pith_value_free(arr);
+        return false;
+    }
+    if (arr.as.array->length == 0) {
+        pith_value_free(arr);
+        return pith_push(rt, PITH_NIL());
+    }
+    PithValue result = pith_value_copy(arr.as.array->items[0]);
+    pith_value_free(arr);
+    return pith_push(rt, result);
+}
+
+static bool builtin_last(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue arr = pith_pop(rt);
+    if (!PITH_IS_ARRAY(arr)) {
+        pith_error(rt, "last requires an array");
+        pith_value_free(arr);
+        return false;
+    }
+    if (arr.as.array->length == 0) {
+        pith_value_free(arr);
+        return pith_push(rt, PITH_NIL());
+    }
+    PithValue result = pith_value_copy(arr.as.array->items[arr.as.array->length - 1]);
+    pith_value_free(arr);
+    return pith_push(rt, result);
+}
+
+static bool builtin_nth(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue idx = pith_pop(rt);
+    PithValue arr = pith_pop(rt);
+    if (!PITH_IS_ARRAY(arr) || !PITH_IS_NUMBER(idx)) {
+        pith_error(rt, "nth requires array and index");
+        pith_value_free(arr);
+        pith_value_free(idx);
+        return false;
+    }
+    int n = (int)idx.as.number;
+    if (n < 0 || (size_t)n >= arr.as.array->length) {
+        pith_value_free(arr);
+        return pith_push(rt, PITH_NIL());
+    }
+    PithValue result = pith_value_copy(arr.as.array->items[n]);
+    pith_value_free(arr);
+    return pith_push(rt, result);
+}
+
+static bool builtin_append(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue item = pith_pop(rt);
+    PithValue arr = pith_pop(rt);
+    if (!PITH_IS_ARRAY(arr)) {
+        pith_error(rt, "append requires an array");
+        pith_value_free(arr);
+        pith_value_free(item);
+        return false;
+    }
+    PithArray *new_arr = pith_array_new();
+    for (size_t i = 0; i < arr.as.array->length; i++) {
+        pith_array_push(new_arr, pith_value_copy(arr.as.array->items[i]));
+    }
+    pith_array_push(new_arr, item);
+    pith_value_free(arr);
+    return pith_push(rt, PITH_ARRAY(new_arr));
+}
+
+static bool builtin_prepend(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue arr = pith_pop(rt);
+    PithValue item = pith_pop(rt);
+    if (!PITH_IS_ARRAY(arr)) {
+        pith_error(rt, "prepend requires an array");
+        pith_value_free(arr);
+        pith_value_free(item);
+        return false;
+    }
+    PithArray *new_arr = pith_array_new();
+    pith_array_push(new_arr, item);
+    for (size_t i = 0; i < arr.as.array->length; i++) {
+        pith_array_push(new_arr, pith_value_copy(arr.as.array->items[i]));
+    }
+    pith_value_free(arr);
+    return pith_push(rt, PITH_ARRAY(new_arr));
+}
+
+static bool builtin_slice(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 3)) return false;
+    PithValue end_val = pith_pop(rt);
+    PithValue start_val = pith_pop(rt);
+    PithValue arr = pith_pop(rt);
+    if (!PITH_IS_ARRAY(arr) || !PITH_IS_NUMBER(start_val) || !PITH_IS_NUMBER(end_val)) {
+        pith_error(rt, "slice requires array, start, end");
+        pith_value_free(arr);
+        pith_value_free(start_val);
+        pith_value_free(end_val);
+        return false;
+    }
+    int start = (int)start_val.as.number;
+    int end = (int)end_val.as.number;
+    size_t len = arr.as.array->length;
+
+    if (start < 0) start = 0;
+    if (end < 0) end = 0;
+    if ((size_t)start > len) start = len;
+    if ((size_t)end > len) end = len;
+    if (start > end) start = end;
+
+    PithArray *new_arr = pith_array_new();
+    for (int i = start; i < end; i++) {
+        pith_array_push(new_arr, pith_value_copy(arr.as.array->items[i]));
+    }
+    pith_value_free(arr);
+    return pith_push(rt, PITH_ARRAY(new_arr));
+}
+
+static bool builtin_reverse(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue arr = pith_pop(rt);
+    if (!PITH_IS_ARRAY(arr)) {
+        pith_error(rt, "reverse requires an array");
+        pith_value_free(arr);
+        return false;
+    }
+    PithArray *new_arr = pith_array_new();
+    for (size_t i = arr.as.array->length; i > 0; i--) {
+        pith_array_push(new_arr, pith_value_copy(arr.as.array->items[i - 1]));
+    }
+    pith_value_free(arr);
+    return pith_push(rt, PITH_ARRAY(new_arr));
+}
+
+static int pith_value_compare(const void *a, const void *b) {
+    const PithValue *va = (const PithValue *)a;
+    const PithValue *vb = (const PithValue *)b;
+
+    if (PITH_IS_NUMBER(*va) && PITH_IS_NUMBER(*vb)) {
+        double diff = va->as.number - vb->as.number;
+        return (diff > 0) - (diff < 0);
+    }
+    if (PITH_IS_STRING(*va) && PITH_IS_STRING(*vb)) {
+        return strcmp(va->as.string, vb->as.string);
+    }
+    return 0;
+}
+
+static bool builtin_sort(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue arr = pith_pop(rt);
+    if (!PITH_IS_ARRAY(arr)) {
+        pith_error(rt, "sort requires an array");
+        pith_value_free(arr);
+        return false;
+    }
+    PithArray *new_arr = pith_array_new();
+    for (size_t i = 0; i < arr.as.array->length; i++) {
+        pith_array_push(new_arr, pith_value_copy(arr.as.array->items[i]));
+    }
+    qsort(new_arr->items, new_arr->length, sizeof(PithValue), pith_value_compare);
+    pith_value_free(arr);
+    return pith_push(rt, PITH_ARRAY(new_arr));
+}
+
+static bool builtin_index_of(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue item = pith_pop(rt);
+    PithValue arr = pith_pop(rt);
+    if (!PITH_IS_ARRAY(arr)) {
+        pith_error(rt, "index-of requires an array");
+        pith_value_free(arr);
+        pith_value_free(item);
+        return false;
+    }
+    double idx = -1;
+    for (size_t i = 0; i < arr.as.array->length; i++) {
+        if (pith_value_equal(arr.as.array->items[i], item)) {
+            idx = (double)i;
+            break;
+        }
+    }
+    pith_value_free(arr);
+    pith_value_free(item);
+    return pith_push(rt, PITH_NUMBER(idx));
+}
+
+static bool builtin_empty(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue arr = pith_pop(rt);
+    if (!PITH_IS_ARRAY(arr)) {
+        pith_error(rt, "empty? requires an array");
+        pith_value_free(arr);
+        return false;
+    }
+    bool empty = arr.as.array->length == 0;
+    pith_value_free(arr);
+    return pith_push(rt, PITH_BOOL(empty));
+}
+
+static bool builtin_filter(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue block_val = pith_pop(rt);
+    PithValue arr_val = pith_pop(rt);
+
+    if (!iter_source_ok(arr_val)) {
+        pith_error(rt, "filter requires array or sequence as first argument");
+        pith_value_free(arr_val);
+        pith_value_free(block_val);
+        return false;
+    }
+    if (!PITH_IS_BLOCK(block_val)) {
+        pith_error(rt, "filter requires block as second argument");
+        pith_value_free(arr_val);
+        pith_value_free(block_val);
+        return false;
+    }
+
+    /* On a sequence, filter is a stage that runs as the result is walked */
+    if (PITH_IS_SEQ(arr_val)) {
+        PithSeq *seq = seq_stage(SEQ_FILTER, arr_val);
+        seq->block = block_val.as.block;
+        return pith_push(rt, PITH_SEQ(seq));
+    }
+
+    PithIter it;
+    PithBlock *block = block_val.as.block;
+    if (!iter_open(rt, &it, arr_val, "filter")) {
+        pith_value_free(arr_val);
+        free(block);
+        return false;
+    }
+    PithArray *output = pith_array_new();
+
+    PithValue item;
+    while (!rt->has_error && iter_next(rt, &it, &item)) {
+        pith_push(rt, pith_value_copy(item));
+        pith_execute_block(rt, block);
+        bool keep = false;
+        if (pith_stack_has(rt, 1)) {
+            PithValue result = pith_pop(rt);
+            if (PITH_IS_BOOL(result)) keep = result.as.boolean;
+            else if (PITH_IS_NUMBER(result)) keep = result.as.number != 0;
+            else if (!PITH_IS_NIL(result)) keep = true;
+            pith_value_free(result);
+        }
+        if (keep) {
+            pith_array_push(output, item);
+        } else {
+            pith_value_free(item);
+        }
+    }
+
+    iter_close(&it);
+    pith_value_free(arr_val);
+    free(block);
+    return pith_push(rt, PITH_ARRAY(output));
+}
+
+static bool builtin_each(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue block_val = pith_pop(rt);
+    PithValue arr_val = pith_pop(rt);
+
+    if (!iter_source_ok(arr_val)) {
+        pith_error(rt, "each requires array or sequence as first argument");
+        pith_value_free(arr_val);
+        pith_value_free(block_val);
+        return false;
+    }
+    if (!PITH_IS_BLOCK(block_val)) {
+        pith_error(rt, "each requires block as second argument");
+        pith_value_free(arr_val);
+        pith_value_free(block_val);
+        return false;
+    }
+
+    PithIter it;
+    PithBlock *block = block_val.as.block;
+    if (!iter_open(rt, &it, arr_val, "each")) {
+        pith_value_free(arr_val);
+        free(block);
+        return false;
+    }
+
+    PithValue item;
+    while (!rt->has_error && iter_next(rt, &it, &item)) {
+        pith_push(rt, item);
+        pith_execute_block(rt, block);
+    }
+
+    iter_close(&it);
+    pith_value_free(arr_val);
+    free(block);
+    return true;
+}
+
+static bool builtin_reduce(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 3)) return false;
+    PithValue block_val = pith_pop(rt);
+    PithValue initial = pith_pop(rt);
+    PithValue arr_val = pith_pop(rt);
+
+    if (!iter_source_ok(arr_val)) {
+        pith_error(rt, "reduce requires array or sequence as first argument");
+        pith_value_free(arr_val);
+        pith_value_free(initial);
+        pith_value_free(block_val);
+        return false;
+    }
+    if (!PITH_IS_BLOCK(block_val)) {
+        pith_error(rt, "reduce requires block as third argument");
+        pith_value_free(arr_val);
+        pith_value_free(initial);
+        pith_value_free(block_val);
+        return false;
+    }
+
+    PithIter it;
+    PithBlock *block = block_val.as.block;
+    if (!iter_open(rt, &it, arr_val, "reduce")) {
+        pith_value_free(arr_val);
+        pith_value_free(initial);
+        free(block);
+        return false;
+    }
+    PithValue accumulator = initial;
+
+    PithValue item;
+    while (!rt->has_error && iter_next(rt, &it, &item)) {
+        pith_push(rt, accumulator);
+        pith_push(rt, item);
+        pith_execute_block(rt, block);
+        if (pith_stack_has(rt, 1)) {
+            accumulator = pith_pop(rt);
+        } else {
+            accumulator = PITH_NIL();
+        }
+    }
+
+    iter_close(&it);
+    pith_value_free(arr_val);
+    free(block);
+    return pith_push(rt, accumulator);
+}
+
+static bool builtin_find(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue block_val = pith_pop(rt);
+    PithValue arr_val = pith_pop(rt);
+
+    if (!iter_source_ok(arr_val)) {
+        pith_error(rt, "find requires array or sequence as first argument");
+        pith_value_free(arr_val);
+        pith_value_free(block_val);
+        return false;
+    }
+    if (!PITH_IS_BLOCK(block_val)) {
+        pith_error(rt, "find requires block as second argument");
+        pith_value_free(arr_val);
+        pith_value_free(block_val);
+        return false;
+    }
+
+    PithIter it;
+    PithBlock *block = block_val.as.block;
+    if (!iter_open(rt, &it, arr_val, "find")) {
+        pith_value_free(arr_val);
+        free(block);
+        return false;
+    }
+    PithValue found = PITH_NIL();
+
+    /* Stops at the first match, so a sequence is read no further */
+    PithValue item;
+    while (!rt->has_error && iter_next(rt, &it, &item)) {
+        pith_push(rt, pith_value_copy(item));
+        pith_execute_block(rt, block);
+        bool match = false;
+        if (pith_stack_has(rt, 1)) {
+            PithValue result = pith_pop(rt);
+            if (PITH_IS_BOOL(result)) match = result.as.boolean;
+            else if (PITH_IS_NUMBER(result)) match = result.as.number != 0;
+            else if (!PITH_IS_NIL(result)) match = true;
+            pith_value_free(result);
+        }
+        if (match) {
+            found = item;
+            break;
+        }
+        pith_value_free(item);
+    }
+
+    iter_close(&it);
+    pith_value_free(arr_val);
+    free(block);
+    return pith_push(rt, found);
+}
+
+static bool builtin_any(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue block_val = pith_pop(rt);
+    PithValue arr_val = pith_pop(rt);
+
+    if (!iter_source_ok(arr_val)) {
+        pith_error(rt, "any requires array or sequence as first argument");
+        pith_value_free(arr_val);
+        pith_value_free(block_val);
+        return false;
+    }
+    if (!PITH_IS_BLOCK(block_val)) {
+        pith_error(rt, "any requires block as second argument");
+        pith_value_free(arr_val);
+        pith_value_free(block_val);
+        return false;
+    }
+
+    PithIter it;
+    PithBlock *block = block_val.as.block;
+    if (!iter_open(rt, &it, arr_val, "any")) {
+        pith_value_free(arr_val);
+        free(block);
+        return false;
+    }
+    bool any_match = false;
+
+    PithValue item;
+    while (!rt->has_error && iter_next(rt, &it, &item)) {
+        pith_push(rt, item);
+        pith_execute_block(rt, block);
+        if (pith_stack_has(rt, 1)) {
+            PithValue result = pith_pop(rt);
+            bool match = false;
+            if (PITH_IS_BOOL(result)) match = result.as.boolean;
+            else if (PITH_IS_NUMBER(result)) match = result.as.number != 0;
+            else if (!PITH_IS_NIL(result)) match = true;
+            pith_value_free(result);
+            if (match) {
+                any_match = true;
+                break;
+            }
+        }
+    }
+
+    iter_close(&it);
+    pith_value_free(arr_val);
+    free(block);
+    return pith_push(rt, PITH_BOOL(any_match));
+}
+
+static bool builtin_all(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue block_val = pith_pop(rt);
+    PithValue arr_val = pith_pop(rt);
+
+    if (!iter_source_ok(arr_val)) {
+        pith_error(rt, "all requires array or sequence as first argument");
+        pith_value_free(arr_val);
+        pith_value_free(block_val);
+        return false;
+    }
+    if (!PITH_IS_BLOCK(block_val)) {
+        pith_error(rt, "all requires block as second argument");
+        pith_value_free(arr_val);
+        pith_value_free(block_val);
+        return false;
+    }
+
+    PithIter it;
+    PithBlock *block = block_val.as.block;
+    if (!iter_open(rt, &it, arr_val, "all")) {
+        pith_value_free(arr_val);
+        free(block);
+        return false;
+    }
+    bool all_match = true;
+
+    PithValue item;
+    while (!rt->has_error && iter_next(rt, &it, &item)) {
+        pith_push(rt, item);
+        pith_execute_block(rt, block);
+        if (pith_stack_has(rt, 1)) {
+            PithValue result = pith_pop(rt);
+            bool match = false;
+            if (PITH_IS_BOOL(result)) match = result.as.boolean;
+            else if (PITH_IS_NUMBER(result)) match = result.as.number != 0;
+            else if (!PITH_IS_NIL(result)) match = true;
+            pith_value_free(result);
+            if (!match) {
+                all_match = false;
+                break;
+            }
+        }
+    }
+
+    iter_close(&it);
+    pith_value_free(arr_val);
+    free(block);
+    return pith_push(rt, PITH_BOOL(all_match));
 }
 
-static bool builtin_vstack(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue a = pith_pop(rt);
-    if (!PITH_IS_ARRAY(a)) {
-        pith_error(rt, "vstack requires array");
+static bool builtin_map(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue block_val = pith_pop(rt);
+    PithValue arr_val = pith_pop(rt);
+
+    if (!iter_source_ok(arr_val)) {
+        pith_error(rt, "map requires array or sequence as first argument");
         return false;
     }
-    
-    PithArray *arr = a.as.array;
-    PithView **children = malloc(arr->length * sizeof(PithView*));
-    size_t count = 0;
-    
-    for (size_t i = 0; i < arr->length; i++) {
-        if (PITH_IS_VIEW(arr->items[i])) {
-            children[count++] = arr->items[i].as.view;
-        }
+    if (!PITH_IS_BLOCK(block_val)) {
+        pith_error(rt, "map requires block as second argument");
+        return false;
     }
-    
-    PithView *view = pith_view_vstack(children, count);
-    free(children);
-    free(arr->items);
-    free(arr);
-    
-    return pith_push(rt, PITH_VIEW(view));
-}
 
-static bool builtin_hstack(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue a = pith_pop(rt);
-    if (!PITH_IS_ARRAY(a)) {
-        pith_error(rt, "hstack requires array");
-        return false;
+    /* On a sequence, map is a stage that runs as the result is walked */
+    if (PITH_IS_SEQ(arr_val)) {
+        PithSeq *seq = seq_stage(SEQ_MAP, arr_val);
+        seq->block = block_val.as.block;
+        return pith_push(rt, PITH_SEQ(seq));
     }
-    
-    PithArray *arr = a.as.array;
-    PithView **children = malloc(arr->length * sizeof(PithView*));
-    size_t count = 0;
-    
-    for (size_t i = 0; i < arr->length; i++) {
-        if (PITH_IS_VIEW(arr->items[i])) {
-            children[count++] = arr->items[i].as.view;
+
+    PithArray *input = arr_val.as.array;
+    PithBlock *block = block_val.as.block;
+    PithArray *output = pith_array_new();
+
+    for (size_t i = 0; i < input->length; i++) {
+        /* Push current element onto stack */
+        pith_push(rt, pith_value_copy(input->items[i]));
+
+        /* Execute the block */
+        pith_execute_block(rt, block);
+
+        /* Collect result */
+        if (pith_stack_has(rt, 1)) {
+            pith_array_push(output, pith_pop(rt));
         }
     }
-    
-    PithView *view = pith_view_hstack(children, count);
-    free(children);
-    free(arr->items);
-    free(arr);
 
-    return pith_push(rt, PITH_VIEW(view));
-}
+    pith_value_free(arr_val);
+    free(block);
 
-static bool builtin_spacer(PithRuntime *rt) {
-    PithView *view = malloc(sizeof(PithView));
-    memset(view, 0, sizeof(PithView));
-    view->type = VIEW_SPACER;
-    view->style.fill = true;
-    return pith_push(rt, PITH_VIEW(view));
+    return pith_push(rt, PITH_ARRAY(output));
 }
 
-/* view-switch: [views] index -> view */
-/* Returns the view at the given index, hiding others */
-static bool builtin_view_switch(PithRuntime *rt) {
+/* times: ( n block -- ) run block n times with the index 0..n-1 on the stack.
+ * The index is a plain number, so a turn allocates nothing. */
+static bool builtin_times(PithRuntime *rt) {
     if (!pith_stack_has(rt, 2)) return false;
+    PithValue block_val = pith_pop(rt);
+    PithValue n = pith_pop(rt);
 
-    PithValue index_val = pith_pop(rt);
-    PithValue arr_val = pith_pop(rt);
-
-    if (!PITH_IS_ARRAY(arr_val)) {
-        pith_error(rt, "view-switch requires array as first argument");
-        pith_value_free(arr_val);
-        pith_value_free(index_val);
+    if (!PITH_IS_NUMBER(n) || !PITH_IS_BLOCK(block_val)) {
+        pith_error(rt, "times requires a number and a block");
+        pith_value_free(n);
+        pith_value_free(block_val);
         return false;
     }
 
-    if (!PITH_IS_NUMBER(index_val)) {
-        pith_error(rt, "view-switch requires number as second argument");
-        pith_value_free(arr_val);
-        pith_value_free(index_val);
-        return false;
+    PithBlock *block = block_val.as.block;
+    for (double i = 0; i < n.as.number && !rt->has_error; i++) {
+        pith_push(rt, PITH_NUMBER(i));
+        pith_execute_block(rt, block);
     }
 
-    PithArray *arr = arr_val.as.array;
-    int index = (int)index_val.as.number;
+    free(block);
+    return !rt->has_error;
+}
 
-    /* Clamp index to valid range */
-    if (index < 0) index = 0;
-    if (arr->length == 0) {
-        /* Empty array - return a spacer as placeholder */
-        pith_value_free(arr_val);
-        PithView *view = malloc(sizeof(PithView));
-        memset(view, 0, sizeof(PithView));
-        view->type = VIEW_SPACER;
-        return pith_push(rt, PITH_VIEW(view));
+/* range-each: ( start end step block -- ) run block for start, start+step,
+ * ... while short of end (above it for a negative step) */
+static bool builtin_range_each(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 4)) return false;
+    PithValue block_val = pith_pop(rt);
+    PithValue step = pith_pop(rt);
+    PithValue end = pith_pop(rt);
+    PithValue start = pith_pop(rt);
+
+    if (!PITH_IS_NUMBER(start) || !PITH_IS_NUMBER(end) || !PITH_IS_NUMBER(step) ||
+        !PITH_IS_BLOCK(block_val)) {
+        pith_error(rt, "range-each requires start, end, step and a block");
+        pith_value_free(start);
+        pith_value_free(end);
+        pith_value_free(step);
+        pith_value_free(block_val);
+        return false;
     }
-    if ((size_t)index >= arr->length) index = (int)(arr->length - 1);
-
-    /* Get the view at the index */
-    PithValue item = arr->items[index];
-    if (!PITH_IS_VIEW(item)) {
-        pith_error(rt, "view-switch: item at index %d is not a view", index);
-        pith_value_free(arr_val);
+    if (step.as.number == 0) {
+        pith_error(rt, "range-each step must not be 0");
+        free(block_val.as.block);
         return false;
     }
 
-    /* Take ownership of the selected view */
-    PithView *selected_view = item.as.view;
-    arr->items[index].type = VAL_NIL;  /* Prevent double-free */
-
-    /* Free the array and other views */
-    for (size_t i = 0; i < arr->length; i++) {
-        if (i != (size_t)index) {
-            pith_value_free(arr->items[i]);
-        }
+    PithBlock *block = block_val.as.block;
+    /* Multiply rather than add up steps so fractional steps don't drift */
+    for (double k = 0; !rt->has_error; k++) {
+        double i = start.as.number + k * step.as.number;
+        if (step.as.number > 0 ? i >= end.as.number : i <= end.as.number) break;
+        pith_push(rt, PITH_NUMBER(i));
+        pith_execute_block(rt, block);
     }
-    free(arr->items);
-    free(arr);
 
-    return pith_push(rt, PITH_VIEW(selected_view));
+    free(block);
+    return !rt->has_error;
 }
 
-/* fill: view -> view (with fill=true) */
-static bool builtin_fill(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue v = pith_pop(rt);
-    if (!PITH_IS_VIEW(v)) {
-        pith_error(rt, "fill requires a view");
-        pith_value_free(v);
+/* while: ( cond-block body-block -- ) run body as long as cond leaves a
+ * truthy value */
+static bool builtin_while(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 2)) return false;
+    PithValue body_val = pith_pop(rt);
+    PithValue cond_val = pith_pop(rt);
+
+    if (!PITH_IS_BLOCK(cond_val) || !PITH_IS_BLOCK(body_val)) {
+        pith_error(rt, "while requires a condition block and a body block");
+        pith_value_free(cond_val);
+        pith_value_free(body_val);
         return false;
     }
-    v.as.view->style.fill = true;
-    return pith_push(rt, v);
-}
 
-/* statusbar: view -> view (with statusbar=true) */
-static bool builtin_statusbar(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue v = pith_pop(rt);
-    if (!PITH_IS_VIEW(v)) {
-        pith_error(rt, "statusbar requires a view");
-        pith_value_free(v);
-        return false;
+    PithBlock *cond = cond_val.as.block;
+    PithBlock *body = body_val.as.block;
+    while (!rt->has_error) {
+        pith_execute_block(rt, cond);
+        if (rt->has_error || !pith_stack_has(rt, 1)) break;
+        PithValue result = pith_pop(rt);
+        bool go = false;
+        if (PITH_IS_BOOL(result)) go = result.as.boolean;
+        else if (PITH_IS_NUMBER(result)) go = result.as.number != 0;
+        else if (!PITH_IS_NIL(result)) go = true;
+        pith_value_free(result);
+        if (!go) break;
+        pith_execute_block(rt, body);
     }
-    v.as.view->style.has_statusbar = true;
-    v.as.view->style.statusbar = true;
-    return pith_push(rt, v);
+
+    free(cond);
+    free(body);
+    return !rt->has_error;
 }
 
 /* ========================================================================
-   OUTLINE VIEW BUILTINS
+   BACKGROUND JOBS
+   spawn hands a block and a deep copy of its input to a worker thread.
+   Each worker owns a runtime built from a snapshot of the main runtime's
+   units; the token arrays are shared read-only, everything else is the
+   worker's own. Finished jobs wait on a done list until the main thread
+   polls, which copies the result into the job's signal.
    ======================================================================== */
 
-/* outline-item: ( label -- node ) or ( icon label -- node ) or ( icon label block -- node )
- * Creates a leaf node for an outline view.
- * Variants:
- *   "file.txt" outline-item                    -> leaf with label
- *   "f" "file.txt" outline-item                -> leaf with icon and label
- *   "f" "file.txt" do ... end outline-item     -> leaf with icon, label, and click handler
- */
-static bool builtin_outline_item(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
+static bool unit_scan(UnitBuild *b);
+static bool pith_finish_builds(PithRuntime *rt, UnitBuild *builds, size_t count);
+static size_t pith_cpu_count(void);
+static PithBuiltinFn find_builtin(const char *name);
 
-    PithOutlineNode *node = malloc(sizeof(PithOutlineNode));
-    memset(node, 0, sizeof(PithOutlineNode));
+/* The units that make up the program, latest build of each source in
+ * load order. Immutable once made; only the main thread counts refs. */
+typedef struct {
+    size_t refs;
+    size_t version;             /* rt->program_version it was taken at */
+    PithUnit **units;
+    size_t count;
+} PithProgram;
+
+typedef struct PithBatch PithBatch;
+
+typedef enum {
+    JOB_SPAWN,
+    JOB_READ,                   /* file-read-async */
+    JOB_WRITE,                  /* file-write-async */
+    JOB_SAVE,                   /* file-save (no signal) */
+} PithJobKind;
+
+typedef struct PithJob {
+    struct PithJob *next;
+    PithJobKind kind;
+    PithProgram *program;
+    PithBatch *batch;           /* Set for pmap/pfilter/preduce helpers */
+    PithBlock block;            /* Points into a main-runtime unit */
+    char *context;              /* Dictionary spawn ran in (NULL = root) */
+    PithValue input;            /* Deep copy, moved onto the worker's stack */
+    PithSignal *target;         /* Main-runtime signal, touched on the main thread only */
+    PithValue result;           /* Deep copy made by the worker */
+    bool has_error;
+    char error[PITH_ERROR_MAX];
+
+    /* File I/O jobs */
+    char *path;
+    PithValue data;             /* String to write */
+    int write_flags;            /* PITH_WRITE_* */
+    int io_errno;               /* 0 on success */
+    atomic_bool cancelled;      /* Set by cancel-io, checked between reads */
+    size_t serial;              /* Request number on its target signal */
+} PithJob;
+
+/* The signal async reads (or writes) of one path fill. Every request for
+ * the path reuses it, so repeated I/O doesn't pile up signals. */
+typedef struct {
+    char *path;
+    PithJobKind kind;
+    PithSignal *signal;
+    size_t serial;              /* Newest request; older results are dropped */
+} PithIoTarget;
+
+struct PithWorkerPool {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        /* Signalled when a job is queued or on stop */
+    pthread_cond_t finished;    /* Signalled when a job or batch helper finishes */
+    PithJob *queue, *queue_tail;
+    PithJob *done, *done_tail;
+    size_t idle;                /* Workers waiting for a job */
+    bool stopping;
+
+    pthread_t threads[PITH_WORKER_THREADS];
+    size_t thread_count;
+    size_t thread_max;
+
+    /* File I/O runs on its own threads so it never waits behind spawned work */
+    pthread_cond_t io_wake;
+    PithJob *io_queue, *io_queue_tail;
+    PithJob *io_running[PITH_IO_THREADS];
+    size_t io_idle;
+    pthread_t io_threads[PITH_IO_THREADS];
+    size_t io_thread_count;
+
+    PithFileSystem fs;          /* Set once; I/O threads call it too */
+
+    /* Main thread only */
+    FILE *out;
+    bool debug;
+    PithProgram *program;       /* Snapshot handed to new jobs */
+    size_t pending;             /* Jobs and file operations not yet delivered */
+    PithIoTarget *io_targets;
+    size_t io_target_count;
+    size_t io_target_capacity;
+};
 
-    /* Check what's on the stack */
-    PithValue top = pith_pop(rt);
+/* A pmap/pfilter/preduce call. The input is cut into chunks that the
+ * calling thread and the helper jobs take in order from a shared counter,
+ * so a thread that finishes early just takes the next chunk. */
+typedef enum {
+    BATCH_MAP,
+    BATCH_FILTER,
+    BATCH_REDUCE,
+} PithBatchKind;
 
-    if (PITH_IS_BLOCK(top)) {
-        /* ( icon label block -- node ) */
-        if (!pith_stack_has(rt, 2)) {
-            pith_error(rt, "outline-item with block requires icon and label");
-            free(top.as.block);
-            free(node);
-            return false;
-        }
-        node->on_click = top.as.block;
-        PithValue label = pith_pop(rt);
-        PithValue icon = pith_pop(rt);
-        if (!PITH_IS_STRING(label) || !PITH_IS_STRING(icon)) {
-            pith_error(rt, "outline-item requires string icon and label");
-            free(node->on_click);
-            free(node);
-            pith_value_free(label);
-            pith_value_free(icon);
-            return false;
+typedef struct {
+    PithArray *out;             /* Mapped or kept items (map, filter) */
+    PithValue value;            /* Chunk total (reduce) */
+    bool has_error;
+    char error[PITH_ERROR_MAX];
+} PithChunk;
+
+struct PithBatch {
+    PithBatchKind kind;
+    PithProgram *program;
+    PithBlock block;            /* Points into a main-runtime unit */
+    const char *context;        /* Dictionary the call ran in (NULL = root) */
+    PithArray *input;           /* Read-only while the batch runs */
+    size_t chunk_size;
+    size_t chunk_count;
+    PithChunk *chunks;
+    atomic_size_t next;         /* Next chunk to take */
+    atomic_bool failed;         /* Stop taking chunks */
+    size_t helpers;             /* Helper jobs queued or running (under the pool lock) */
+};
+
+static void program_release(PithProgram *program) {
+    if (!program || --program->refs > 0) return;
+    free(program->units);
+    free(program);
+}
+
+/* Snapshot the merged units, one per source. A reloaded source takes the
+ * place of the unit it replaced so definitions merge in the same order. */
+static PithProgram* program_snapshot(PithRuntime *rt) {
+    PithProgram *program = calloc(1, sizeof(PithProgram));
+    program->refs = 1;
+    program->version = rt->program_version;
+    program->units = malloc((rt->unit_count ? rt->unit_count : 1) * sizeof(PithUnit*));
+
+    for (size_t i = 0; i < rt->unit_count; i++) {
+        PithUnit *unit = rt->units[i];
+        if (!unit->merged) continue;
+
+        bool seen = false;
+        for (size_t j = 0; j < program->count && !seen; j++) {
+            seen = strcmp(program->units[j]->name, unit->name) == 0;
         }
-        node->label = label.as.string;
-        node->icon = icon.as.string;
-    } else if (PITH_IS_STRING(top)) {
-        /* Could be ( label -- node ) or ( icon label -- node ) */
-        if (pith_stack_has(rt, 1)) {
-            PithValue maybe_icon = pith_peek(rt);
-            if (PITH_IS_STRING(maybe_icon) && strlen(maybe_icon.as.string) <= 2) {
-                /* Looks like an icon (short string) */
-                pith_pop(rt);
-                node->icon = maybe_icon.as.string;
-                node->label = top.as.string;
-            } else {
-                /* Just a label */
-                node->label = top.as.string;
+        if (seen) continue;
+
+        for (size_t j = rt->unit_count; j-- > i + 1; ) {
+            if (rt->units[j]->merged && strcmp(rt->units[j]->name, unit->name) == 0) {
+                unit = rt->units[j];
+                break;
             }
-        } else {
-            /* Just a label */
-            node->label = top.as.string;
         }
-    } else {
-        pith_error(rt, "outline-item requires string label");
-        pith_value_free(top);
-        free(node);
-        return false;
+        program->units[program->count++] = unit;
     }
+    return program;
+}
 
-    return pith_push(rt, PITH_OUTLINE_NODE(node));
+/* Borrow a main-runtime unit's tokens into a worker runtime */
+static PithUnit* worker_unit(PithRuntime *w, PithUnit *source) {
+    for (size_t i = 0; i < w->unit_count; i++) {
+        if (w->units[i]->tokens == source->tokens) return w->units[i];
+    }
+    PithUnit *unit = pith_unit_new(w, source->name);
+    unit->tokens = source->tokens;
+    unit->token_count = source->token_count;
+    unit->token_capacity = source->token_count;
+    unit->borrowed = true;
+    return unit;
 }
 
-/* outline-group: ( label children -- node ) or ( icon label children -- node )
- * Creates a group node (collapsible) for an outline view.
- */
-static bool builtin_outline_group(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 2)) return false;
+/* A worker runtime with the program's definitions merged in */
+static PithRuntime* worker_runtime_new(PithWorkerPool *pool, PithProgram *program) {
+    PithRuntime *w = pith_runtime_new(pool->fs);
+    w->out = pool->out;
+    w->debug = pool->debug;
+    w->worker = true;
 
-    PithValue children_val = pith_pop(rt);
-    if (!PITH_IS_ARRAY(children_val)) {
-        pith_error(rt, "outline-group requires array of children");
-        pith_value_free(children_val);
-        return false;
+    UnitBuild *builds = calloc(program->count ? program->count : 1, sizeof(UnitBuild));
+    for (size_t i = 0; i < program->count; i++) {
+        builds[i].unit = worker_unit(w, program->units[i]);
+        builds[i].root = pith_dict_new("root");
+        unit_scan(&builds[i]);
     }
+    pith_finish_builds(w, builds, program->count);
+    free(builds);
 
-    PithOutlineNode *node = malloc(sizeof(PithOutlineNode));
-    memset(node, 0, sizeof(PithOutlineNode));
+    /* Merging bumped the worker's own version; tag it with the program's */
+    w->program_version = program->version;
+    return w;
+}
 
-    /* Get label and optional icon */
-    PithValue label = pith_pop(rt);
-    if (!PITH_IS_STRING(label)) {
-        pith_error(rt, "outline-group requires string label");
-        pith_value_free(label);
-        pith_value_free(children_val);
-        free(node);
-        return false;
+/* A worker's runtime for a program, rebuilt when the program changed */
+static PithRuntime* worker_runtime_ready(PithWorkerPool *pool, PithRuntime **runtime,
+                                         PithProgram *program, const char *context) {
+    PithRuntime *w = *runtime;
+    if (!w || w->program_version != program->version) {
+        pith_runtime_free(w);
+        w = *runtime = worker_runtime_new(pool, program);
     }
-    node->label = label.as.string;
 
-    /* Check for icon */
-    if (pith_stack_has(rt, 1)) {
-        PithValue maybe_icon = pith_peek(rt);
-        if (PITH_IS_STRING(maybe_icon) && strlen(maybe_icon.as.string) <= 2) {
-            pith_pop(rt);
-            node->icon = maybe_icon.as.string;
-        }
+    PithDict *dict = context ? pith_find_dict(w, context) : NULL;
+    w->current_dict = dict ? dict : w->root;
+    return w;
+}
+
+/* Leave a worker's runtime clean for the next job */
+static void worker_runtime_reset(PithRuntime *w) {
+    while (w->stack_top > 0) {
+        pith_value_free(pith_pop(w));
     }
+    pith_clear_error(w);
+    w->current_dict = w->root;
+    w->exec_depth = 0;
+}
 
-    /* Convert array of outline nodes to children */
-    PithArray *arr = children_val.as.array;
-    node->children = malloc(arr->length * sizeof(PithOutlineNode*));
-    node->child_count = 0;
+/* Run one job on a worker's runtime, rebuilding it if the program changed */
+static void job_run(PithWorkerPool *pool, PithRuntime **runtime, PithJob *job) {
+    PithRuntime *w = worker_runtime_ready(pool, runtime, job->program, job->context);
 
-    for (size_t i = 0; i < arr->length; i++) {
-        if (PITH_IS_OUTLINE_NODE(arr->items[i])) {
-            node->children[node->child_count++] = arr->items[i].as.outline_node;
-            arr->items[i].type = VAL_NIL;  /* Prevent double-free */
+    PithBlock block = job->block;
+    block.unit = worker_unit(w, job->block.unit);
+
+    pith_push(w, job->input);
+    job->input = PITH_NIL();
+    if (pith_execute_block(w, &block) && w->stack_top > 0) {
+        PithValue top = pith_pop(w);
+        job->result = pith_value_sanitize(top);
+        pith_value_free(top);
+    }
+    if (w->has_error) {
+        job->has_error = true;
+        snprintf(job->error, PITH_ERROR_MAX, "%s", w->error);
+    }
+    worker_runtime_reset(w);
+}
+
+/* Call a batch's block on the values pushed above base, popping what it
+ * leaves into *result (*has_result is false when it left nothing) */
+static bool batch_call(PithRuntime *w, PithBlock *block, size_t base,
+                       PithValue *result, bool *has_result) {
+    bool ok = pith_execute_block(w, block) && !w->has_error;
+    *has_result = ok && w->stack_top > base;
+    if (*has_result) *result = pith_pop(w);
+    while (w->stack_top > base) {
+        pith_value_free(pith_pop(w));
+    }
+    return ok;
+}
+
+/* Run one chunk. Items are copied in and results copied out with the
+ * sanitize rules when w is a worker, so nothing it owns escapes. */
+static bool batch_run_chunk(PithRuntime *w, PithBlock *block, PithBatch *batch,
+                            size_t c, bool worker) {
+    PithChunk *chunk = &batch->chunks[c];
+    PithArray *input = batch->input;
+    size_t start = c * batch->chunk_size;
+    size_t end = start + batch->chunk_size;
+    if (end > input->length) end = input->length;
+
+    PithValue (*copy_in)(PithValue) = worker ? pith_value_sanitize : pith_value_copy;
+    size_t base = w->stack_top;
+    bool ok = true;
+    PithValue result;
+    bool has_result;
+
+    if (batch->kind == BATCH_REDUCE) {
+        /* Fold the chunk starting from its first item */
+        PithValue acc = copy_in(input->items[start]);
+        for (size_t i = start + 1; i < end && ok; i++) {
+            pith_push(w, acc);
+            pith_push(w, copy_in(input->items[i]));
+            ok = batch_call(w, block, base, &result, &has_result);
+            acc = has_result ? result : PITH_NIL();
+        }
+        if (ok && worker) {
+            chunk->value = pith_value_sanitize(acc);
+            pith_value_free(acc);
+        } else if (ok) {
+            chunk->value = acc;
+        } else {
+            pith_value_free(acc);
+        }
+    } else {
+        chunk->out = pith_array_new();
+        for (size_t i = start; i < end && ok; i++) {
+            pith_push(w, copy_in(input->items[i]));
+            ok = batch_call(w, block, base, &result, &has_result);
+            if (!has_result) continue;
+
+            if (batch->kind == BATCH_MAP) {
+                pith_array_push(chunk->out, worker ? pith_value_sanitize(result) : result);
+                if (worker) pith_value_free(result);
+                continue;
+            }
+            bool keep = false;
+            if (PITH_IS_BOOL(result)) keep = result.as.boolean;
+            else if (PITH_IS_NUMBER(result)) keep = result.as.number != 0;
+            else if (!PITH_IS_NIL(result)) keep = true;
+            pith_value_free(result);
+            if (keep) pith_array_push(chunk->out, copy_in(input->items[i]));
         }
     }
 
-    /* Free the array container (but not the nodes we took) */
-    pith_value_free(children_val);
+    if (!ok) {
+        chunk->has_error = true;
+        snprintf(chunk->error, PITH_ERROR_MAX, "%s", w->error);
+        pith_clear_error(w);
+    }
+    return ok;
+}
 
-    return pith_push(rt, PITH_OUTLINE_NODE(node));
+/* Take chunks until none are left or one has failed */
+static void batch_help(PithRuntime *w, PithBlock *block, PithBatch *batch, bool worker) {
+    size_t c;
+    while (!atomic_load(&batch->failed) &&
+           (c = atomic_fetch_add(&batch->next, 1)) < batch->chunk_count) {
+        if (!batch_run_chunk(w, block, batch, c, worker)) {
+            atomic_store(&batch->failed, true);
+        }
+    }
 }
 
-/* outline: ( array-of-nodes -- view )
- * Creates an outline view from an array of root nodes.
- */
-static bool builtin_outline(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
+static void batch_job_run(PithWorkerPool *pool, PithRuntime **runtime, PithBatch *batch) {
+    PithRuntime *w = worker_runtime_ready(pool, runtime, batch->program, batch->context);
+    PithBlock block = batch->block;
+    block.unit = worker_unit(w, batch->block.unit);
+    batch_help(w, &block, batch, true);
+    worker_runtime_reset(w);
+}
 
-    PithValue arr_val = pith_pop(rt);
-    if (!PITH_IS_ARRAY(arr_val)) {
-        pith_error(rt, "outline requires array of nodes");
-        pith_value_free(arr_val);
-        return false;
+/* Hand a finished job back for delivery; called with the lock held */
+static void job_done(PithWorkerPool *pool, PithJob *job) {
+    job->next = NULL;
+    if (pool->done_tail) {
+        pool->done_tail->next = job;
+    } else {
+        pool->done = job;
     }
+    pool->done_tail = job;
+}
 
-    PithView *view = malloc(sizeof(PithView));
-    memset(view, 0, sizeof(PithView));
-    view->type = VIEW_OUTLINE;
+static void* worker_main(void *arg) {
+    PithWorkerPool *pool = arg;
+    PithRuntime *runtime = NULL;
 
-    PithArray *arr = arr_val.as.array;
-    view->as.outline.roots = malloc(arr->length * sizeof(PithOutlineNode*));
-    view->as.outline.root_count = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        pool->idle++;
+        while (!pool->queue && !pool->stopping) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        pool->idle--;
+        if (pool->stopping) break;
+
+        PithJob *job = pool->queue;
+        pool->queue = job->next;
+        if (!pool->queue) pool->queue_tail = NULL;
+        pthread_mutex_unlock(&pool->lock);
+
+        PithBatch *batch = job->batch;
+        if (batch) {
+            batch_job_run(pool, &runtime, batch);
+            free(job);
+        } else {
+            job_run(pool, &runtime, job);
+        }
 
-    for (size_t i = 0; i < arr->length; i++) {
-        if (PITH_IS_OUTLINE_NODE(arr->items[i])) {
-            view->as.outline.roots[view->as.outline.root_count++] =
-                arr->items[i].as.outline_node;
-            arr->items[i].type = VAL_NIL;  /* Prevent double-free */
+        pthread_mutex_lock(&pool->lock);
+        if (batch) {
+            batch->helpers--;
+        } else {
+            job_done(pool, job);
         }
+        pthread_cond_broadcast(&pool->finished);
     }
+    pthread_mutex_unlock(&pool->lock);
 
-    pith_value_free(arr_val);
-    return pith_push(rt, PITH_VIEW(view));
+    pith_runtime_free(runtime);
+    return NULL;
 }
 
-/* icon-color: ( node color -- node )
- * Sets the icon color on an outline node.
- */
-static bool builtin_icon_color(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 2)) return false;
-
-    PithValue color_val = pith_pop(rt);
-    PithValue node_val = pith_pop(rt);
-
-    if (!PITH_IS_OUTLINE_NODE(node_val)) {
-        pith_error(rt, "icon-color requires outline node");
-        pith_value_free(color_val);
-        pith_value_free(node_val);
-        return false;
+/* Read a whole file, copying a mapped file in PITH_IO_CHUNK pieces so a
+ * cancel stops it early (a file system without map_file reads at once) */
+static void io_read(PithJob *job, const PithFileSystem *fs) {
+    if (!fs->map_file) {
+        char *contents = fs_read_string(fs, job->path);
+        if (!contents) {
+            job->io_errno = errno ? errno : ENOENT;
+            return;
+        }
+        job->result = PITH_STRING(contents);
+        return;
     }
 
-    if (!PITH_IS_STRING(color_val)) {
-        pith_error(rt, "icon-color requires string color");
-        pith_value_free(color_val);
-        return pith_push(rt, node_val);
+    size_t len = 0;
+    const char *data = fs->map_file(job->path, &len, fs->userdata);
+    if (!data) {
+        job->io_errno = errno ? errno : ENOENT;
+        return;
     }
 
-    /* Parse color string */
-    node_val.as.outline_node->icon_color = pith_color_parse(color_val.as.string);
-    pith_value_free(color_val);
+    char *contents = pith_string_alloc(len);
+    for (size_t done = 0; done < len; done += PITH_IO_CHUNK) {
+        if (atomic_load(&job->cancelled)) {
+            job->io_errno = ECANCELED;
+            break;
+        }
+        size_t n = len - done < PITH_IO_CHUNK ? len - done : PITH_IO_CHUNK;
+        memcpy(contents + done, data + done, n);
+    }
+    fs->unmap_file(data, len, fs->userdata);
 
-    return pith_push(rt, node_val);
+    if (job->io_errno) {
+        pith_string_free(contents);
+        return;
+    }
+    job->result = PITH_STRING(contents);
 }
 
-/* map: array block -> array */
-/* Applies block to each element, collects results */
-/* Array Operations */
-static bool builtin_first(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue arr = pith_pop(rt);
-    if (!PITH_IS_ARRAY(arr)) {
-        pith_error(rt, "first requires an array");
-        pith_value_free(arr);
-        return false;
+/* Write a whole file; once started a write is not cut short, so a
+ * cancelled write never leaves a half-written file behind */
+static void io_write(PithJob *job, const PithFileSystem *fs) {
+    if (atomic_load(&job->cancelled)) {
+        job->io_errno = ECANCELED;
+        return;
     }
-    if (arr.as.array->length == 0) {
-        pith_value_free(arr);
-        return pith_push(rt, PITH_NIL());
+    size_t len = pith_string_length(job->data.as.string);
+    if (!fs->write_file(job->path, job->data.as.string, len, job->write_flags, fs->userdata)) {
+        job->io_errno = errno ? errno : EIO;
+        return;
     }
-    PithValue result = pith_value_copy(arr.as.array->items[0]);
-    pith_value_free(arr);
-    return pith_push(rt, result);
+    job->result = PITH_BOOL(true);
 }
 
-static bool builtin_last(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue arr = pith_pop(rt);
-    if (!PITH_IS_ARRAY(arr)) {
-        pith_error(rt, "last requires an array");
-        pith_value_free(arr);
-        return false;
-    }
-    if (arr.as.array->length == 0) {
-        pith_value_free(arr);
-        return pith_push(rt, PITH_NIL());
+static void* io_main(void *arg) {
+    PithWorkerPool *pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        pool->io_idle++;
+        while (!pool->io_queue && !pool->stopping) {
+            pthread_cond_wait(&pool->io_wake, &pool->lock);
+        }
+        pool->io_idle--;
+        if (pool->stopping) break;
+
+        PithJob *job = pool->io_queue;
+        pool->io_queue = job->next;
+        if (!pool->io_queue) pool->io_queue_tail = NULL;
+        size_t slot = 0;
+        while (pool->io_running[slot]) slot++;
+        pool->io_running[slot] = job;
+        pthread_mutex_unlock(&pool->lock);
+
+        errno = 0;
+        if (job->kind == JOB_READ) {
+            io_read(job, &pool->fs);
+        } else {
+            io_write(job, &pool->fs);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        pool->io_running[slot] = NULL;
+        job_done(pool, job);
+        pthread_cond_broadcast(&pool->finished);
     }
-    PithValue result = pith_value_copy(arr.as.array->items[arr.as.array->length - 1]);
-    pith_value_free(arr);
-    return pith_push(rt, result);
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
 }
 
-static bool builtin_nth(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 2)) return false;
-    PithValue idx = pith_pop(rt);
-    PithValue arr = pith_pop(rt);
-    if (!PITH_IS_ARRAY(arr) || !PITH_IS_NUMBER(idx)) {
-        pith_error(rt, "nth requires array and index");
-        pith_value_free(arr);
-        pith_value_free(idx);
-        return false;
+static PithWorkerPool* worker_pool_get(PithRuntime *rt) {
+    if (rt->workers) return rt->workers;
+
+    PithWorkerPool *pool = calloc(1, sizeof(PithWorkerPool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    pthread_cond_init(&pool->io_wake, NULL);
+    pool->thread_max = pith_cpu_count();
+    if (pool->thread_max > PITH_WORKER_THREADS) pool->thread_max = PITH_WORKER_THREADS;
+    pool->fs = rt->fs;
+    pool->out = rt->out;
+    pool->debug = rt->debug;
+    rt->workers = pool;
+    return pool;
+}
+
+/* The current program snapshot, with a reference for the caller */
+static PithProgram* worker_pool_program(PithRuntime *rt, PithWorkerPool *pool) {
+    if (!pool->program || pool->program->version != rt->program_version) {
+        program_release(pool->program);
+        pool->program = program_snapshot(rt);
+    }
+    pool->program->refs++;
+    return pool->program;
+}
+
+static void job_free(PithJob *job) {
+    pith_value_free(job->input);
+    pith_value_free(job->result);
+    pith_value_free(job->data);
+    program_release(job->program);
+    free(job->context);
+    free(job->path);
+    free(job);
+}
+
+static void job_list_free(PithJob *job) {
+    while (job) {
+        PithJob *next = job->next;
+        job_free(job);
+        job = next;
+    }
+}
+
+/* Stop the workers (a running job is finished first, a running read is
+ * cancelled) and drop pending jobs */
+static void worker_pool_free(PithWorkerPool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    for (size_t i = 0; i < PITH_IO_THREADS; i++) {
+        if (pool->io_running[i]) atomic_store(&pool->io_running[i]->cancelled, true);
+    }
+    pthread_cond_broadcast(&pool->wake);
+    pthread_cond_broadcast(&pool->io_wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (size_t i = 0; i < pool->io_thread_count; i++) {
+        pthread_join(pool->io_threads[i], NULL);
+    }
+
+    job_list_free(pool->queue);
+    job_list_free(pool->io_queue);
+    job_list_free(pool->done);
+    program_release(pool->program);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->finished);
+    pthread_cond_destroy(&pool->io_wake);
+    for (size_t i = 0; i < pool->io_target_count; i++) free(pool->io_targets[i].path);
+    free(pool->io_targets);
+    free(pool);
+}
+
+/* Queue a job, starting another worker if none is free */
+static void worker_pool_submit(PithWorkerPool *pool, PithJob *job) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->queue_tail) {
+        pool->queue_tail->next = job;
+    } else {
+        pool->queue = job;
     }
-    int n = (int)idx.as.number;
-    if (n < 0 || (size_t)n >= arr.as.array->length) {
-        pith_value_free(arr);
-        return pith_push(rt, PITH_NIL());
+    pool->queue_tail = job;
+    if (job->batch) job->batch->helpers++;
+
+    if (pool->idle == 0 && pool->thread_count < pool->thread_max) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, PITH_WORKER_STACK);
+        if (pthread_create(&pool->threads[pool->thread_count], &attr, worker_main, pool) == 0) {
+            pool->thread_count++;
+        }
+        pthread_attr_destroy(&attr);
     }
-    PithValue result = pith_value_copy(arr.as.array->items[n]);
-    pith_value_free(arr);
-    return pith_push(rt, result);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
 }
 
-static bool builtin_append(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 2)) return false;
-    PithValue item = pith_pop(rt);
-    PithValue arr = pith_pop(rt);
-    if (!PITH_IS_ARRAY(arr)) {
-        pith_error(rt, "append requires an array");
-        pith_value_free(arr);
-        pith_value_free(item);
-        return false;
+/* Queue a file operation, starting another I/O thread if none is free */
+static void io_pool_submit(PithWorkerPool *pool, PithJob *job) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->io_queue_tail) {
+        pool->io_queue_tail->next = job;
+    } else {
+        pool->io_queue = job;
     }
-    PithArray *new_arr = pith_array_new();
-    for (size_t i = 0; i < arr.as.array->length; i++) {
-        pith_array_push(new_arr, pith_value_copy(arr.as.array->items[i]));
+    pool->io_queue_tail = job;
+
+    if (pool->io_idle == 0 && pool->io_thread_count < PITH_IO_THREADS &&
+        pthread_create(&pool->io_threads[pool->io_thread_count], NULL, io_main, pool) == 0) {
+        pool->io_thread_count++;
     }
-    pith_array_push(new_arr, item);
-    pith_value_free(arr);
-    return pith_push(rt, PITH_ARRAY(new_arr));
+    pthread_cond_signal(&pool->io_wake);
+    pthread_mutex_unlock(&pool->lock);
 }
 
-static bool builtin_prepend(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 2)) return false;
-    PithValue arr = pith_pop(rt);
-    PithValue item = pith_pop(rt);
-    if (!PITH_IS_ARRAY(arr)) {
-        pith_error(rt, "prepend requires an array");
-        pith_value_free(arr);
-        pith_value_free(item);
-        return false;
-    }
-    PithArray *new_arr = pith_array_new();
-    pith_array_push(new_arr, item);
-    for (size_t i = 0; i < arr.as.array->length; i++) {
-        pith_array_push(new_arr, pith_value_copy(arr.as.array->items[i]));
+/* What a file operation leaves in its signal: the contents (read), true
+ * (write) or a map with "error" and "path" */
+static PithValue io_job_value(PithJob *job) {
+    if (!job->io_errno) {
+        PithValue result = job->result;
+        job->result = PITH_NIL();
+        return result;
     }
-    pith_value_free(arr);
-    return pith_push(rt, PITH_ARRAY(new_arr));
+    const char *message = job->io_errno == ECANCELED ? "cancelled" : strerror(job->io_errno);
+    PithDict *map = pith_dict_new(NULL);
+    pith_dict_set_value(map, "error", PITH_STRING(pith_string_dup(message)));
+    pith_dict_set_value(map, "path", PITH_STRING(pith_string_dup(job->path)));
+    return PITH_DICT(map);
 }
 
-static bool builtin_slice(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 3)) return false;
-    PithValue end_val = pith_pop(rt);
-    PithValue start_val = pith_pop(rt);
-    PithValue arr = pith_pop(rt);
-    if (!PITH_IS_ARRAY(arr) || !PITH_IS_NUMBER(start_val) || !PITH_IS_NUMBER(end_val)) {
-        pith_error(rt, "slice requires array, start, end");
-        pith_value_free(arr);
-        pith_value_free(start_val);
-        pith_value_free(end_val);
-        return false;
+/* Whether job is the newest request on its signal */
+static bool io_job_current(PithWorkerPool *pool, PithJob *job) {
+    for (size_t i = 0; i < pool->io_target_count; i++) {
+        if (pool->io_targets[i].signal == job->target) {
+            return pool->io_targets[i].serial == job->serial;
+        }
     }
-    int start = (int)start_val.as.number;
-    int end = (int)end_val.as.number;
-    size_t len = arr.as.array->length;
-
-    if (start < 0) start = 0;
-    if (end < 0) end = 0;
-    if ((size_t)start > len) start = len;
-    if ((size_t)end > len) end = len;
-    if (start > end) start = end;
+    return true;
+}
 
-    PithArray *new_arr = pith_array_new();
-    for (int i = start; i < end; i++) {
-        pith_array_push(new_arr, pith_value_copy(arr.as.array->items[i]));
+void pith_runtime_poll_jobs(PithRuntime *rt) {
+    PithWorkerPool *pool = rt->workers;
+    if (!pool || pool->pending == 0) return;
+
+    pthread_mutex_lock(&pool->lock);
+    PithJob *job = pool->done;
+    pool->done = pool->done_tail = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    while (job) {
+        PithJob *next = job->next;
+        if (job->kind == JOB_SAVE) {
+            save_finished(rt, job->path, job->io_errno);
+        } else if (job->kind != JOB_SPAWN) {
+            /* A cancelled read counts as cancelled even if it got to the end */
+            if (job->kind == JOB_READ && atomic_load(&job->cancelled)) job->io_errno = ECANCELED;
+            if (io_job_current(pool, job)) pith_signal_set(job->target, io_job_value(job));
+        } else if (job->has_error) {
+            fprintf(stderr, "spawn: %s\n", job->error);
+            pith_signal_set(job->target, PITH_NIL());
+        } else {
+            pith_signal_set(job->target, job->result);
+            job->result = PITH_NIL();
+        }
+        job_free(job);
+        pool->pending--;
+        job = next;
     }
-    pith_value_free(arr);
-    return pith_push(rt, PITH_ARRAY(new_arr));
 }
 
-static bool builtin_reverse(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue arr = pith_pop(rt);
-    if (!PITH_IS_ARRAY(arr)) {
-        pith_error(rt, "reverse requires an array");
-        pith_value_free(arr);
+/* spawn: ( value block signal -- ) runs block on a worker with a copy of
+ * value on its stack; the value it leaves is written into signal later */
+static bool builtin_spawn(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 3)) return false;
+    PithValue target = pith_pop(rt);
+    PithValue block = pith_pop(rt);
+    PithValue value = pith_pop(rt);
+
+    if (!PITH_IS_BLOCK(block) || !PITH_IS_SIGNAL(target)) {
+        pith_error(rt, "spawn requires value, block and signal");
+        pith_value_free(value);
+        pith_value_free(block);
         return false;
     }
-    PithArray *new_arr = pith_array_new();
-    for (size_t i = arr.as.array->length; i > 0; i--) {
-        pith_array_push(new_arr, pith_value_copy(arr.as.array->items[i - 1]));
+
+    PithWorkerPool *pool = worker_pool_get(rt);
+    PithJob *job = calloc(1, sizeof(PithJob));
+    job->program = worker_pool_program(rt, pool);
+    job->block = *block.as.block;
+    if (rt->current_dict && rt->current_dict != rt->root) {
+        job->context = pith_strdup(rt->current_dict->name);
     }
-    pith_value_free(arr);
-    return pith_push(rt, PITH_ARRAY(new_arr));
-}
+    job->input = pith_value_sanitize(value);
+    job->target = target.as.signal;
+    pith_value_free(value);
+    pith_value_free(block);
 
-static int pith_value_compare(const void *a, const void *b) {
-    const PithValue *va = (const PithValue *)a;
-    const PithValue *vb = (const PithValue *)b;
+    pool->pending++;
+    worker_pool_submit(pool, job);
+    return true;
+}
 
-    if (PITH_IS_NUMBER(*va) && PITH_IS_NUMBER(*vb)) {
-        double diff = va->as.number - vb->as.number;
-        return (diff > 0) - (diff < 0);
-    }
-    if (PITH_IS_STRING(*va) && PITH_IS_STRING(*vb)) {
-        return strcmp(va->as.string, vb->as.string);
+/* Block until some job has finished, then deliver the finished ones */
+static void jobs_wait(PithRuntime *rt) {
+    PithWorkerPool *pool = rt->workers;
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->done) {
+        pthread_cond_wait(&pool->finished, &pool->lock);
     }
-    return 0;
+    pthread_mutex_unlock(&pool->lock);
+    pith_runtime_poll_jobs(rt);
 }
 
-static bool builtin_sort(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 1)) return false;
-    PithValue arr = pith_pop(rt);
-    if (!PITH_IS_ARRAY(arr)) {
-        pith_error(rt, "sort requires an array");
-        pith_value_free(arr);
-        return false;
-    }
-    PithArray *new_arr = pith_array_new();
-    for (size_t i = 0; i < arr.as.array->length; i++) {
-        pith_array_push(new_arr, pith_value_copy(arr.as.array->items[i]));
+/* spawn-flush: ( -- ) waits for every spawned job and file operation and
+ * delivers its result */
+static bool builtin_spawn_flush(PithRuntime *rt) {
+    while (rt->workers && rt->workers->pending > 0) {
+        jobs_wait(rt);
     }
-    qsort(new_arr->items, new_arr->length, sizeof(PithValue), pith_value_compare);
-    pith_value_free(arr);
-    return pith_push(rt, PITH_ARRAY(new_arr));
+    return true;
 }
 
-static bool builtin_index_of(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 2)) return false;
-    PithValue item = pith_pop(rt);
-    PithValue arr = pith_pop(rt);
-    if (!PITH_IS_ARRAY(arr)) {
-        pith_error(rt, "index-of requires an array");
-        pith_value_free(arr);
-        pith_value_free(item);
-        return false;
-    }
-    double idx = -1;
-    for (size_t i = 0; i < arr.as.array->length; i++) {
-        if (pith_value_equal(arr.as.array->items[i], item)) {
-            idx = (double)i;
+/* Take the queued job filling target off the I/O queue, if there is one */
+static PithJob* io_unqueue(PithWorkerPool *pool, PithSignal *target) {
+    PithJob *found = NULL;
+    pthread_mutex_lock(&pool->lock);
+    for (PithJob **link = &pool->io_queue; *link; link = &(*link)->next) {
+        if ((*link)->target == target) {
+            found = *link;
+            *link = found->next;
+            if (pool->io_queue_tail == found) {
+                pool->io_queue_tail = NULL;
+                for (PithJob *j = pool->io_queue; j; j = j->next) pool->io_queue_tail = j;
+            }
             break;
         }
     }
-    pith_value_free(arr);
-    pith_value_free(item);
-    return pith_push(rt, PITH_NUMBER(idx));
+    pthread_mutex_unlock(&pool->lock);
+    return found;
+}
+
+/* The target of path's reads or writes, made on first use */
+static PithIoTarget* io_target(PithRuntime *rt, PithWorkerPool *pool, PithJobKind kind,
+                               const char *path) {
+    for (size_t i = 0; i < pool->io_target_count; i++) {
+        PithIoTarget *t = &pool->io_targets[i];
+        if (t->kind == kind && strcmp(t->path, path) == 0) return t;
+    }
+    if (pool->io_target_count >= pool->io_target_capacity) {
+        pool->io_target_capacity = pool->io_target_capacity ? pool->io_target_capacity * 2 : 8;
+        pool->io_targets = realloc(pool->io_targets,
+                                   pool->io_target_capacity * sizeof(PithIoTarget));
+    }
+    PithIoTarget *t = &pool->io_targets[pool->io_target_count++];
+    t->path = pith_strdup(path);
+    t->kind = kind;
+    t->signal = pith_signal_new(rt, PITH_NIL());
+    t->serial = 0;
+    return t;
+}
+
+/* Start a file operation on an I/O thread, pushing the signal it fills */
+static bool io_start(PithRuntime *rt, PithJobKind kind, PithValue path, PithValue data) {
+    PithWorkerPool *pool = worker_pool_get(rt);
+    PithIoTarget *target = io_target(rt, pool, kind, path.as.string);
+
+    /* A request for the path that hasn't started is replaced by this one */
+    PithJob *stale = io_unqueue(pool, target->signal);
+    if (stale) {
+        job_free(stale);
+        pool->pending--;
+    }
+    if (target->serial > 0) pith_signal_set(target->signal, PITH_NIL());
+
+    PithJob *job = calloc(1, sizeof(PithJob));
+    job->kind = kind;
+    job->path = pith_strdup(path.as.string);
+    job->data = data;
+    job->write_flags = pith_write_flags(rt);
+    job->target = target->signal;
+    job->serial = ++target->serial;
+    pith_value_free(path);
+
+    pool->pending++;
+    io_pool_submit(pool, job);
+    return pith_push(rt, PITH_SIGNAL(job->target));
 }
 
-static bool builtin_empty(PithRuntime *rt) {
+/* file-read-async: ( path -- signal ) reads on an I/O thread; the signal
+ * becomes the contents, or an error map */
+static bool builtin_file_read_async(PithRuntime *rt) {
     if (!pith_stack_has(rt, 1)) return false;
-    PithValue arr = pith_pop(rt);
-    if (!PITH_IS_ARRAY(arr)) {
-        pith_error(rt, "empty? requires an array");
-        pith_value_free(arr);
+    PithValue path = pith_pop(rt);
+
+    if (!PITH_IS_STRING(path)) {
+        pith_error(rt, "file-read-async requires a string path");
+        pith_value_free(path);
         return false;
     }
-    bool empty = arr.as.array->length == 0;
-    pith_value_free(arr);
-    return pith_push(rt, PITH_BOOL(empty));
+    return io_start(rt, JOB_READ, path, PITH_NIL());
 }
 
-static bool builtin_filter(PithRuntime *rt) {
+/* file-write-async: ( contents path -- signal ) writes on an I/O thread;
+ * the signal becomes true, or an error map */
+static bool builtin_file_write_async(PithRuntime *rt) {
     if (!pith_stack_has(rt, 2)) return false;
-    PithValue block_val = pith_pop(rt);
-    PithValue arr_val = pith_pop(rt);
+    PithValue path = pith_pop(rt);
+    PithValue contents = pith_pop(rt);
 
-    if (!PITH_IS_ARRAY(arr_val)) {
-        pith_error(rt, "filter requires array as first argument");
-        pith_value_free(arr_val);
-        pith_value_free(block_val);
+    if (!PITH_IS_STRING(path)) {
+        pith_error(rt, "file-write-async requires a string path");
+        pith_value_free(path);
+        pith_value_free(contents);
         return false;
     }
-    if (!PITH_IS_BLOCK(block_val)) {
-        pith_error(rt, "filter requires block as second argument");
-        pith_value_free(arr_val);
-        pith_value_free(block_val);
+    if (!PITH_IS_STRING(contents)) {
+        pith_error(rt, "file-write-async requires string contents");
+        pith_value_free(path);
+        pith_value_free(contents);
         return false;
     }
+    return io_start(rt, JOB_WRITE, path, contents);
+}
 
-    PithArray *input = arr_val.as.array;
-    PithBlock *block = block_val.as.block;
-    PithArray *output = pith_array_new();
+/* cancel-io: ( signal -- ) stops the file operation filling signal. A
+ * queued one never starts, a running read stops at its next chunk; the
+ * signal becomes an error map saying "cancelled". A finished or running
+ * write is left alone. */
+static bool builtin_cancel_io(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue target = pith_pop(rt);
 
-    for (size_t i = 0; i < input->length; i++) {
-        pith_push(rt, pith_value_copy(input->items[i]));
-        pith_execute_block(rt, block);
-        if (pith_stack_has(rt, 1)) {
-            PithValue result = pith_pop(rt);
-            bool keep = false;
-            if (PITH_IS_BOOL(result)) keep = result.as.boolean;
-            else if (PITH_IS_NUMBER(result)) keep = result.as.number != 0;
-            else if (!PITH_IS_NIL(result)) keep = true;
-            pith_value_free(result);
-            if (keep) {
-                pith_array_push(output, pith_value_copy(input->items[i]));
+    if (!PITH_IS_SIGNAL(target)) {
+        pith_error(rt, "cancel-io requires a signal");
+        pith_value_free(target);
+        return false;
+    }
+    PithWorkerPool *pool = rt->workers;
+    if (!pool) return true;
+
+    PithJob *cancelled = io_unqueue(pool, target.as.signal);
+    pthread_mutex_lock(&pool->lock);
+    for (size_t i = 0; i < PITH_IO_THREADS && !cancelled; i++) {
+        PithJob *job = pool->io_running[i];
+        if (job && job->target == target.as.signal) atomic_store(&job->cancelled, true);
+    }
+    /* Finished but not delivered: the program hasn't seen the result yet */
+    for (PithJob *job = pool->done; job && !cancelled; job = job->next) {
+        if (job->target == target.as.signal) atomic_store(&job->cancelled, true);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (cancelled) {
+        cancelled->io_errno = ECANCELED;
+        pith_signal_set(cancelled->target, io_job_value(cancelled));
+        job_free(cancelled);
+        pool->pending--;
+    }
+    return true;
+}
+
+/* Words a pmap/pfilter/preduce block may not use: they reach signals,
+ * dictionaries or the outside world, none of which a worker shares */
+static const char *const impure_words[] = {
+    "signal", "deref", "set-path", "get-path", "live-search", "search-flush",
+    "spawn", "spawn-flush", "print", "file-write", "file-append",
+    "file-read-async", "file-write-async", "cancel-io", "file-save", "save-flush",
+    "save-delay", "save-sync", "after", "every", "cancel-timer", NULL
+};
+
+/* Check tokens for anything touching signals or dictionaries, following
+ * the words they call. On failure names the offending word in rt's error. */
+static bool tokens_are_pure(PithRuntime *rt, const char *word, PithUnit *unit,
+                            size_t start, size_t end, PithSlot ***seen, size_t *seen_count) {
+    for (size_t i = start; i < end; i++) {
+        PithToken *tok = &unit->tokens[i];
+        if (tok->type == TOK_DOT) {
+            pith_error(rt, "%s block must not touch signals or dictionaries ('%s.')", word,
+                       i > start && unit->tokens[i - 1].text ? unit->tokens[i - 1].text : "");
+            return false;
+        }
+        if (tok->type != TOK_WORD) continue;
+
+        const char *name = tok->text;
+        size_t len = strlen(name);
+        bool impure = len > 1 && name[len - 1] == '!';
+        for (size_t k = 0; !impure && impure_words[k]; k++) {
+            impure = strcmp(name, impure_words[k]) == 0;
+        }
+        if (!impure && find_builtin(name)) continue;
+
+        PithSlot *slot = impure ? NULL : pith_dict_lookup(rt->current_dict, name);
+        if (!impure && !slot) impure = pith_find_dict(rt, name) != NULL;
+        if (!impure && slot) impure = slot->is_cached &&
+            (slot->cached.type == VAL_SIGNAL || slot->cached.type == VAL_DICT);
+        if (impure) {
+            pith_error(rt, "%s block must not touch signals or dictionaries ('%s')", word, name);
+            return false;
+        }
+        if (!slot) continue;
+
+        bool checked = false;
+        for (size_t k = 0; k < *seen_count && !checked; k++) {
+            checked = (*seen)[k] == slot;
+        }
+        if (checked) continue;
+        *seen = realloc(*seen, (*seen_count + 1) * sizeof(PithSlot*));
+        (*seen)[(*seen_count)++] = slot;
+        if (!tokens_are_pure(rt, word, slot->unit, slot->body_start, slot->body_end,
+                             seen, seen_count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool block_is_pure(PithRuntime *rt, const char *word, PithBlock *block) {
+    PithSlot **seen = NULL;
+    size_t seen_count = 0;
+    bool pure = tokens_are_pure(rt, word, block->unit, block->start, block->end,
+                                &seen, &seen_count);
+    free(seen);
+    return pure;
+}
+
+/* Run a batch over its input: helpers on the pool take chunks alongside
+ * the calling thread. Worker runtimes and small inputs run inline. */
+static bool batch_run(PithRuntime *rt, const char *word, PithBatch *batch) {
+    size_t n = batch->input->length;
+    PithWorkerPool *pool = rt->worker ? NULL : worker_pool_get(rt);
+    size_t threads = pool ? pool->thread_max : 1;
+
+    batch->chunk_size = n / (threads * PITH_PARALLEL_SPLIT) + 1;
+    if (batch->chunk_size < PITH_PARALLEL_CHUNK) batch->chunk_size = PITH_PARALLEL_CHUNK;
+    batch->chunk_count = (n + batch->chunk_size - 1) / batch->chunk_size;
+    batch->chunks = calloc(batch->chunk_count ? batch->chunk_count : 1, sizeof(PithChunk));
+    atomic_init(&batch->next, 0);
+    atomic_init(&batch->failed, false);
+    if (rt->current_dict && rt->current_dict != rt->root) {
+        batch->context = rt->current_dict->name;
+    }
+
+    size_t helpers = batch->chunk_count > 1 && pool ? batch->chunk_count - 1 : 0;
+    if (helpers > threads) helpers = threads;
+    if (helpers > 0) {
+        batch->program = worker_pool_program(rt, pool);
+        for (size_t i = 0; i < helpers; i++) {
+            PithJob *job = calloc(1, sizeof(PithJob));
+            job->batch = batch;
+            worker_pool_submit(pool, job);
+        }
+    }
+
+    batch_help(rt, &batch->block, batch, false);
+
+    if (helpers > 0) {
+        /* Helpers still queued behind other jobs are no longer needed */
+        pthread_mutex_lock(&pool->lock);
+        PithJob **link = &pool->queue;
+        pool->queue_tail = NULL;
+        while (*link) {
+            PithJob *job = *link;
+            if (job->batch == batch) {
+                *link = job->next;
+                batch->helpers--;
+                free(job);
+            } else {
+                pool->queue_tail = job;
+                link = &job->next;
             }
         }
+        while (batch->helpers > 0) {
+            pthread_cond_wait(&pool->finished, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        program_release(batch->program);
     }
 
-    pith_value_free(arr_val);
-    free(block);
-    return pith_push(rt, PITH_ARRAY(output));
+    /* Report the first failure in input order, as the serial words would */
+    for (size_t c = 0; c < batch->chunk_count; c++) {
+        if (batch->chunks[c].has_error) {
+            pith_error(rt, "%s: %s", word, batch->chunks[c].error);
+            return false;
+        }
+    }
+    return true;
 }
 
-static bool builtin_each(PithRuntime *rt) {
+static void batch_free(PithBatch *batch) {
+    for (size_t c = 0; c < batch->chunk_count; c++) {
+        pith_array_free(batch->chunks[c].out);
+        pith_value_free(batch->chunks[c].value);
+    }
+    free(batch->chunks);
+}
+
+/* Shared by pmap and pfilter: ( array block -- array ) */
+static bool parallel_collect(PithRuntime *rt, const char *word, PithBatchKind kind) {
     if (!pith_stack_has(rt, 2)) return false;
     PithValue block_val = pith_pop(rt);
     PithValue arr_val = pith_pop(rt);
 
-    if (!PITH_IS_ARRAY(arr_val)) {
-        pith_error(rt, "each requires array as first argument");
+    if (!PITH_IS_ARRAY(arr_val) || !PITH_IS_BLOCK(block_val)) {
+        pith_error(rt, "%s requires array and block", word);
         pith_value_free(arr_val);
         pith_value_free(block_val);
         return false;
     }
-    if (!PITH_IS_BLOCK(block_val)) {
-        pith_error(rt, "each requires block as second argument");
+
+    PithBatch batch = {
+        .kind = kind, .block = *block_val.as.block, .input = arr_val.as.array
+    };
+    pith_value_free(block_val);
+    if (!block_is_pure(rt, word, &batch.block) || !batch_run(rt, word, &batch)) {
+        batch_free(&batch);
         pith_value_free(arr_val);
-        pith_value_free(block_val);
         return false;
     }
 
-    PithArray *input = arr_val.as.array;
-    PithBlock *block = block_val.as.block;
-
-    for (size_t i = 0; i < input->length; i++) {
-        pith_push(rt, pith_value_copy(input->items[i]));
-        pith_execute_block(rt, block);
+    /* Move the chunk results into one array, in order */
+    size_t total = 0;
+    for (size_t c = 0; c < batch.chunk_count; c++) {
+        total += batch.chunks[c].out->length;
+    }
+    PithArray *output = pith_array_new();
+    output->items = malloc((total ? total : 1) * sizeof(PithValue));
+    output->capacity = total ? total : 1;
+    for (size_t c = 0; c < batch.chunk_count; c++) {
+        PithArray *out = batch.chunks[c].out;
+        memcpy(output->items + output->length, out->items, out->length * sizeof(PithValue));
+        output->length += out->length;
+        out->length = 0;
     }
 
+    batch_free(&batch);
     pith_value_free(arr_val);
-    free(block);
-    return true;
+    return pith_push(rt, PITH_ARRAY(output));
 }
 
-static bool builtin_reduce(PithRuntime *rt) {
+/* pmap: ( array block -- array ) map over chunks in parallel */
+static bool builtin_pmap(PithRuntime *rt) {
+    return parallel_collect(rt, "pmap", BATCH_MAP);
+}
+
+/* pfilter: ( array block -- array ) filter over chunks in parallel */
+static bool builtin_pfilter(PithRuntime *rt) {
+    return parallel_collect(rt, "pfilter", BATCH_FILTER);
+}
+
+/* preduce: ( array initial block -- value ) folds each chunk from its first
+ * item, then folds initial and the chunk totals in order. The block must
+ * be associative for this to match reduce. */
+static bool builtin_preduce(PithRuntime *rt) {
     if (!pith_stack_has(rt, 3)) return false;
     PithValue block_val = pith_pop(rt);
     PithValue initial = pith_pop(rt);
     PithValue arr_val = pith_pop(rt);
 
-    if (!PITH_IS_ARRAY(arr_val)) {
-        pith_error(rt, "reduce requires array as first argument");
+    if (!PITH_IS_ARRAY(arr_val) || !PITH_IS_BLOCK(block_val)) {
+        pith_error(rt, "preduce requires array, initial value and block");
         pith_value_free(arr_val);
         pith_value_free(initial);
         pith_value_free(block_val);
         return false;
     }
-    if (!PITH_IS_BLOCK(block_val)) {
-        pith_error(rt, "reduce requires block as third argument");
+
+    PithBatch batch = {
+        .kind = BATCH_REDUCE, .block = *block_val.as.block, .input = arr_val.as.array
+    };
+    pith_value_free(block_val);
+    if (!block_is_pure(rt, "preduce", &batch.block) || !batch_run(rt, "preduce", &batch)) {
+        batch_free(&batch);
         pith_value_free(arr_val);
         pith_value_free(initial);
-        pith_value_free(block_val);
         return false;
     }
 
-    PithArray *input = arr_val.as.array;
-    PithBlock *block = block_val.as.block;
-    PithValue accumulator = initial;
-
-    for (size_t i = 0; i < input->length; i++) {
-        pith_push(rt, accumulator);
-        pith_push(rt, pith_value_copy(input->items[i]));
-        pith_execute_block(rt, block);
-        if (pith_stack_has(rt, 1)) {
-            accumulator = pith_pop(rt);
-        } else {
-            accumulator = PITH_NIL();
+    PithValue acc = initial;
+    size_t base = rt->stack_top;
+    for (size_t c = 0; c < batch.chunk_count; c++) {
+        PithValue result;
+        bool has_result;
+        pith_push(rt, acc);
+        pith_push(rt, batch.chunks[c].value);
+        batch.chunks[c].value = PITH_NIL();
+        if (!batch_call(rt, &batch.block, base, &result, &has_result)) {
+            batch_free(&batch);
+            pith_value_free(arr_val);
+            return false;
         }
+        acc = has_result ? result : PITH_NIL();
     }
 
+    batch_free(&batch);
     pith_value_free(arr_val);
-    free(block);
-    return pith_push(rt, accumulator);
+    return pith_push(rt, acc);
 }
 
-static bool builtin_find(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 2)) return false;
-    PithValue block_val = pith_pop(rt);
-    PithValue arr_val = pith_pop(rt);
+/* ========================================================================
+   TIMERS
+   A timer due at tick t sits in slot t % PITH_TIMER_SLOTS, next to timers
+   due a whole number of turns later. Advancing the wheel to the current
+   tick visits only the slots in between (all of them at most once) and
+   takes the timers whose tick has come.
+   ======================================================================== */
 
-    if (!PITH_IS_ARRAY(arr_val)) {
-        pith_error(rt, "find requires array as first argument");
-        pith_value_free(arr_val);
-        pith_value_free(block_val);
-        return false;
+static double pith_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/* Milliseconds since the runtime was created */
+static double timer_now(PithRuntime *rt) {
+    return pith_clock_ms() - rt->timer_epoch;
+}
+
+static void timer_insert(PithRuntime *rt, PithTimer *timer) {
+    timer->tick = (uint64_t)ceil(timer->due / PITH_TIMER_TICK_MS);
+    if (timer->tick <= rt->timer_tick) timer->tick = rt->timer_tick + 1;
+
+    PithTimer **slot = &rt->timer_wheel[timer->tick % PITH_TIMER_SLOTS];
+    timer->next = *slot;
+    *slot = timer;
+    rt->timer_count++;
+    if (rt->timer_next_due < 0 || timer->due < rt->timer_next_due) {
+        rt->timer_next_due = timer->due;
     }
-    if (!PITH_IS_BLOCK(block_val)) {
-        pith_error(rt, "find requires block as second argument");
-        pith_value_free(arr_val);
-        pith_value_free(block_val);
-        return false;
+}
+
+/* Find the earliest deadline again after it may have left the wheel */
+static void timer_find_next_due(PithRuntime *rt) {
+    rt->timer_next_due = -1;
+    for (size_t i = 0; i < PITH_TIMER_SLOTS && rt->timer_count > 0; i++) {
+        for (PithTimer *t = rt->timer_wheel[i]; t; t = t->next) {
+            if (rt->timer_next_due < 0 || t->due < rt->timer_next_due) {
+                rt->timer_next_due = t->due;
+            }
+        }
     }
+}
 
-    PithArray *input = arr_val.as.array;
-    PithBlock *block = block_val.as.block;
-    PithValue found = PITH_NIL();
+/* Move the timers due by now from the wheel onto rt->timers_due */
+static void timer_advance(PithRuntime *rt, double now) {
+    uint64_t target = (uint64_t)floor(now / PITH_TIMER_TICK_MS);
+    if (target <= rt->timer_tick) return;
 
-    for (size_t i = 0; i < input->length; i++) {
-        pith_push(rt, pith_value_copy(input->items[i]));
-        pith_execute_block(rt, block);
-        if (pith_stack_has(rt, 1)) {
-            PithValue result = pith_pop(rt);
-            bool match = false;
-            if (PITH_IS_BOOL(result)) match = result.as.boolean;
-            else if (PITH_IS_NUMBER(result)) match = result.as.number != 0;
-            else if (!PITH_IS_NIL(result)) match = true;
-            pith_value_free(result);
-            if (match) {
-                found = pith_value_copy(input->items[i]);
-                break;
+    uint64_t steps = target - rt->timer_tick;
+    if (steps > PITH_TIMER_SLOTS) steps = PITH_TIMER_SLOTS;
+    for (uint64_t s = 1; s <= steps; s++) {
+        PithTimer **link = &rt->timer_wheel[(rt->timer_tick + s) % PITH_TIMER_SLOTS];
+        while (*link) {
+            PithTimer *timer = *link;
+            if (timer->tick <= target) {
+                *link = timer->next;
+                timer->next = rt->timers_due;
+                rt->timers_due = timer;
+                rt->timer_count--;
+            } else {
+                link = &timer->next;
             }
         }
     }
+    rt->timer_tick = target;
+}
 
-    pith_value_free(arr_val);
-    free(block);
-    return pith_push(rt, found);
+static int compare_timers(const void *a, const void *b) {
+    const PithTimer *x = *(PithTimer *const *)a;
+    const PithTimer *y = *(PithTimer *const *)b;
+    if (x->due != y->due) return x->due < y->due ? -1 : 1;
+    return x->id < y->id ? -1 : x->id > y->id;
 }
 
-static bool builtin_any(PithRuntime *rt) {
-    if (!pith_stack_has(rt, 2)) return false;
-    PithValue block_val = pith_pop(rt);
-    PithValue arr_val = pith_pop(rt);
+/* Fire every due timer once, oldest deadline first. Repeating timers are
+ * filed again after their block runs, so a slow block never refires in
+ * the same batch. */
+static void timers_fire(PithRuntime *rt) {
+    double now = timer_now(rt);
+    timer_advance(rt, now);
+    if (!rt->timers_due) return;
+    timer_find_next_due(rt);
 
-    if (!PITH_IS_ARRAY(arr_val)) {
-        pith_error(rt, "any requires array as first argument");
-        pith_value_free(arr_val);
-        pith_value_free(block_val);
-        return false;
+    size_t count = 0;
+    for (PithTimer *t = rt->timers_due; t; t = t->next) count++;
+    PithTimer **batch = malloc(count * sizeof(PithTimer*));
+    count = 0;
+    for (PithTimer *t = rt->timers_due; t; t = t->next) batch[count++] = t;
+    qsort(batch, count, sizeof(PithTimer*), compare_timers);
+
+    for (size_t i = 0; i < count; i++) {
+        PithTimer *timer = batch[i];
+        if (timer->cancelled) continue;
+
+        PithDict *saved_dict = rt->current_dict;
+        rt->current_dict = timer->context;
+        pith_execute_block(rt, &timer->block);
+        rt->current_dict = saved_dict;
+        if (rt->has_error) {
+            fprintf(stderr, "timer: %s\n", pith_get_error(rt));
+            pith_clear_error(rt);
+        }
     }
-    if (!PITH_IS_BLOCK(block_val)) {
-        pith_error(rt, "any requires block as second argument");
-        pith_value_free(arr_val);
-        pith_value_free(block_val);
-        return false;
+
+    /* Re-file repeating timers; drop the rest */
+    rt->timers_due = NULL;
+    now = timer_now(rt);
+    for (size_t i = 0; i < count; i++) {
+        PithTimer *timer = batch[i];
+        if (timer->interval > 0 && !timer->cancelled) {
+            timer->due += timer->interval;
+            if (timer->due <= now) timer->due = now + timer->interval;
+            timer_insert(rt, timer);
+        } else {
+            free(timer);
+        }
     }
+    free(batch);
+}
 
-    PithArray *input = arr_val.as.array;
-    PithBlock *block = block_val.as.block;
-    bool any_match = false;
+double pith_runtime_next_timer(PithRuntime *rt) {
+    double next = saves_next_due(rt);
+    if (rt->timer_next_due >= 0 && (next < 0 || rt->timer_next_due < next)) {
+        next = rt->timer_next_due;
+    }
+    if (next < 0) return -1;
 
-    for (size_t i = 0; i < input->length; i++) {
-        pith_push(rt, pith_value_copy(input->items[i]));
-        pith_execute_block(rt, block);
-        if (pith_stack_has(rt, 1)) {
-            PithValue result = pith_pop(rt);
-            bool match = false;
-            if (PITH_IS_BOOL(result)) match = result.as.boolean;
-            else if (PITH_IS_NUMBER(result)) match = result.as.number != 0;
-            else if (!PITH_IS_NIL(result)) match = true;
-            pith_value_free(result);
-            if (match) {
-                any_match = true;
-                break;
-            }
+    /* A timer only comes off the wheel once its tick has started */
+    double wait = ceil(next / PITH_TIMER_TICK_MS) * PITH_TIMER_TICK_MS - timer_now(rt);
+    return wait > 0 ? wait : 0;
+}
+
+static void timers_free(PithRuntime *rt) {
+    for (size_t i = 0; i < PITH_TIMER_SLOTS; i++) {
+        while (rt->timer_wheel[i]) {
+            PithTimer *next = rt->timer_wheel[i]->next;
+            free(rt->timer_wheel[i]);
+            rt->timer_wheel[i] = next;
         }
     }
-
-    pith_value_free(arr_val);
-    free(block);
-    return pith_push(rt, PITH_BOOL(any_match));
 }
 
-static bool builtin_all(PithRuntime *rt) {
+/* Shared by after and every: ( ms block -- id ) */
+static bool timer_start(PithRuntime *rt, const char *word, bool repeat) {
     if (!pith_stack_has(rt, 2)) return false;
-    PithValue block_val = pith_pop(rt);
-    PithValue arr_val = pith_pop(rt);
+    PithValue block = pith_pop(rt);
+    PithValue ms = pith_pop(rt);
 
-    if (!PITH_IS_ARRAY(arr_val)) {
-        pith_error(rt, "all requires array as first argument");
-        pith_value_free(arr_val);
-        pith_value_free(block_val);
+    if (!PITH_IS_NUMBER(ms) || !PITH_IS_BLOCK(block)) {
+        pith_error(rt, "%s requires milliseconds and block", word);
+        pith_value_free(ms);
+        pith_value_free(block);
         return false;
     }
-    if (!PITH_IS_BLOCK(block_val)) {
-        pith_error(rt, "all requires block as second argument");
-        pith_value_free(arr_val);
-        pith_value_free(block_val);
+
+    double delay = ms.as.number > 0 ? ms.as.number : 0;
+    PithTimer *timer = calloc(1, sizeof(PithTimer));
+    timer->id = ++rt->timer_next_id;
+    timer->due = timer_now(rt) + delay;
+    if (repeat) {
+        timer->interval = delay > PITH_TIMER_TICK_MS ? delay : PITH_TIMER_TICK_MS;
+    }
+    timer->block = *block.as.block;
+    timer->context = rt->current_dict;
+    pith_value_free(block);
+
+    timer_insert(rt, timer);
+    return pith_push(rt, PITH_NUMBER((double)timer->id));
+}
+
+/* after: ( ms block -- id ) runs block once, ms from now */
+static bool builtin_after(PithRuntime *rt) {
+    return timer_start(rt, "after", false);
+}
+
+/* every: ( ms block -- id ) runs block every ms until cancelled */
+static bool builtin_every(PithRuntime *rt) {
+    return timer_start(rt, "every", true);
+}
+
+/* cancel-timer: ( id -- ) stops a timer; unknown ids are ignored */
+static bool builtin_cancel_timer(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue id = pith_pop(rt);
+    if (!PITH_IS_NUMBER(id)) {
+        pith_error(rt, "cancel-timer requires a timer id");
+        pith_value_free(id);
         return false;
     }
 
-    PithArray *input = arr_val.as.array;
-    PithBlock *block = block_val.as.block;
-    bool all_match = true;
+    /* A timer firing in this batch is only marked; timers_fire frees it */
+    for (PithTimer *t = rt->timers_due; t; t = t->next) {
+        if ((double)t->id == id.as.number) t->cancelled = true;
+    }
+    for (size_t i = 0; i < PITH_TIMER_SLOTS; i++) {
+        for (PithTimer **link = &rt->timer_wheel[i]; *link; link = &(*link)->next) {
+            PithTimer *timer = *link;
+            if ((double)timer->id == id.as.number) {
+                *link = timer->next;
+                rt->timer_count--;
+                if (timer->due <= rt->timer_next_due) timer_find_next_due(rt);
+                free(timer);
+                return true;
+            }
+        }
+    }
+    return true;
+}
+
+/* ========================================================================
+   SAVES
+   ======================================================================== */
+
+static PithSave* save_find(PithRuntime *rt, const char *path) {
+    for (size_t i = 0; i < rt->save_count; i++) {
+        if (strcmp(rt->saves[i].path, path) == 0) return &rt->saves[i];
+    }
+    return NULL;
+}
 
-    for (size_t i = 0; i < input->length; i++) {
-        pith_push(rt, pith_value_copy(input->items[i]));
-        pith_execute_block(rt, block);
-        if (pith_stack_has(rt, 1)) {
-            PithValue result = pith_pop(rt);
-            bool match = false;
-            if (PITH_IS_BOOL(result)) match = result.as.boolean;
-            else if (PITH_IS_NUMBER(result)) match = result.as.number != 0;
-            else if (!PITH_IS_NIL(result)) match = true;
-            pith_value_free(result);
-            if (!match) {
-                all_match = false;
-                break;
-            }
+/* Hand a save's newest contents to an I/O thread */
+static void save_start(PithRuntime *rt, PithSave *save) {
+    PithWorkerPool *pool = worker_pool_get(rt);
+    PithJob *job = calloc(1, sizeof(PithJob));
+    job->kind = JOB_SAVE;
+    job->path = pith_strdup(save->path);
+    job->data = save->contents;
+    job->write_flags = pith_write_flags(rt);
+    save->contents = PITH_NIL();
+    save->writing = true;
+
+    pool->pending++;
+    io_pool_submit(pool, job);
+}
+
+/* Start every save that is due, or every waiting one when forced */
+static void saves_fire(PithRuntime *rt, bool force) {
+    double now = timer_now(rt);
+    for (size_t i = 0; i < rt->save_count; i++) {
+        PithSave *save = &rt->saves[i];
+        if (!save->writing && !PITH_IS_NIL(save->contents) && (force || save->due <= now)) {
+            save_start(rt, save);
         }
     }
+}
 
-    pith_value_free(arr_val);
-    free(block);
-    return pith_push(rt, PITH_BOOL(all_match));
+/* A save's write is done: report failure, and start the contents saved
+ * meanwhile if they are due, or forget the path when none are waiting */
+static void save_finished(PithRuntime *rt, const char *path, int err) {
+    if (err) fprintf(stderr, "file-save: %s: %s\n", path, strerror(err));
+
+    PithSave *save = save_find(rt, path);
+    if (!save) return;
+    save->writing = false;
+    if (PITH_IS_NIL(save->contents)) {
+        free(save->path);
+        *save = rt->saves[--rt->save_count];
+    } else if (save->due <= timer_now(rt)) {
+        save_start(rt, save);
+    }
 }
 
-static bool builtin_map(PithRuntime *rt) {
+/* Runtime clock of the next save to start, or -1. Saves waiting behind a
+ * running write start when it finishes, not on a tick. */
+static double saves_next_due(PithRuntime *rt) {
+    double next = -1;
+    for (size_t i = 0; i < rt->save_count; i++) {
+        PithSave *save = &rt->saves[i];
+        if (save->writing || PITH_IS_NIL(save->contents)) continue;
+        if (next < 0 || save->due < next) next = save->due;
+    }
+    return next;
+}
+
+/* Write every waiting save now and wait until all are on disk */
+static void saves_flush(PithRuntime *rt) {
+    while (rt->save_count > 0) {
+        saves_fire(rt, true);
+        jobs_wait(rt);
+    }
+}
+
+/* file-save: ( contents path -- ) writes contents to path on an I/O
+ * thread after the save delay. Saving the same path again before then
+ * replaces the contents, so only the newest are written. */
+static bool builtin_file_save(PithRuntime *rt) {
     if (!pith_stack_has(rt, 2)) return false;
-    PithValue block_val = pith_pop(rt);
-    PithValue arr_val = pith_pop(rt);
+    PithValue path = pith_pop(rt);
+    PithValue contents = pith_pop(rt);
 
-    if (!PITH_IS_ARRAY(arr_val)) {
-        pith_error(rt, "map requires array as first argument");
+    if (!PITH_IS_STRING(path)) {
+        pith_error(rt, "file-save requires a string path");
+        pith_value_free(path);
+        pith_value_free(contents);
         return false;
     }
-    if (!PITH_IS_BLOCK(block_val)) {
-        pith_error(rt, "map requires block as second argument");
+    if (!PITH_IS_STRING(contents)) {
+        pith_error(rt, "file-save requires string contents");
+        pith_value_free(path);
+        pith_value_free(contents);
         return false;
     }
 
-    PithArray *input = arr_val.as.array;
-    PithBlock *block = block_val.as.block;
-    PithArray *output = pith_array_new();
+    PithSave *save = save_find(rt, path.as.string);
+    if (save) {
+        /* Coalesce: keep the first deadline so steady saving still writes */
+        if (PITH_IS_NIL(save->contents)) save->due = timer_now(rt) + rt->save_delay;
+        pith_value_free(save->contents);
+        save->contents = contents;
+        pith_value_free(path);
+    } else {
+        if (rt->save_count >= rt->save_capacity) {
+            rt->save_capacity = rt->save_capacity ? rt->save_capacity * 2 : 4;
+            rt->saves = realloc(rt->saves, rt->save_capacity * sizeof(PithSave));
+        }
+        save = &rt->saves[rt->save_count++];
+        save->path = pith_strdup(path.as.string);
+        save->contents = contents;
+        save->due = timer_now(rt) + rt->save_delay;
+        save->writing = false;
+        pith_value_free(path);
+    }
 
-    for (size_t i = 0; i < input->length; i++) {
-        /* Push current element onto stack */
-        pith_push(rt, pith_value_copy(input->items[i]));
+    if (rt->save_delay <= 0) saves_fire(rt, false);
+    return true;
+}
 
-        /* Execute the block */
-        pith_execute_block(rt, block);
+/* save-flush: ( -- ) writes every waiting save now and waits for them */
+static bool builtin_save_flush(PithRuntime *rt) {
+    saves_flush(rt);
+    return true;
+}
 
-        /* Collect result */
-        if (pith_stack_has(rt, 1)) {
-            pith_array_push(output, pith_pop(rt));
-        }
+/* save-delay: ( ms -- ) how long file-save waits to coalesce saves */
+static bool builtin_save_delay(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue ms = pith_pop(rt);
+    if (!PITH_IS_NUMBER(ms)) {
+        pith_error(rt, "save-delay requires milliseconds");
+        pith_value_free(ms);
+        return false;
     }
+    rt->save_delay = ms.as.number > 0 ? ms.as.number : 0;
+    return true;
+}
 
-    pith_value_free(arr_val);
-    free(block);
-
-    return pith_push(rt, PITH_ARRAY(output));
+/* save-sync: ( bool -- ) whether file writes and saves wait for the disk
+ * (fsync) before counting as done */
+static bool builtin_save_sync(PithRuntime *rt) {
+    if (!pith_stack_has(rt, 1)) return false;
+    PithValue sync = pith_pop(rt);
+    if (!PITH_IS_BOOL(sync)) {
+        pith_error(rt, "save-sync requires a bool");
+        pith_value_free(sync);
+        return false;
+    }
+    rt->save_sync = sync.as.boolean;
+    return true;
 }
 
 /* ========================================================================
@@ -4060,7 +7568,7 @@ typedef struct {
     PithBuiltinFn fn;
 } BuiltinEntry;
 
-static BuiltinEntry builtins[] = {
+static const BuiltinEntry builtins[] = {
     /* Stack */
     {"dup", builtin_dup},
     {"drop", builtin_drop},
@@ -4108,6 +7616,10 @@ static BuiltinEntry builtins[] = {
     {"lowercase", builtin_lowercase},
     {"lines", builtin_lines},
     {"words", builtin_words},
+    {"string-builder", builtin_string_builder},
+    {"sb-append", builtin_sb_append},
+    {"sb-append-line", builtin_sb_append_line},
+    {"sb-to-string", builtin_sb_to_string},
 
     /* Debug */
     {"print", builtin_print},
@@ -4127,6 +7639,9 @@ static BuiltinEntry builtins[] = {
     {"view-switch", builtin_view_switch},
     {"fill", builtin_fill},
     {"statusbar", builtin_statusbar},
+    {"syntax", builtin_syntax},
+    {"wrap", builtin_wrap},
+    {"highlight", builtin_highlight},
 
     /* Outline */
     {"outline-item", builtin_outline_item},
@@ -4155,6 +7670,11 @@ static BuiltinEntry builtins[] = {
     {"any", builtin_any},
     {"all", builtin_all},
 
+    /* Loops */
+    {"times", builtin_times},
+    {"range-each", builtin_range_each},
+    {"while", builtin_while},
+
     /* Type Checking */
     {"type", builtin_type},
     {"string?", builtin_is_string},
@@ -4192,6 +7712,26 @@ static BuiltinEntry builtins[] = {
     {"gap-cursor", builtin_gap_cursor},
     {"gap-length", builtin_gap_length},
     {"gap-char", builtin_gap_char},
+    {"gap-apply-edits", builtin_gap_apply_edits},
+    {"gap-replace-all", builtin_gap_replace_all},
+    {"gap-add-cursor", builtin_gap_add_cursor},
+    {"gap-cursors", builtin_gap_cursors},
+
+    /* Incremental search */
+    {"live-search", builtin_live_search},
+    {"search-flush", builtin_search_flush},
+
+    /* Background jobs */
+    {"spawn", builtin_spawn},
+    {"spawn-flush", builtin_spawn_flush},
+    {"pmap", builtin_pmap},
+    {"pfilter", builtin_pfilter},
+    {"preduce", builtin_preduce},
+
+    /* Timers */
+    {"after", builtin_after},
+    {"every", builtin_every},
+    {"cancel-timer", builtin_cancel_timer},
 
     /* File system */
     {"file-read", builtin_file_read},
@@ -4199,6 +7739,20 @@ static BuiltinEntry builtins[] = {
     {"file-exists", builtin_file_exists},
     {"dir-list", builtin_dir_list},
     {"file-append", builtin_file_append},
+    {"file-stat", builtin_file_stat},
+    {"file-lines", builtin_file_lines},
+    {"range", builtin_range},
+    {"lazy", builtin_lazy},
+    {"take", builtin_take},
+    {"skip", builtin_skip},
+    {"collect", builtin_collect},
+    {"file-read-async", builtin_file_read_async},
+    {"file-write-async", builtin_file_write_async},
+    {"cancel-io", builtin_cancel_io},
+    {"file-save", builtin_file_save},
+    {"save-flush", builtin_save_flush},
+    {"save-delay", builtin_save_delay},
+    {"save-sync", builtin_save_sync},
 
     /* Path-based access */
     {"set-path", builtin_set_path},
@@ -4230,16 +7784,19 @@ static PithBuiltinFn find_builtin(const char *name) {
 /* Forward declaration */
 static PithDict* pith_find_dict(PithRuntime *rt, const char *name);
 
-static int g_exec_depth = 0;
-
 bool pith_execute_word(PithRuntime *rt, const char *name) {
-    if (g_debug && g_exec_depth < 20) {
+    if (rt->debug && rt->exec_depth < 20) {
         fprintf(stderr, "[DEBUG] %*sexec word: %s (dict=%s, stack=%zu)\n",
-                g_exec_depth * 2, "", name,
+                rt->exec_depth * 2, "", name,
                 rt->current_dict ? rt->current_dict->name : "(null)",
                 rt->stack_top);
     }
-    g_exec_depth++;
+    if (rt->exec_depth >= PITH_EXEC_DEPTH_MAX) {
+        pith_error(rt, "Recursion too deep (%d calls) in '%s'", rt->exec_depth,
+                   rt->exec_slot ? rt->exec_slot : name);
+        return false;
+    }
+    rt->exec_depth++;
 
     /* Check for signal write syntax: word! */
     size_t name_len = strlen(name);
@@ -4263,19 +7820,19 @@ bool pith_execute_word(PithRuntime *rt, const char *name) {
             /* Pop value from stack and set signal */
             if (!pith_stack_has(rt, 1)) {
                 free(slot_name);
-                g_exec_depth--;
+                rt->exec_depth--;
                 pith_error(rt, "Signal write requires value on stack");
                 return false;
             }
             PithValue new_val = pith_pop(rt);
             pith_signal_set(slot->cached.as.signal, new_val);
             free(slot_name);
-            g_exec_depth--;
+            rt->exec_depth--;
             return true;
         }
 
         free(slot_name);
-        g_exec_depth--;
+        rt->exec_depth--;
         pith_error(rt, "Unknown signal: %s", name);
         return false;
     }
@@ -4284,7 +7841,7 @@ bool pith_execute_word(PithRuntime *rt, const char *name) {
     PithBuiltinFn builtin = find_builtin(name);
     if (builtin) {
         bool result = builtin(rt);
-        g_exec_depth--;
+        rt->exec_depth--;
         return result;
     }
 
@@ -4308,16 +7865,16 @@ bool pith_execute_word(PithRuntime *rt, const char *name) {
                             pith_apply_dict_styles(dict, top->as.view);
                         }
                     }
-                    g_exec_depth--;
+                    rt->exec_depth--;
                     return result;
                 } else {
                     /* No ui slot - push dictionary as value */
-                    g_exec_depth--;
+                    rt->exec_depth--;
                     return pith_push(rt, PITH_DICT(dict));
                 }
             } else {
                 bool result = pith_execute_slot(rt, slot);
-                g_exec_depth--;
+                rt->exec_depth--;
                 return result;
             }
         }
@@ -4340,21 +7897,21 @@ bool pith_execute_word(PithRuntime *rt, const char *name) {
                     pith_apply_dict_styles(dict, top->as.view);
                 }
             }
-            g_exec_depth--;
+            rt->exec_depth--;
             return result;
         } else {
             /* No ui slot - push dictionary as value */
-            g_exec_depth--;
+            rt->exec_depth--;
             return pith_push(rt, PITH_DICT(dict));
         }
     }
 
-    g_exec_depth--;
+    rt->exec_depth--;
     pith_error(rt, "Unknown word: %s", name);
     return false;
 }
 
-bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
+static bool execute_body(PithRuntime *rt, PithSlot *slot) {
     /* If slot has a cached value, push it instead of executing body */
     if (slot->is_cached) {
         /* Push the cached value directly (including signals) */
@@ -4362,8 +7919,9 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
     }
 
     /* Execute tokens from body_start to body_end */
+    PithToken *tokens = slot->unit ? slot->unit->tokens : NULL;
     for (size_t i = slot->body_start; i < slot->body_end; i++) {
-        PithToken *tok = &rt->tokens[i];
+        PithToken *tok = &tokens[i];
         
         switch (tok->type) {
             case TOK_NUMBER:
@@ -4371,7 +7929,7 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
                 break;
                 
             case TOK_STRING:
-                pith_push(rt, PITH_STRING(pith_strdup(tok->text)));
+                pith_push(rt, PITH_STRING(pith_string_dup(tok->text)));
                 break;
                 
             case TOK_TRUE:
@@ -4389,20 +7947,20 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
             case TOK_WORD:
                 /* Check for dot-access: word.slot or word.slot.nested... */
                 if (i + 2 < slot->body_end &&
-                    rt->tokens[i + 1].type == TOK_DOT &&
-                    rt->tokens[i + 2].type == TOK_WORD) {
+                    tokens[i + 1].type == TOK_DOT &&
+                    tokens[i + 2].type == TOK_WORD) {
 
                     /* Collect all parts of the dot chain */
                     size_t chain_start = i;
                     size_t chain_end = i;
                     while (chain_end + 2 < slot->body_end &&
-                           rt->tokens[chain_end + 1].type == TOK_DOT &&
-                           rt->tokens[chain_end + 2].type == TOK_WORD) {
+                           tokens[chain_end + 1].type == TOK_DOT &&
+                           tokens[chain_end + 2].type == TOK_WORD) {
                         chain_end += 2;
                     }
 
                     /* First part is a dictionary name */
-                    const char *dict_name = rt->tokens[chain_start].text;
+                    const char *dict_name = tokens[chain_start].text;
                     PithDict *current = pith_find_dict(rt, dict_name);
                     if (!current) {
                         pith_error(rt, "Unknown dictionary: %s", dict_name);
@@ -4411,7 +7969,7 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
 
                     /* Traverse intermediate parts (all but the last) */
                     for (size_t j = chain_start + 2; j < chain_end; j += 2) {
-                        const char *part_name = rt->tokens[j].text;
+                        const char *part_name = tokens[j].text;
                         PithSlot *part_slot = pith_dict_lookup(current, part_name);
                         if (!part_slot) {
                             pith_error(rt, "Unknown slot '%s' in path", part_name);
@@ -4443,7 +8001,7 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
                     }
 
                     /* Get the final slot name */
-                    const char *final_name = rt->tokens[chain_end].text;
+                    const char *final_name = tokens[chain_end].text;
                     size_t final_len = strlen(final_name);
 
                     /* Check if this is a signal write (ends with !) */
@@ -4525,7 +8083,7 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
                 int depth = 1;
 
                 for (size_t j = if_body_start; j < slot->body_end; j++) {
-                    PithTokenType t = rt->tokens[j].type;
+                    PithTokenType t = tokens[j].type;
                     if (t == TOK_IF || t == TOK_DO) {
                         depth++;
                     } else if (t == TOK_ELSE && depth == 1) {
@@ -4544,6 +8102,7 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
                     size_t body_end = else_pos > 0 ? else_pos : end_pos;
                     PithSlot if_slot = {
                         .name = NULL,
+                        .unit = slot->unit,
                         .body_start = if_body_start,
                         .body_end = body_end,
                         .is_cached = false
@@ -4555,6 +8114,7 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
                     /* Execute the 'else' body */
                     PithSlot else_slot = {
                         .name = NULL,
+                        .unit = slot->unit,
                         .body_start = else_pos + 1,
                         .body_end = end_pos,
                         .is_cached = false
@@ -4571,13 +8131,14 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
             case TOK_DO: {
                 /* Create a block from here to matching end */
                 PithBlock *block = malloc(sizeof(PithBlock));
+                block->unit = slot->unit;
                 block->start = i + 1;
                 /* Find matching end */
                 int depth = 1;
                 size_t j = i + 1;
                 while (j < slot->body_end && depth > 0) {
-                    if (rt->tokens[j].type == TOK_DO) depth++;
-                    if (rt->tokens[j].type == TOK_END) depth--;
+                    if (tokens[j].type == TOK_DO || tokens[j].type == TOK_IF) depth++;
+                    if (tokens[j].type == TOK_END) depth--;
                     j++;
                 }
                 block->end = j - 1;
@@ -4596,8 +8157,8 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
                 size_t arr_end = arr_start;
                 int bracket_depth = 1;
                 for (size_t j = arr_start; j < slot->body_end; j++) {
-                    if (rt->tokens[j].type == TOK_LBRACKET) bracket_depth++;
-                    else if (rt->tokens[j].type == TOK_RBRACKET) {
+                    if (tokens[j].type == TOK_LBRACKET) bracket_depth++;
+                    else if (tokens[j].type == TOK_RBRACKET) {
                         bracket_depth--;
                         if (bracket_depth == 0) {
                             arr_end = j;
@@ -4609,27 +8170,15 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
                 /* Execute the code inside the array */
                 PithSlot arr_slot = {
                     .name = NULL,
+                    .unit = slot->unit,
                     .body_start = arr_start,
                     .body_end = arr_end,
                     .is_cached = false
                 };
                 pith_execute_slot(rt, &arr_slot);
 
-                /* Collect everything pushed onto stack into an array */
-                size_t num_items = rt->stack_top - stack_before;
-                PithArray *arr = pith_array_new();
-
-                /* Items are in reverse order on stack, so collect them properly */
-                if (num_items > 0) {
-                    PithValue *temp = malloc(num_items * sizeof(PithValue));
-                    for (size_t j = 0; j < num_items; j++) {
-                        temp[num_items - 1 - j] = pith_pop(rt);
-                    }
-                    for (size_t j = 0; j < num_items; j++) {
-                        pith_array_push(arr, temp[j]);
-                    }
-                    free(temp);
-                }
+                /* Everything pushed inside [...] becomes the array */
+                PithArray *arr = stack_take_array(rt, stack_before);
 
                 pith_push(rt, PITH_ARRAY(arr));
                 i = arr_end; /* Skip to ] (loop will increment past it) */
@@ -4646,9 +8195,44 @@ bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
     return true;
 }
 
+bool pith_execute_slot(PithRuntime *rt, PithSlot *slot) {
+    /* Unnamed slots (if/else branches, array bodies, blocks) count
+     * toward the named slot they run in */
+    if (!slot->name || slot->is_cached) {
+        return execute_body(rt, slot);
+    }
+
+    const char *saved_slot = rt->exec_slot;
+    rt->exec_slot = slot->name;
+    if (!rt->stack_profile) {
+        bool result = execute_body(rt, slot);
+        rt->exec_slot = saved_slot;
+        return result;
+    }
+
+    /* Measure this slot's peak from its entry depth, then fold it back
+     * into the caller's peak */
+    size_t base = rt->stack_top;
+    size_t saved_peak = rt->stack_peak;
+    rt->stack_peak = base;
+    stack_update_limit(rt);
+
+    bool result = execute_body(rt, slot);
+
+    slot->calls++;
+    if (rt->stack_peak - base > slot->stack_high) {
+        slot->stack_high = rt->stack_peak - base;
+    }
+    if (saved_peak > rt->stack_peak) rt->stack_peak = saved_peak;
+    stack_update_limit(rt);
+    rt->exec_slot = saved_slot;
+    return result;
+}
+
 bool pith_execute_block(PithRuntime *rt, PithBlock *block) {
     PithSlot temp = {
         .name = NULL,
+        .unit = block->unit,
         .body_start = block->start,
         .body_end = block->end,
         .is_cached = false
@@ -4665,8 +8249,16 @@ PithRuntime* pith_runtime_new(PithFileSystem fs) {
     memset(rt, 0, sizeof(PithRuntime));
     
     rt->fs = fs;
+    rt->disk_cache = true;
+    rt->save_sync = true;
+    rt->out = stdout;
+    rt->stack_capacity = PITH_STACK_INITIAL;
+    rt->stack = malloc(rt->stack_capacity * sizeof(PithValue));
+    rt->stack_limit = rt->stack_capacity;
     rt->root = pith_dict_new("root");
     rt->current_dict = rt->root;
+    rt->timer_epoch = pith_clock_ms();
+    rt->timer_next_due = -1;
     
     register_builtins(rt);
     
@@ -4675,22 +8267,32 @@ PithRuntime* pith_runtime_new(PithFileSystem fs) {
 
 void pith_runtime_free(PithRuntime *rt) {
     if (!rt) return;
+
+    /* Saves still waiting are written before anything else goes */
+    saves_flush(rt);
+    free(rt->saves);
+
+    /* Workers borrow this runtime's units, so stop them first */
+    worker_pool_free(rt->workers);
     
     /* Free stack values */
     for (size_t i = 0; i < rt->stack_top; i++) {
         pith_value_free(rt->stack[i]);
     }
+    free(rt->stack);
     
-    /* Free tokens */
-    for (size_t i = 0; i < rt->token_count; i++) {
-        free(rt->tokens[i].text);
+    /* Free compilation units */
+    for (size_t i = 0; i < rt->unit_count; i++) {
+        pith_unit_free(rt->units[i]);
     }
+    free(rt->units);
     
     /* Free root dictionary (dictionaries are now slots with cached VAL_DICT values) */
     pith_dict_free(rt->root);
     
     /* Free project path */
     free(rt->project_path);
+    free(rt->cache_dir);
     
     /* Free current view */
     pith_view_free(rt->current_view);
@@ -4698,9 +8300,49 @@ void pith_runtime_free(PithRuntime *rt) {
     /* Free signals (the actual signals are freed when their containing slots are freed) */
     free(rt->all_signals);
 
+    /* Free live searches */
+    for (size_t i = 0; i < rt->search_count; i++) {
+        search_free(rt->searches[i]);
+    }
+    free(rt->searches);
+
+    timers_free(rt);
+
     free(rt);
 }
 
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* The .pith files of a project directory: runtime.pith first, then the
+ * rest sorted by path so every load merges them in the same order */
+static char** pith_project_sources(PithRuntime *rt, const char *dir,
+                                   const char *runtime_path, size_t *count) {
+    size_t entry_count = 0;
+    char **entries = NULL;
+    if (rt->fs.list_dir) {
+        entries = rt->fs.list_dir(dir, &entry_count, rt->fs.userdata);
+    }
+
+    char **files = malloc((entry_count + 1) * sizeof(char*));
+    files[0] = pith_strdup(runtime_path);
+    *count = 1;
+    for (size_t i = 0; i < entry_count; i++) {
+        size_t len = strlen(entries[i]);
+        if (len > 5 && strcmp(entries[i] + len - 5, ".pith") == 0 &&
+            strcmp(entries[i], runtime_path) != 0) {
+            files[(*count)++] = entries[i];
+        } else {
+            free(entries[i]);
+        }
+    }
+    free(entries);
+
+    qsort(files + 1, *count - 1, sizeof(char*), compare_paths);
+    return files;
+}
+
 bool pith_runtime_load_project(PithRuntime *rt, const char *path) {
     /* Check if path is a .pith file (direct file execution) */
     size_t len = strlen(path);
@@ -4724,11 +8366,29 @@ bool pith_runtime_load_project(PithRuntime *rt, const char *path) {
     rt->project_path = pith_strdup(path);
 
     /* Look for pith/runtime.pith */
-    char runtime_path[512];
-    snprintf(runtime_path, sizeof(runtime_path), "%s/pith/runtime.pith", path);
+    char runtime_path[PATH_MAX];
+    char pith_dir[PATH_MAX];
+    if (snprintf(runtime_path, sizeof(runtime_path), "%s/pith/runtime.pith", path) >= PATH_MAX ||
+        snprintf(pith_dir, sizeof(pith_dir), "%s/pith", path) >= PATH_MAX) {
+        pith_error(rt, "Project path too long: %s", path);
+        return false;
+    }
 
     if (rt->fs.file_exists(runtime_path, rt->fs.userdata)) {
-        return pith_runtime_load_file(rt, runtime_path);
+        /* Token caches live in pith/.cache (skipped if it can't be made) */
+        char cache_dir[PATH_MAX];
+        bool fits = snprintf(cache_dir, sizeof(cache_dir), "%s/.cache", pith_dir) < PATH_MAX;
+        if (fits && rt->disk_cache && (mkdir(cache_dir, 0755) == 0 || errno == EEXIST)) {
+            free(rt->cache_dir);
+            rt->cache_dir = pith_strdup(cache_dir);
+        }
+
+        size_t count;
+        char **files = pith_project_sources(rt, pith_dir, runtime_path, &count);
+        bool result = pith_runtime_load_files(rt, (const char **)files, count);
+        for (size_t i = 0; i < count; i++) free(files[i]);
+        free(files);
+        return result;
     }
 
     /* Create default runtime.pith */
@@ -4746,16 +8406,15 @@ bool pith_runtime_load_project(PithRuntime *rt, const char *path) {
         "    app\n"
         "end\n";
 
-    /* Ensure directory exists and write default */
-    char pith_dir[512];
-    snprintf(pith_dir, sizeof(pith_dir), "%s/pith", path);
-    rt->fs.write_file(runtime_path, default_runtime, rt->fs.userdata);
+    /* Write the default */
+    rt->fs.write_file(runtime_path, default_runtime, strlen(default_runtime),
+                      PITH_WRITE_SYNC, rt->fs.userdata);
 
     return pith_runtime_load_string(rt, default_runtime, "runtime.pith");
 }
 
 bool pith_runtime_load_file(PithRuntime *rt, const char *path) {
-    char *source = rt->fs.read_file(path, rt->fs.userdata);
+    char *source = rt->fs.read_file(path, NULL, rt->fs.userdata);
     if (!source) {
         pith_error(rt, "Could not read file: %s", path);
         return false;
@@ -4780,42 +8439,45 @@ static PithDict* pith_find_dict(PithRuntime *rt, const char *name) {
     return NULL;
 }
 
-/* Add a dictionary as a slot in the root dictionary */
-static bool pith_add_dict_slot(PithRuntime *rt, PithDict *dict, size_t body_start, size_t body_end) {
-    if (rt->root->slot_count >= rt->root->slot_capacity) {
-        rt->root->slot_capacity = rt->root->slot_capacity ? rt->root->slot_capacity * 2 : 8;
-        rt->root->slots = realloc(rt->root->slots, rt->root->slot_capacity * sizeof(PithSlot));
+/* Add a dictionary as a slot in a root dictionary */
+static bool pith_add_dict_slot(PithDict *root, PithDict *dict, PithUnit *unit,
+                               size_t body_start, size_t body_end) {
+    if (root->slot_count >= root->slot_capacity) {
+        root->slot_capacity = root->slot_capacity ? root->slot_capacity * 2 : 8;
+        root->slots = realloc(root->slots, root->slot_capacity * sizeof(PithSlot));
     }
 
-    PithSlot *slot = &rt->root->slots[rt->root->slot_count++];
+    PithSlot *slot = &root->slots[root->slot_count++];
     slot->name = pith_strdup(dict->name);
+    slot->unit = unit;
     slot->body_start = body_start;
     slot->body_end = body_end;
     slot->is_cached = true;
     slot->cached = PITH_DICT(dict);
+    slot->calls = 0;
+    slot->stack_high = 0;
 
     return true;
 }
 
-bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *name) {
-    (void)name;
-
-    if (!pith_parse(rt, source)) {
-        return false;
-    }
+/* Scan a lexed unit's top-level blocks into the build's staging root */
+static bool unit_scan(UnitBuild *b) {
+    PithUnit *unit = b->unit;
+    PithToken *tokens = unit->tokens;
+    size_t token_count = unit->token_count;
 
     /* Parse dictionaries from token stream */
     size_t i = 0;
-    while (i < rt->token_count) {
-        PithToken *tok = &rt->tokens[i];
+    while (i < token_count) {
+        PithToken *tok = &tokens[i];
 
         /* Skip EOF */
         if (tok->type == TOK_EOF) break;
 
         /* Look for WORD COLON at top level - could be dictionary or root slot */
         if (tok->type == TOK_WORD &&
-            i + 1 < rt->token_count &&
-            rt->tokens[i + 1].type == TOK_COLON) {
+            i + 1 < token_count &&
+            tokens[i + 1].type == TOK_COLON) {
 
             char *block_name = tok->text;
             size_t block_start = i + 2; /* After name and colon */
@@ -4827,27 +8489,27 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
             int depth = 1;
             bool slot_open[64] = {false}; /* slot_open[d] = true if there's a multi-line slot at depth d */
 
-            for (size_t j = block_start; j < rt->token_count; j++) {
-                PithTokenType t = rt->tokens[j].type;
+            for (size_t j = block_start; j < token_count; j++) {
+                PithTokenType t = tokens[j].type;
                 if (t == TOK_DO || t == TOK_IF) {
                     depth++;
                 } else if (t == TOK_WORD &&
-                           j + 1 < rt->token_count &&
-                           rt->tokens[j + 1].type == TOK_COLON) {
+                           j + 1 < token_count &&
+                           tokens[j + 1].type == TOK_COLON) {
                     /* WORD COLON - check if this is a multi-line slot */
                     /* A slot is multi-line if its body contains tokens on different lines */
-                    size_t slot_line = rt->tokens[j].line;
+                    size_t slot_line = tokens[j].line;
                     bool is_multiline = false;
 
                     /* Look ahead to see if slot body spans multiple lines */
-                    for (size_t k = j + 2; k < rt->token_count; k++) {
-                        PithTokenType tk = rt->tokens[k].type;
+                    for (size_t k = j + 2; k < token_count; k++) {
+                        PithTokenType tk = tokens[k].type;
                         /* Stop at END or next WORD COLON */
                         if (tk == TOK_END) break;
-                        if (tk == TOK_WORD && k + 1 < rt->token_count &&
-                            rt->tokens[k + 1].type == TOK_COLON) break;
+                        if (tk == TOK_WORD && k + 1 < token_count &&
+                            tokens[k + 1].type == TOK_COLON) break;
                         /* If any token is on a different line, slot is multi-line */
-                        if (rt->tokens[k].line > slot_line) {
+                        if (tokens[k].line > slot_line) {
                             is_multiline = true;
                             break;
                         }
@@ -4870,7 +8532,7 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
                         }
                     }
                 } else if (t == TOK_EOF) {
-                    pith_error(rt, "Unexpected end of file in block '%s'", block_name);
+                    build_error(b, "Unexpected end of file in block '%s'", block_name);
                     return false;
                 }
             }
@@ -4879,16 +8541,16 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
             /* If first token is WORD and second is COLON, it's a dictionary */
             bool is_dictionary = false;
             if (block_start < block_end &&
-                rt->tokens[block_start].type == TOK_WORD &&
+                tokens[block_start].type == TOK_WORD &&
                 block_start + 1 < block_end &&
-                rt->tokens[block_start + 1].type == TOK_COLON) {
+                tokens[block_start + 1].type == TOK_COLON) {
                 is_dictionary = true;
             }
 
             if (is_dictionary) {
                 /* Create new dictionary and add as slot in root */
                 PithDict *dict = pith_dict_new(block_name);
-                if (!pith_add_dict_slot(rt, dict, block_start, block_end)) {
+                if (!pith_add_dict_slot(b->root, dict, unit, block_start, block_end)) {
                     pith_dict_free(dict);
                     return false;
                 }
@@ -4896,12 +8558,12 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
                 /* Parse slots within [block_start, block_end) */
                 i = block_start;
                 while (i < block_end) {
-                    tok = &rt->tokens[i];
+                    tok = &tokens[i];
 
                     /* Slot definition: WORD COLON */
                     if (tok->type == TOK_WORD &&
                         i + 1 < block_end &&
-                        rt->tokens[i + 1].type == TOK_COLON) {
+                        tokens[i + 1].type == TOK_COLON) {
 
                         char *slot_name = tok->text;
                         i += 2; /* Skip name and colon */
@@ -4911,7 +8573,7 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
                         int slot_depth = 0;
 
                         while (i < block_end) {
-                            PithTokenType t = rt->tokens[i].type;
+                            PithTokenType t = tokens[i].type;
 
                             /* Track nesting for do...end, if...end blocks */
                             if (t == TOK_DO || t == TOK_IF) {
@@ -4925,7 +8587,7 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
                                 }
                             } else if (slot_depth == 0 && t == TOK_WORD &&
                                        i + 1 < block_end &&
-                                       rt->tokens[i + 1].type == TOK_COLON) {
+                                       tokens[i + 1].type == TOK_COLON) {
                                 /* Next slot starts - this slot has implicit end */
                                 break;
                             }
@@ -4935,12 +8597,12 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
                         size_t body_end = i;
 
                         /* Skip the slot's 'end' if present (but not dict's end) */
-                        if (i < block_end && rt->tokens[i].type == TOK_END) {
+                        if (i < block_end && tokens[i].type == TOK_END) {
                             i++;
                         }
 
                         /* Add the slot */
-                        pith_dict_add_slot(dict, slot_name, body_start, body_end);
+                        pith_dict_add_slot(dict, slot_name, unit, body_start, body_end);
                     } else {
                         /* Skip unexpected token */
                         i++;
@@ -4948,7 +8610,7 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
                 }
             } else {
                 /* This is a slot for the root dictionary */
-                pith_dict_add_slot(rt->root, block_name, block_start, block_end);
+                pith_dict_add_slot(b->root, block_name, unit, block_start, block_end);
             }
 
             /* Move past the block's closing 'end' */
@@ -4959,6 +8621,51 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
         }
     }
 
+    return true;
+}
+
+/* Lex a source and scan it */
+static bool unit_build(UnitBuild *b, const char *source) {
+    return pith_parse(b, source) && unit_scan(b);
+}
+
+/* Report a top-level name that a different file already defines.
+ * Files share one root, so a second definition would otherwise be
+ * shadowed without a word. */
+static bool pith_check_names(PithRuntime *rt, PithDict *fresh, const char *path) {
+    for (size_t i = 0; i < fresh->slot_count; i++) {
+        const char *name = fresh->slots[i].name;
+        for (size_t j = 0; j < rt->root->slot_count; j++) {
+            PithSlot *live = &rt->root->slots[j];
+            if (strcmp(live->name, name) != 0) continue;
+            if (live->unit && strcmp(live->unit->name, path) == 0) continue;
+            pith_error(rt, "%s: '%s' is already defined in %s", path, name,
+                       live->unit ? live->unit->name : "the runtime");
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Move a build's top-level slots into the runtime root */
+static void pith_merge_build(PithRuntime *rt, UnitBuild *b) {
+    PithDict *root = rt->root;
+    for (size_t i = 0; i < b->root->slot_count; i++) {
+        if (root->slot_count >= root->slot_capacity) {
+            root->slot_capacity = root->slot_capacity ? root->slot_capacity * 2 : 8;
+            root->slots = realloc(root->slots, root->slot_capacity * sizeof(PithSlot));
+        }
+        root->slots[root->slot_count++] = b->root->slots[i];
+    }
+    b->root->slot_count = 0;
+    pith_dict_free(b->root);
+    b->root = NULL;
+    b->unit->merged = true;
+    rt->program_version++;
+}
+
+/* Resolve parents and cache literal slots across the whole root */
+static void pith_link_root(PithRuntime *rt) {
     /* Second pass: resolve parent references for all dictionaries stored as slots */
     for (size_t d = 0; d < rt->root->slot_count; d++) {
         PithSlot *dict_slot = &rt->root->slots[d];
@@ -4978,7 +8685,7 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
         }
 
         if (parent_slot && parent_slot->body_start < parent_slot->body_end) {
-            PithToken *parent_tok = &rt->tokens[parent_slot->body_start];
+            PithToken *parent_tok = &parent_slot->unit->tokens[parent_slot->body_start];
             if (parent_tok->type == TOK_WORD) {
                 PithDict *parent = pith_find_dict(rt, parent_tok->text);
                 if (parent) {
@@ -5002,11 +8709,11 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
 
             /* Check if slot body is a single token */
             if (slot->body_end - slot->body_start == 1) {
-                PithToken *tok = &rt->tokens[slot->body_start];
+                PithToken *tok = &slot->unit->tokens[slot->body_start];
                 switch (tok->type) {
                     case TOK_STRING:
                         slot->is_cached = true;
-                        slot->cached = PITH_STRING(pith_strdup(tok->text));
+                        slot->cached = PITH_STRING(pith_string_dup(tok->text));
                         break;
                     case TOK_NUMBER:
                         slot->is_cached = true;
@@ -5032,14 +8739,14 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
 
             /* Check for signal initialization pattern: <value> signal */
             if (slot->body_end - slot->body_start == 2) {
-                PithToken *tok1 = &rt->tokens[slot->body_start];
-                PithToken *tok2 = &rt->tokens[slot->body_start + 1];
+                PithToken *tok1 = &slot->unit->tokens[slot->body_start];
+                PithToken *tok2 = &slot->unit->tokens[slot->body_start + 1];
                 if (tok2->type == TOK_WORD && strcmp(tok2->text, "signal") == 0) {
                     PithValue initial = PITH_NIL();
                     bool valid = false;
                     switch (tok1->type) {
                         case TOK_STRING:
-                            initial = PITH_STRING(pith_strdup(tok1->text));
+                            initial = PITH_STRING(pith_string_dup(tok1->text));
                             valid = true;
                             break;
                         case TOK_NUMBER:
@@ -5073,7 +8780,281 @@ bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *n
 
     /* Set current dictionary to the file-level root */
     rt->current_dict = rt->root;
+}
+
+/* Merge finished builds in order. On error (including a name another
+ * file already defines) nothing after the failing build is merged and
+ * the first error (in build order) is reported. */
+static bool pith_finish_builds(PithRuntime *rt, UnitBuild *builds, size_t count) {
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        if (ok && builds[i].has_error) {
+            if (builds[i].path) {
+                pith_error(rt, "%s: %s", builds[i].path, builds[i].error);
+            } else {
+                pith_error(rt, "%s", builds[i].error);
+            }
+            ok = false;
+        }
+        if (ok && !pith_check_names(rt, builds[i].root, builds[i].unit->name)) {
+            ok = false;
+        }
+        if (ok) {
+            pith_merge_build(rt, &builds[i]);
+        } else {
+            pith_dict_free(builds[i].root);
+        }
+    }
+    if (ok) pith_link_root(rt);
+    return ok;
+}
+
+bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *name) {
+    UnitBuild build = {
+        .unit = pith_unit_new(rt, name),
+        .root = pith_dict_new("root"),
+    };
+    unit_build(&build, source);
+    return pith_finish_builds(rt, &build, 1);
+}
+
+/* Shared by the loader threads: each takes the next unbuilt file */
+typedef struct {
+    PithFileSystem *fs;
+    const char *cache_dir;
+    UnitBuild *builds;
+    size_t count;
+    atomic_size_t next;
+} BuildQueue;
+
+/* Build from the cache when it matches the source, else lex and refresh it */
+static void unit_build_cached(UnitBuild *b, const char *source, const char *cache_dir) {
+    if (!cache_dir) {
+        unit_build(b, source);
+        return;
+    }
+
+    const char *base = strrchr(b->path, '/');
+    base = base ? base + 1 : b->path;
+    char cache_path[PATH_MAX];
+    if (snprintf(cache_path, sizeof(cache_path), "%s/%s.tokens", cache_dir, base) >= PATH_MAX) {
+        unit_build(b, source);
+        return;
+    }
+
+    size_t len = strlen(source);
+    if (pith_cache_load(cache_path, source, len, b->unit)) {
+        unit_scan(b);
+    } else if (unit_build(b, source)) {
+        pith_cache_store(cache_path, source, len, b->unit);
+    }
+}
+
+static void* build_worker(void *arg) {
+    BuildQueue *queue = arg;
+    size_t i;
+    while ((i = atomic_fetch_add(&queue->next, 1)) < queue->count) {
+        UnitBuild *b = &queue->builds[i];
+        char *source = queue->fs->read_file(b->path, NULL, queue->fs->userdata);
+        if (!source) {
+            build_error(b, "Could not read file");
+            continue;
+        }
+        unit_build_cached(b, source, queue->cache_dir);
+        free(source);
+    }
+    return NULL;
+}
+
+static size_t pith_cpu_count(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) return (size_t)n;
+#endif
+    return 1;
+}
+
+bool pith_runtime_load_files(PithRuntime *rt, const char **paths, size_t count) {
+    if (count == 0) return true;
+
+    /* Units are created up front so their order follows the file order */
+    UnitBuild *builds = calloc(count, sizeof(UnitBuild));
+    for (size_t i = 0; i < count; i++) {
+        builds[i].unit = pith_unit_new(rt, paths[i]);
+        builds[i].root = pith_dict_new("root");
+        builds[i].path = paths[i];
+    }
+
+    BuildQueue queue = {
+        .fs = &rt->fs, .cache_dir = rt->cache_dir, .builds = builds, .count = count
+    };
+    atomic_init(&queue.next, 0);
+
+    size_t thread_count = pith_cpu_count();
+    if (thread_count > PITH_LOAD_THREADS) thread_count = PITH_LOAD_THREADS;
+    if (thread_count > count) thread_count = count;
+
+    /* The calling thread is one of the workers */
+    pthread_t threads[PITH_LOAD_THREADS];
+    size_t started = 0;
+    for (size_t i = 1; i < thread_count; i++) {
+        if (pthread_create(&threads[started], NULL, build_worker, &queue) != 0) break;
+        started++;
+    }
+    build_worker(&queue);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    bool result = pith_finish_builds(rt, builds, count);
+    free(builds);
+    return result;
+}
+
+/* ========================================================================
+   HOT RELOAD
+   A changed file is built into a new unit, then its definitions are
+   swapped into the live dictionaries in place. Dictionaries keep their
+   identity (views and parent links stay valid) and signal slots keep
+   their values. Old units stay loaded: blocks held by views, signals or
+   stack values may still point into them.
+   ======================================================================== */
+
+/* Most recent unit built from a path */
+static PithUnit* pith_find_unit(PithRuntime *rt, const char *path) {
+    for (size_t i = rt->unit_count; i-- > 0; ) {
+        if (strcmp(rt->units[i]->name, path) == 0) return rt->units[i];
+    }
+    return NULL;
+}
+
+static PithSlot* dict_find_local(PithDict *dict, const char *name) {
+    for (size_t i = 0; i < dict->slot_count; i++) {
+        if (strcmp(dict->slots[i].name, name) == 0) return &dict->slots[i];
+    }
+    return NULL;
+}
+
+static bool slot_is_signal(PithSlot *slot) {
+    return slot->is_cached && slot->cached.type == VAL_SIGNAL;
+}
+
+static bool slot_is_dict(PithSlot *slot) {
+    return slot->is_cached && slot->cached.type == VAL_DICT;
+}
+
+/* Body ends in `signal` (an initializer for a signal slot) */
+static bool slot_makes_signal(PithSlot *slot) {
+    if (slot->body_end == slot->body_start) return false;
+    PithToken *last = &slot->unit->tokens[slot->body_end - 1];
+    return last->type == TOK_WORD && strcmp(last->text, "signal") == 0;
+}
+
+/* Give a live slot a freshly parsed body */
+static void reload_slot(PithSlot *live, PithSlot *fresh) {
+    if (slot_is_signal(live) && slot_makes_signal(fresh)) return;
+    if (live->is_cached && !slot_is_signal(live)) pith_value_free(live->cached);
+    live->is_cached = false;
+    live->unit = fresh->unit;
+    live->body_start = fresh->body_start;
+    live->body_end = fresh->body_end;
+}
+
+/* Swap a reparsed dictionary's slots into the live one */
+static void reload_dict(PithDict *live, PithDict *fresh, PithUnit *old_unit) {
+    /* Drop slots the file no longer defines (signals stay: views hold them) */
+    for (size_t i = live->slot_count; i-- > 0; ) {
+        PithSlot *slot = &live->slots[i];
+        if (slot->unit == old_unit && !slot_is_signal(slot) &&
+            !dict_find_local(fresh, slot->name)) {
+            pith_dict_remove_slot(live, slot->name);
+        }
+    }
+
+    for (size_t i = 0; i < fresh->slot_count; i++) {
+        PithSlot *f = &fresh->slots[i];
+        PithSlot *slot = dict_find_local(live, f->name);
+        if (slot) {
+            reload_slot(slot, f);
+        } else {
+            pith_dict_add_slot(live, f->name, f->unit, f->body_start, f->body_end);
+        }
+    }
+
+    /* Re-resolved from the new parent slot when linking */
+    live->parent = NULL;
+}
+
+static void reload_root(PithRuntime *rt, PithDict *fresh, PithUnit *old_unit) {
+    PithDict *root = rt->root;
+
+    if (old_unit) {
+        for (size_t i = root->slot_count; i-- > 0; ) {
+            PithSlot *slot = &root->slots[i];
+            if (slot->unit == old_unit && !slot_is_signal(slot) && !slot_is_dict(slot) &&
+                !dict_find_local(fresh, slot->name)) {
+                pith_dict_remove_slot(root, slot->name);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < fresh->slot_count; i++) {
+        PithSlot *f = &fresh->slots[i];
+        PithSlot *live = dict_find_local(root, f->name);
+
+        if (slot_is_dict(f)) {
+            if (live && slot_is_dict(live)) {
+                reload_dict(live->cached.as.dict, f->cached.as.dict, old_unit);
+                live->unit = f->unit;
+                live->body_start = f->body_start;
+                live->body_end = f->body_end;
+            } else if (!live) {
+                /* New dictionary: move it into the root */
+                pith_add_dict_slot(root, f->cached.as.dict, f->unit, f->body_start, f->body_end);
+                f->is_cached = false;
+            }
+        } else if (live && !slot_is_dict(live)) {
+            reload_slot(live, f);
+        } else if (!live) {
+            pith_dict_add_slot(root, f->name, f->unit, f->body_start, f->body_end);
+        }
+    }
+}
+
+bool pith_runtime_reload_file(PithRuntime *rt, const char *path) {
+    PithUnit *old_unit = pith_find_unit(rt, path);
 
+    char *source = rt->fs.read_file(path, NULL, rt->fs.userdata);
+    if (!source) {
+        pith_error(rt, "Could not read file: %s", path);
+        return false;
+    }
+
+    UnitBuild build = {
+        .unit = pith_unit_new(rt, path),
+        .root = pith_dict_new("root"),
+        .path = path,
+    };
+    unit_build_cached(&build, source, rt->cache_dir);
+    free(source);
+
+    if (build.has_error) {
+        pith_error(rt, "%s: %s", path, build.error);
+    }
+    if (build.has_error || !pith_check_names(rt, build.root, path)) {
+        pith_dict_free(build.root);
+        pith_unit_free(rt->units[--rt->unit_count]);
+        return false;
+    }
+
+    reload_root(rt, build.root, old_unit);
+    pith_dict_free(build.root);
+    pith_link_root(rt);
+    build.unit->merged = true;
+    rt->program_version++;
+
+    /* One rebuild of the view tree picks up every reloaded file */
+    rt->view_stale = true;
     return true;
 }
 
@@ -5084,7 +9065,7 @@ bool pith_runtime_run_slot(PithRuntime *rt, const char *name) {
         return false; /* Slot doesn't exist - not an error */
     }
 
-    if (g_debug) {
+    if (rt->debug) {
         fprintf(stderr, "[DEBUG] Executing '%s' slot: tokens %zu-%zu\n",
                 name, slot->body_start, slot->body_end);
     }
@@ -5099,7 +9080,7 @@ bool pith_runtime_mount_ui(PithRuntime *rt) {
         return false; /* No ui slot */
     }
 
-    if (g_debug) {
+    if (rt->debug) {
         fprintf(stderr, "[DEBUG] Executing 'ui' slot: tokens %zu-%zu\n",
                 ui_slot->body_start, ui_slot->body_end);
     }
@@ -5120,7 +9101,7 @@ bool pith_runtime_mount_ui(PithRuntime *rt) {
         PithValue v = pith_peek(rt);
         if (PITH_IS_VIEW(v)) {
             rt->current_view = pith_pop(rt).as.view;
-            if (g_debug) {
+            if (rt->debug) {
                 fprintf(stderr, "[DEBUG] Root view set from ui slot\n");
             }
             return true;
@@ -5147,8 +9128,13 @@ void pith_runtime_handle_event(PithRuntime *rt, PithEvent event) {
             
         case EVENT_FILE_CHANGE:
             handler_name = "on-file-change";
-            pith_push(rt, PITH_STRING(pith_strdup(event.as.file_change.path)));
+            pith_push(rt, PITH_STRING(pith_string_dup(event.as.file_change.path)));
             break;
+
+        case EVENT_TICK:
+            timers_fire(rt);
+            saves_fire(rt, false);
+            return;
             
         default:
             return;
@@ -5198,7 +9184,9 @@ static const char* token_type_name(PithTokenType t) {
 void pith_debug_print_state(PithRuntime *rt) {
     fprintf(stderr, "\n=== PITH DEBUG STATE ===\n\n");
 
-    fprintf(stderr, "Token count: %zu\n", rt->token_count);
+    for (size_t u = 0; u < rt->unit_count; u++) {
+        fprintf(stderr, "Unit %s: %zu tokens\n", rt->units[u]->name, rt->units[u]->token_count);
+    }
     fprintf(stderr, "Root slot count: %zu\n", rt->root->slot_count);
     fprintf(stderr, "Current dict: %s\n", rt->current_dict ? rt->current_dict->name : "(null)");
 
@@ -5224,7 +9212,7 @@ void pith_debug_print_state(PithRuntime *rt) {
                 fprintf(stderr, " = ");
                 size_t max_tokens = 5;
                 for (size_t t = slot->body_start; t < slot->body_end && t < slot->body_start + max_tokens; t++) {
-                    PithToken *tok = &rt->tokens[t];
+                    PithToken *tok = &slot->unit->tokens[t];
                     if (tok->text) {
                         fprintf(stderr, "%s ", tok->text);
                     } else {
@@ -5242,7 +9230,7 @@ void pith_debug_print_state(PithRuntime *rt) {
             fprintf(stderr, " = ");
             size_t max_tokens = 5;
             for (size_t t = root_slot->body_start; t < root_slot->body_end && t < root_slot->body_start + max_tokens; t++) {
-                PithToken *tok = &rt->tokens[t];
+                PithToken *tok = &root_slot->unit->tokens[t];
                 if (tok->text) {
                     fprintf(stderr, "%s ", tok->text);
                 } else {
@@ -5263,7 +9251,7 @@ void pith_debug_print_state(PithRuntime *rt) {
             fprintf(stderr, "Found 'ui' slot: tokens %zu-%zu\n", ui_slot->body_start, ui_slot->body_end);
             fprintf(stderr, "UI slot body tokens:\n");
             for (size_t t = ui_slot->body_start; t < ui_slot->body_end; t++) {
-                PithToken *tok = &rt->tokens[t];
+                PithToken *tok = &ui_slot->unit->tokens[t];
                 fprintf(stderr, "  [%zu] %s", t, token_type_name(tok->type));
                 if (tok->text) {
                     fprintf(stderr, " \"%s\"", tok->text);
@@ -5323,3 +9311,49 @@ void pith_debug_print_view(PithView *view, int indent) {
         }
     }
 }
+
+typedef struct {
+    const char *dict;
+    PithSlot *slot;
+} StackStat;
+
+static int compare_stack_stats(const void *a, const void *b) {
+    const StackStat *x = a, *y = b;
+    if (x->slot->stack_high != y->slot->stack_high) {
+        return x->slot->stack_high < y->slot->stack_high ? 1 : -1;
+    }
+    return y->slot->calls < x->slot->calls ? -1 : y->slot->calls > x->slot->calls;
+}
+
+static void collect_stack_stats(PithDict *dict, const char *dict_name, StackStat **stats,
+                                size_t *count, size_t *capacity) {
+    for (size_t i = 0; i < dict->slot_count; i++) {
+        PithSlot *slot = &dict->slots[i];
+        if (slot->is_cached && slot->cached.type == VAL_DICT) {
+            PithDict *child = slot->cached.as.dict;
+            collect_stack_stats(child, child->name, stats, count, capacity);
+        }
+        if (slot->calls == 0) continue;
+        if (*count >= *capacity) {
+            *capacity = *capacity ? *capacity * 2 : 32;
+            *stats = realloc(*stats, *capacity * sizeof(StackStat));
+        }
+        (*stats)[(*count)++] = (StackStat){ dict_name, slot };
+    }
+}
+
+void pith_debug_print_stack_stats(PithRuntime *rt) {
+    StackStat *stats = NULL;
+    size_t count = 0, capacity = 0;
+    collect_stack_stats(rt->root, NULL, &stats, &count, &capacity);
+    qsort(stats, count, sizeof(StackStat), compare_stack_stats);
+
+    fprintf(stderr, "\n=== STACK HIGH-WATER MARKS ===\n");
+    fprintf(stderr, "Stack capacity: %zu values (limit %d)\n", rt->stack_capacity, PITH_STACK_MAX);
+    fprintf(stderr, "%10s %10s  slot\n", "high", "calls");
+    for (size_t i = 0; i < count; i++) {
+        fprintf(stderr, "%10zu %10zu  %s%s%s\n", stats[i].slot->stack_high, stats[i].slot->calls,
+                stats[i].dict ? stats[i].dict : "", stats[i].dict ? "." : "", stats[i].slot->name);
+    }
+    free(stats);
+}
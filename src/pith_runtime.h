@@ -4,20 +4,40 @@
  * This is the core interpreter that parses .pith files, manages
  * the stack and dictionaries, and executes words. It has no
  * platform dependencies and produces View trees for the UI to render.
+ *
+ * Threading: all interpreter state lives in PithRuntime, so independent
+ * runtimes may run on different threads at the same time. A runtime, and
+ * every value, view and signal it created, is confined to one thread at
+ * a time; hand it to another thread only with proper synchronization and
+ * never use it from two threads at once. Values must not be shared
+ * between runtimes (copy them with pith_value_copy first).
  */
 
 #ifndef PITH_RUNTIME_H
 #define PITH_RUNTIME_H
 
 #include "pith_types.h"
+#include <stdio.h>
 
 /* ========================================================================
    RUNTIME CONFIGURATION
    ======================================================================== */
 
-#define PITH_STACK_MAX      256
-#define PITH_TOKEN_MAX      4096
+#define PITH_STACK_INITIAL  256             /* Values the stack starts with */
+#define PITH_STACK_MAX      (1024 * 1024)   /* Values before "Stack overflow" */
 #define PITH_ERROR_MAX      256
+#define PITH_EXEC_DEPTH_MAX 10000           /* Nested word calls before "Recursion too deep" */
+#define PITH_LOAD_THREADS   16              /* Most threads lexing project files at once */
+#define PITH_SEARCH_SLICE   (256 * 1024)    /* Bytes scanned per frame by live searches */
+#define PITH_SEARCH_MAX_RESULTS 1000        /* Matches published into a results signal */
+#define PITH_WORKER_THREADS 16              /* Most threads running spawned blocks */
+#define PITH_WORKER_STACK   (16 * 1024 * 1024)  /* C stack per worker (deep recursion) */
+#define PITH_PARALLEL_CHUNK 1024            /* Fewest items per pmap/pfilter/preduce chunk */
+#define PITH_PARALLEL_SPLIT 8               /* Chunks per worker thread, for load balance */
+#define PITH_IO_THREADS     2               /* Threads running file-read-async/file-write-async */
+#define PITH_IO_CHUNK       (1024 * 1024)   /* Bytes per read call, checked for cancel between */
+#define PITH_TIMER_SLOTS    512             /* Lists in the timer wheel */
+#define PITH_TIMER_TICK_MS  1               /* Milliseconds between wheel slots */
 
 /* ========================================================================
    TOKEN TYPES (for parser)
@@ -50,6 +70,20 @@ typedef struct {
     size_t column;
 } PithToken;
 
+/* A compilation unit - the tokens of one loaded source. Units are never
+ * freed or moved before the runtime is, so slots and blocks can keep
+ * token indices into them across later loads. */
+struct PithUnit {
+    char *name;
+    PithToken *tokens;
+    size_t token_count;
+    size_t token_capacity;
+    void *map;              /* Mapped cache file the token texts point into */
+    size_t map_size;        /* (NULL when the texts are owned) */
+    bool merged;            /* Definitions made it into the runtime root */
+    bool borrowed;          /* Tokens belong to another runtime's unit */
+};
+
 /* ========================================================================
    FILE SYSTEM CALLBACKS
    
@@ -58,34 +92,144 @@ typedef struct {
    ======================================================================== */
 
 typedef struct {
-    /* Read entire file contents. Caller must free returned string. */
-    char* (*read_file)(const char *path, void *userdata);
-    
-    /* Write string to file. Returns true on success. */
-    bool (*write_file)(const char *path, const char *contents, void *userdata);
-    
-    /* Check if file exists */
+    size_t size;                /* Bytes (0 for directories) */
+    double modified;            /* Seconds since the epoch */
+    bool is_dir;
+} PithFileStat;
+
+/* write_file flags */
+#define PITH_WRITE_SYNC     1       /* Contents are on stable storage when write_file returns */
+
+/* Every callback may be called from several threads at once (project
+ * loading, background jobs and async file operations all use them). The
+ * ones marked optional may be NULL; the runtime then falls back to the
+ * required ones. */
+typedef struct {
+    /* Read entire file contents, NUL-terminated. Caller must free returned
+     * string. If len is not NULL it receives the byte length, which counts
+     * any NUL bytes inside the contents. */
+    char* (*read_file)(const char *path, size_t *len, void *userdata);
+
+    /* Write len bytes to file, replacing it. Returns true on success.
+     * The replacement should be atomic: after a crash the file holds the
+     * old or the new contents, never a mix. flags holds PITH_WRITE_*. */
+    bool (*write_file)(const char *path, const char *contents, size_t len,
+                       int flags, void *userdata);
+
+    /* Check if a file or directory exists */
     bool (*file_exists)(const char *path, void *userdata);
-    
+
     /* List directory contents. Returns array of paths. Caller must free. */
     char** (*list_dir)(const char *path, size_t *count, void *userdata);
-    
+
+    /* Optional: add len bytes to the end of a file, creating it */
+    bool (*append_file)(const char *path, const char *contents, size_t len, void *userdata);
+
+    /* Optional: size, time and kind of a path. Returns false if missing. */
+    bool (*stat_file)(const char *path, PithFileStat *st, void *userdata);
+
+    /* Optional (both or neither): read-only view of a whole file, or NULL
+     * if missing. The view stays valid until passed to unmap_file. */
+    const char* (*map_file)(const char *path, size_t *len, void *userdata);
+    void (*unmap_file)(const char *data, size_t len, void *userdata);
+
     /* User data passed to all callbacks */
     void *userdata;
 } PithFileSystem;
 
+/* ========================================================================
+   INCREMENTAL SEARCH
+
+   A live search watches a query signal and a list of buffer signals.
+   Match state is kept per buffer so a query that grows by a character
+   only re-checks the existing matches, and scanning is spread across
+   frames so large buffers never stall the UI.
+   ======================================================================== */
+
+typedef struct {
+    PithSignal *source;         /* Buffer signal (string or gap buffer) */
+    size_t version;             /* Signal version the state belongs to */
+    PithGapBuffer *buffer;      /* Gap buffer the state belongs to (NULL for strings) */
+    size_t revision;            /* Gap buffer revision the state belongs to */
+    size_t length;              /* Content length when state was taken */
+    size_t scanned;             /* Match start positions examined so far */
+    size_t *matches;            /* Match start offsets, ascending */
+    size_t match_count;
+    size_t match_capacity;
+} PithSearchTarget;
+
+typedef struct {
+    PithSignal *query;          /* Query signal (string or gap buffer) */
+    size_t query_version;
+    PithGapBuffer *query_buffer;
+    size_t query_revision;
+    char *text;                 /* Query the match state belongs to */
+    size_t text_len;
+
+    PithSignal *results;        /* Receives an array of [buffer pos] pairs */
+    PithSearchTarget *targets;
+    size_t target_count;
+} PithSearch;
+
+/* ========================================================================
+   TIMERS
+
+   Timers set with after/every live in a hashed timer wheel: each timer is
+   filed under the slot of the tick it is due on, so advancing the clock
+   only visits the slots that went by, not every timer.
+   ======================================================================== */
+
+typedef struct PithTimer {
+    size_t id;
+    double due;                 /* Runtime clock, in milliseconds */
+    double interval;            /* Repeat period (0 = fire once) */
+    uint64_t tick;              /* Wheel tick the timer is filed under */
+    PithBlock block;
+    PithDict *context;          /* Dictionary the timer was set from */
+    bool cancelled;
+    struct PithTimer *next;
+} PithTimer;
+
+/* ========================================================================
+   SAVES
+
+   file-save queues the contents for a path instead of writing at once.
+   Saves to the same path within save-delay ms coalesce into one write,
+   and a path is only ever written by one I/O thread at a time, so
+   writes land in the order they were asked for.
+   ======================================================================== */
+
+typedef struct {
+    char *path;
+    PithValue contents;         /* Newest contents not yet being written (nil = none) */
+    double due;                 /* Runtime clock when they should be written */
+    bool writing;               /* An older save of this path is being written */
+} PithSave;
+
+/* Threads (each with a private runtime) that run spawned blocks */
+typedef struct PithWorkerPool PithWorkerPool;
+
 /* ========================================================================
    RUNTIME STATE
    ======================================================================== */
 
 typedef struct {
-    /* Value stack */
-    PithValue stack[PITH_STACK_MAX];
+    /* Value stack (grows by doubling up to PITH_STACK_MAX) */
+    PithValue *stack;
     size_t stack_top;
+    size_t stack_capacity;
+    size_t stack_limit;             /* Pushes at or past this take the slow path */
+
+    /* Stack profiling: per-slot high-water marks (see pith_execute_slot) */
+    bool stack_profile;
+    size_t stack_peak;              /* Highest stack_top in the current named slot */
+    const char *exec_slot;          /* Innermost named slot being executed */
     
-    /* Token stream (from parser) */
-    PithToken tokens[PITH_TOKEN_MAX];
-    size_t token_count;
+    /* Compilation units, one per loaded source */
+    PithUnit **units;
+    size_t unit_count;
+    size_t unit_capacity;
+    size_t program_version;         /* Bumped whenever definitions are merged */
 
     /* Root dictionary - contains all top-level slots and dictionaries */
     /* Dictionaries are stored as slots with cached VAL_DICT values */
@@ -96,6 +240,10 @@ typedef struct {
     
     /* Project path */
     char *project_path;
+
+    /* Directory for token caches (NULL = no caching) */
+    char *cache_dir;
+    bool disk_cache;                /* Let project loads keep caches on disk (default true) */
     
     /* File system callbacks */
     PithFileSystem fs;
@@ -109,10 +257,41 @@ typedef struct {
 
     /* Reactive signals state */
     bool ui_building;               /* True when building UI (for auto-subscribe) */
+    bool view_stale;                /* Program was reloaded; rebuild the view tree */
     PithSignal **all_signals;       /* All signals for dirty checking */
     size_t signal_count;
     size_t signal_capacity;
 
+    /* Live searches (advanced a slice at a time from the frame loop) */
+    PithSearch **searches;
+    size_t search_count;
+    size_t search_capacity;
+
+    /* Timers (see pith_runtime_next_timer) */
+    PithTimer *timer_wheel[PITH_TIMER_SLOTS];
+    uint64_t timer_tick;            /* Tick the wheel has been advanced to */
+    PithTimer *timers_due;          /* Timers being fired by the current tick */
+    size_t timer_count;
+    size_t timer_next_id;
+    double timer_next_due;          /* Earliest due time on the wheel (-1 = none) */
+    double timer_epoch;             /* Monotonic clock at runtime creation */
+
+    /* Saves (see SAVES) */
+    PithSave *saves;
+    size_t save_count;
+    size_t save_capacity;
+    double save_delay;              /* Coalescing window in ms (0 = write at once) */
+    bool save_sync;                 /* fsync saves and file writes (default true) */
+
+    /* Worker threads for spawned blocks and parallel array words */
+    PithWorkerPool *workers;        /* Created on first use */
+    bool worker;                    /* This runtime runs jobs for another one */
+
+    /* Diagnostics and output */
+    bool debug;                     /* Trace loading and execution to stderr */
+    int exec_depth;                 /* Nesting of pith_execute_word calls */
+    FILE *out;                      /* Where print writes (stdout by default) */
+
 } PithRuntime;
 
 /* ========================================================================
@@ -134,9 +313,21 @@ bool pith_runtime_load_file(PithRuntime *rt, const char *path);
 /* Parse a string of pith code */
 bool pith_runtime_load_string(PithRuntime *rt, const char *source, const char *name);
 
-/* Process an event (key press, click, etc.) */
+/* Parse several .pith files in parallel and merge them in the given order */
+bool pith_runtime_load_files(PithRuntime *rt, const char **paths, size_t count);
+
+/* Re-parse a changed file and swap its definitions into the live
+ * dictionaries. Signal slots keep their values. Marks the view stale. */
+bool pith_runtime_reload_file(PithRuntime *rt, const char *path);
+
+/* Process an event (key press, click, etc.). EVENT_TICK fires every
+ * timer that is due, in due order. */
 void pith_runtime_handle_event(PithRuntime *rt, PithEvent event);
 
+/* Milliseconds until the next timer or delayed save is due (0 = due now),
+ * or -1 when none are set. Hosts send EVENT_TICK once it reaches 0. */
+double pith_runtime_next_timer(PithRuntime *rt);
+
 /* Get the current view tree to render */
 PithView* pith_runtime_get_view(PithRuntime *rt);
 
@@ -162,6 +353,9 @@ PithValue pith_peek(PithRuntime *rt);
 /* Check if stack has at least n items */
 bool pith_stack_has(PithRuntime *rt, size_t n);
 
+/* Turn per-slot stack high-water tracking on or off */
+void pith_stack_profile(PithRuntime *rt, bool enable);
+
 /* ========================================================================
    DICTIONARY OPERATIONS
    ======================================================================== */
@@ -176,7 +370,8 @@ void pith_dict_free(PithDict *dict);
 void pith_dict_set_parent(PithDict *dict, PithDict *parent);
 
 /* Add a slot to a dictionary */
-bool pith_dict_add_slot(PithDict *dict, const char *name, size_t body_start, size_t body_end);
+bool pith_dict_add_slot(PithDict *dict, const char *name, PithUnit *unit,
+                        size_t body_start, size_t body_end);
 
 /* Look up a slot by name, following parent chain */
 PithSlot* pith_dict_lookup(PithDict *dict, const char *name);
@@ -242,6 +437,13 @@ void pith_map_set(PithMap *map, const char *key, PithValue value);
 PithValue* pith_map_get(PithMap *map, const char *key);
 bool pith_map_has(PithMap *map, const char *key);
 
+/* ========================================================================
+   UTF-8 HELPERS
+   ======================================================================== */
+
+size_t pith_utf8_encode(uint32_t codepoint, char *out);
+size_t pith_utf8_count(const char *str, size_t len);
+
 /* ========================================================================
    GAP BUFFER HELPERS
    ======================================================================== */
@@ -257,20 +459,45 @@ void pith_gapbuf_goto(PithGapBuffer *gb, size_t pos);
 size_t pith_gapbuf_cursor(PithGapBuffer *gb);
 char pith_gapbuf_char_at(PithGapBuffer *gb, size_t pos);
 char* pith_gapbuf_to_string(PithGapBuffer *gb);
+char* pith_gapbuf_to_value_string(PithGapBuffer *gb);   /* For PITH_STRING values */
+size_t pith_gapbuf_next_char(PithGapBuffer *gb, size_t pos);
+size_t pith_gapbuf_prev_char(PithGapBuffer *gb, size_t pos);
+void pith_gapbuf_copy_range(PithGapBuffer *gb, size_t start, size_t end, char *out);
 
 /* Line navigation helpers for multiline text editing */
 size_t pith_gapbuf_length(PithGapBuffer *gb);
 size_t pith_gapbuf_cursor_line(PithGapBuffer *gb);
 size_t pith_gapbuf_cursor_column(PithGapBuffer *gb);
+size_t pith_gapbuf_pos_line(PithGapBuffer *gb, size_t pos);
+size_t pith_gapbuf_pos_column(PithGapBuffer *gb, size_t pos);
 size_t pith_gapbuf_line_start(PithGapBuffer *gb, size_t line);
 size_t pith_gapbuf_line_end(PithGapBuffer *gb, size_t line);
 size_t pith_gapbuf_line_length(PithGapBuffer *gb, size_t line);
+size_t pith_gapbuf_line_columns(PithGapBuffer *gb, size_t line);
 size_t pith_gapbuf_line_count(PithGapBuffer *gb);
 void pith_gapbuf_move_up(PithGapBuffer *gb, int n);
 void pith_gapbuf_move_down(PithGapBuffer *gb, int n);
 void pith_gapbuf_line_home(PithGapBuffer *gb);
 void pith_gapbuf_line_end_move(PithGapBuffer *gb);
 size_t pith_gapbuf_pos_from_line_col(PithGapBuffer *gb, size_t line, size_t col);
+bool pith_gapbuf_changes_since(PithGapBuffer *gb, size_t since, size_t *start, size_t *end);
+
+/* One batch edit: replace del bytes at pos with len bytes of text */
+typedef struct {
+    size_t pos;
+    size_t del;
+    const char *text;
+    size_t len;
+} PithGapEdit;
+
+/* Batch edits and multiple cursors */
+void pith_gapbuf_apply_edits(PithGapBuffer *gb, const PithGapEdit *edits, size_t count);
+size_t pith_gapbuf_replace_all(PithGapBuffer *gb, const char *find, const char *replace);
+void pith_gapbuf_add_cursor(PithGapBuffer *gb, size_t pos);
+void pith_gapbuf_clear_cursors(PithGapBuffer *gb);
+void pith_gapbuf_multi_insert(PithGapBuffer *gb, const char *str);
+void pith_gapbuf_multi_delete(PithGapBuffer *gb, int n);
+void pith_gapbuf_multi_move(PithGapBuffer *gb, int delta);
 
 /* ========================================================================
    SIGNAL HELPERS
@@ -287,6 +514,30 @@ bool pith_runtime_has_dirty_signals(PithRuntime *rt);
 /* Clear all dirty flags after re-render */
 void pith_runtime_clear_dirty(PithRuntime *rt);
 
+/* ========================================================================
+   SEARCH HELPERS
+   ======================================================================== */
+
+/* Scan up to budget bytes across live searches, publishing new results.
+ * Returns true while any search still has unscanned text. */
+bool pith_runtime_search_step(PithRuntime *rt, size_t budget);
+
+/* ========================================================================
+   JOB HELPERS
+   ======================================================================== */
+
+/* Write the results of finished spawned jobs into their signals.
+ * Call from the frame loop; never blocks on running jobs. */
+void pith_runtime_poll_jobs(PithRuntime *rt);
+
+/* ========================================================================
+   LEXER HELPERS
+   ======================================================================== */
+
+/* Lexer character rules, shared with the syntax highlighter */
+bool pith_is_word_char(char c);
+PithTokenType pith_keyword_type(const char *text, size_t len);
+
 /* ========================================================================
    VIEW HELPERS
    ======================================================================== */
@@ -322,4 +573,7 @@ void pith_debug_print_state(PithRuntime *rt);
 /* Print view hierarchy */
 void pith_debug_print_view(PithView *view, int indent);
 
+/* Print per-slot stack high-water marks, deepest first */
+void pith_debug_print_stack_stats(PithRuntime *rt);
+
 #endif /* PITH_RUNTIME_H */
@@ -0,0 +1,159 @@
+/*
+ * pith_string.c - Length-prefixed strings for Pith values
+ */
+
+#include "pith_string.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    size_t length;              /* Bytes before the NUL */
+    size_t capacity;            /* Bytes available for chars + NUL */
+} PithStringHeader;
+
+#define SIZE_CLASS  16
+#define CLASS_COUNT (PITH_STRING_SMALL / SIZE_CLASS)
+
+/* Free small strings, one list per 16-byte capacity class. The next
+ * pointer lives in the unused character bytes. Lists are per thread so
+ * worker threads never contend on them. */
+static _Thread_local char *free_lists[CLASS_COUNT];
+static _Thread_local size_t free_counts[CLASS_COUNT];
+
+static PithStringHeader* header_of(const char *str) {
+    return (PithStringHeader *)str - 1;
+}
+
+char* pith_string_alloc(size_t len) {
+    size_t need = len + 1;
+    char *str;
+
+    if (need <= PITH_STRING_SMALL) {
+        size_t cls = (need - 1) / SIZE_CLASS;
+        str = free_lists[cls];
+        if (str) {
+            memcpy(&free_lists[cls], str, sizeof(char *));
+            free_counts[cls]--;
+        } else {
+            PithStringHeader *h = malloc(sizeof(PithStringHeader) + (cls + 1) * SIZE_CLASS);
+            if (!h) return NULL;
+            h->capacity = (cls + 1) * SIZE_CLASS;
+            str = (char *)(h + 1);
+        }
+    } else {
+        PithStringHeader *h = malloc(sizeof(PithStringHeader) + need);
+        if (!h) return NULL;
+        h->capacity = need;
+        str = (char *)(h + 1);
+    }
+
+    PithStringHeader *h = header_of(str);
+    h->length = len;
+    str[len] = '\0';
+    return str;
+}
+
+char* pith_string_new(const char *s, size_t len) {
+    char *str = pith_string_alloc(len);
+    if (str && len) memcpy(str, s, len);
+    return str;
+}
+
+char* pith_string_dup(const char *s) {
+    if (!s) return NULL;
+    return pith_string_new(s, strlen(s));
+}
+
+char* pith_string_copy(const char *str) {
+    if (!str) return NULL;
+    return pith_string_new(str, header_of(str)->length);
+}
+
+size_t pith_string_length(const char *str) {
+    return header_of(str)->length;
+}
+
+bool pith_string_equal(const char *a, const char *b) {
+    if (a == b) return true;
+    PithStringHeader *ha = header_of(a);
+    PithStringHeader *hb = header_of(b);
+    if (ha->length != hb->length) return false;
+    return memcmp(a, b, ha->length) == 0;
+}
+
+const char* pith_string_find(const char *hay, size_t hay_len,
+                             const char *needle, size_t needle_len) {
+    if (needle_len == 0) return hay;
+    if (needle_len > hay_len) return NULL;
+
+    const char *p = hay;
+    const char *last = hay + hay_len - needle_len;
+    while (p <= last) {
+        p = memchr(p, needle[0], (size_t)(last - p) + 1);
+        if (!p) return NULL;
+        if (memcmp(p, needle, needle_len) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
+char* pith_string_append(char *str, const char *s, size_t len) {
+    PithStringHeader *h = header_of(str);
+    size_t length = h->length;
+    size_t need = length + len + 1;
+
+    if (need > h->capacity) {
+        size_t capacity = h->capacity * 2;
+        if (capacity < need) capacity = need;
+
+        if (capacity <= PITH_STRING_SMALL) {
+            char *grown = pith_string_alloc(capacity - 1);
+            memcpy(grown, str, length);
+            pith_string_free(str);
+            str = grown;
+        } else if (h->capacity <= PITH_STRING_SMALL) {
+            /* Leaving the pooled sizes: move to an exact heap block */
+            PithStringHeader *grown = malloc(sizeof(PithStringHeader) + capacity);
+            if (!grown) return str;
+            grown->capacity = capacity;
+            memcpy(grown + 1, str, length);
+            pith_string_free(str);
+            str = (char *)(grown + 1);
+        } else {
+            h = realloc(h, sizeof(PithStringHeader) + capacity);
+            if (!h) return str;
+            h->capacity = capacity;
+            str = (char *)(h + 1);
+        }
+    }
+
+    h = header_of(str);
+    memcpy(str + length, s, len);
+    h->length = length + len;
+    str[h->length] = '\0';
+    return str;
+}
+
+void pith_string_truncate(char *str, size_t len) {
+    PithStringHeader *h = header_of(str);
+    if (len < h->length) {
+        h->length = len;
+        str[len] = '\0';
+    }
+}
+
+void pith_string_free(char *str) {
+    if (!str) return;
+    PithStringHeader *h = header_of(str);
+
+    if (h->capacity <= PITH_STRING_SMALL) {
+        size_t cls = h->capacity / SIZE_CLASS - 1;
+        if (free_counts[cls] < PITH_STRING_POOL_MAX) {
+            memcpy(str, &free_lists[cls], sizeof(char *));
+            free_lists[cls] = str;
+            free_counts[cls]++;
+            return;
+        }
+    }
+    free(h);
+}
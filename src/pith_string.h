@@ -0,0 +1,59 @@
+/*
+ * pith_string.h - Length-prefixed strings for Pith values
+ *
+ * String values are still plain NUL-terminated char pointers, so they can
+ * be handed to any C function, but every one is allocated with a small
+ * header in front of the characters that records its byte length and
+ * capacity. Length queries are O(1), lengths are authoritative so strings
+ * may contain NUL bytes, and short strings are recycled through per-thread
+ * free lists instead of going back to malloc.
+ *
+ *   [ PithStringHeader | chars ... | '\0' ]
+ *                        ^ char * stored in PithValue.as.string
+ *
+ * Only pointers returned by these functions may be used as string values
+ * or passed to pith_string_free().
+ */
+
+#ifndef PITH_STRING_H
+#define PITH_STRING_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PITH_STRING_SMALL       64      /* Largest capacity kept on the free lists */
+#define PITH_STRING_POOL_MAX    1024    /* Free strings kept per size class */
+
+/* A string of len bytes; contents are uninitialized except the final NUL */
+char* pith_string_alloc(size_t len);
+
+/* A string holding a copy of len bytes of s */
+char* pith_string_new(const char *s, size_t len);
+
+/* A string holding a copy of the C string s */
+char* pith_string_dup(const char *s);
+
+/* A copy of another Pith string (no strlen) */
+char* pith_string_copy(const char *str);
+
+/* Byte length of a Pith string */
+size_t pith_string_length(const char *str);
+
+/* Byte-wise equality, rejecting on length first */
+bool pith_string_equal(const char *a, const char *b);
+
+/* First occurrence of needle in haystack, or NULL; NUL bytes match like
+ * any other byte */
+const char* pith_string_find(const char *hay, size_t hay_len,
+                             const char *needle, size_t needle_len);
+
+/* Append len bytes of s, growing the capacity geometrically. Returns the
+ * string, which may have moved. */
+char* pith_string_append(char *str, const char *s, size_t len);
+
+/* Shorten a string in place (len must not exceed its current length) */
+void pith_string_truncate(char *str, size_t len);
+
+void pith_string_free(char *str);
+
+#endif /* PITH_STRING_H */
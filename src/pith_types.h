@@ -29,6 +29,8 @@ typedef enum {
     VAL_GAPBUF,         /* Gap buffer for text editing */
     VAL_SIGNAL,         /* Reactive signal */
     VAL_OUTLINE_NODE,   /* Outline tree node */
+    VAL_BUILDER,        /* String builder (growable string, as.string) */
+    VAL_SEQ,            /* Lazy sequence, read one item at a time (file-lines) */
 } PithValueType;
 
 /* Forward declarations */
@@ -39,14 +41,21 @@ typedef struct PithBlock PithBlock;
 typedef struct PithView PithView;
 typedef struct PithDict PithDict;
 typedef struct PithSlot PithSlot;
+typedef struct PithUnit PithUnit;
 typedef struct PithGapBuffer PithGapBuffer;
+typedef struct PithLineIndex PithLineIndex;
+typedef struct PithEditLog PithEditLog;
+typedef struct PithHighlighter PithHighlighter;
+typedef struct PithWrapMap PithWrapMap;
 typedef struct PithSignal PithSignal;
 typedef struct PithOutlineNode PithOutlineNode;
+typedef struct PithSeq PithSeq;
 
 /* Anonymous block - stores word indices to execute */
 struct PithBlock {
-    size_t start;   /* Start index in token stream */
-    size_t end;     /* End index in token stream */
+    PithUnit *unit; /* Compilation unit holding the tokens */
+    size_t start;   /* Start index in the unit's tokens */
+    size_t end;     /* End index in the unit's tokens */
 };
 
 /* The universal value type - defined early so it can be embedded in other structs */
@@ -64,6 +73,7 @@ struct PithValue {
         PithGapBuffer *gapbuf;
         PithSignal *signal;
         PithOutlineNode *outline_node;
+        PithSeq *seq;
     } as;
 };
 
@@ -97,6 +107,13 @@ struct PithGapBuffer {
     size_t gap_start;   /* Start of gap (cursor position in content) */
     size_t gap_end;     /* End of gap (exclusive) */
     int scroll_offset;  /* First visible line (for textarea views) */
+    size_t revision;    /* Bumped on every content edit */
+    PithLineIndex *lines; /* Line starts and widths (built on first use) */
+    size_t *cursors;    /* Extra cursor positions, sorted (multi-cursor) */
+    size_t cursor_count;
+    PithEditLog *edit_log;  /* Recent edits (kept once something asks) */
+    PithHighlighter *highlighter; /* Line states for textarea highlighting (or NULL) */
+    PithWrapMap *wrap;  /* Soft-wrap layout for textareas (or NULL) */
 };
 
 /* Reactive signal - wraps a value and tracks dependencies
@@ -109,6 +126,7 @@ struct PithSignal {
     size_t subscriber_count;
     size_t subscriber_capacity;
     bool dirty;                 /* Needs re-render */
+    size_t version;             /* Bumped on every write */
 };
 
 /* ========================================================================
@@ -201,6 +219,8 @@ struct PithView {
             PithSignal *source_signal;  /* Signal to update on blur */
             int scroll_offset;    /* First visible line for scrolling */
             int visible_height;   /* Cached visible height from last render */
+            PithHighlighter *highlighter; /* The buffer's highlighter (or NULL) */
+            PithWrapMap *wrap;    /* The buffer's wrap map (or NULL for no wrapping) */
         } textarea;
 
         /* VIEW_BUTTON */
@@ -245,12 +265,17 @@ struct PithSlot {
     
     /* The word body - sequence of tokens to execute */
     /* For simple data slots, this is just the literal value */
+    PithUnit *unit;     /* Compilation unit the body's tokens live in */
     size_t body_start;
     size_t body_end;
     
     /* Cached value (for pure data slots) */
     bool is_cached;
     PithValue cached;
+
+    /* Stack profiling (only counted while rt->stack_profile is set) */
+    size_t calls;
+    size_t stack_high;  /* Most values the body left above its entry depth */
 };
 
 /* A dictionary (component) */
@@ -293,6 +318,7 @@ typedef struct {
             int x;              /* Cell coordinates */
             int y;
             int button;         /* 0=left, 1=right, 2=middle */
+            bool alt;           /* Alt held (adds a cursor in a textarea) */
             PithView *target;   /* Which view was clicked */
         } click;
         
@@ -325,6 +351,8 @@ typedef struct {
 #define PITH_GAPBUF(v)      ((PithValue){ .type = VAL_GAPBUF, .as.gapbuf = (v) })
 #define PITH_SIGNAL(v)      ((PithValue){ .type = VAL_SIGNAL, .as.signal = (v) })
 #define PITH_OUTLINE_NODE(v) ((PithValue){ .type = VAL_OUTLINE_NODE, .as.outline_node = (v) })
+#define PITH_BUILDER(v)     ((PithValue){ .type = VAL_BUILDER, .as.string = (v) })
+#define PITH_SEQ(v)         ((PithValue){ .type = VAL_SEQ, .as.seq = (v) })
 
 /* Type checking */
 #define PITH_IS_NIL(v)      ((v).type == VAL_NIL)
@@ -339,5 +367,7 @@ typedef struct {
 #define PITH_IS_GAPBUF(v)   ((v).type == VAL_GAPBUF)
 #define PITH_IS_SIGNAL(v)   ((v).type == VAL_SIGNAL)
 #define PITH_IS_OUTLINE_NODE(v) ((v).type == VAL_OUTLINE_NODE)
+#define PITH_IS_BUILDER(v)  ((v).type == VAL_BUILDER)
+#define PITH_IS_SEQ(v)      ((v).type == VAL_SEQ)
 
 #endif /* PITH_TYPES_H */
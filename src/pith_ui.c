@@ -6,6 +6,8 @@
  */
 
 #include "pith_ui.h"
+#include "pith_highlight.h"
+#include "pith_wrap.h"
 #include "raylib.h"
 #include "font_data.h"
 #include <stdlib.h>
@@ -36,6 +38,7 @@ struct PithUI {
     /* Input state */
     int last_key;
     bool key_pending;
+    char text_buf[8];            /* UTF-8 of the last text input event */
 
     /* Focus state */
     PithView *focused_view;
@@ -368,6 +371,64 @@ static void render_text(PithUI *ui, const char *text, int cell_x, int cell_y,
     }
 }
 
+/* Colors for highlighted runs (open color palette) */
+static const uint32_t highlight_colors[HL_KIND_COUNT] = {
+    [HL_PLAIN]       = 0x212529ff, /* gray 9 */
+    [HL_COMMENT]     = 0x868e96ff, /* gray 6 */
+    [HL_STRING]      = 0x2b8a3eff, /* green 9 */
+    [HL_NUMBER]      = 0xd9480fff, /* orange 9 */
+    [HL_KEYWORD]     = 0x5f3dc4ff, /* violet 9 */
+    [HL_DEFINITION]  = 0x1864abff, /* blue 9 */
+    [HL_PUNCTUATION] = 0x495057ff, /* gray 7 */
+};
+
+/* Render text[start, end) of a row at its column */
+static void render_row_span(PithUI *ui, char *text, size_t start, size_t end,
+                            int cell_x, int cell_y, PithHighlightKind kind) {
+    if (start >= end) return;
+    int x = cell_x + (int)pith_utf8_count(text, start);
+    char saved = text[end];
+    text[end] = '\0';
+    render_text(ui, text + start, x, cell_y, highlight_colors[kind], kind == HL_KEYWORD);
+    text[end] = saved;
+}
+
+/* Render colored runs over part of a line. text holds the line's bytes
+ * [offset, offset + len); run offsets are relative to the line start.
+ * Bytes outside every run (separators, or the rest of a line with more
+ * runs than were returned) are drawn plain. */
+static void render_highlighted_line(PithUI *ui, char *text, size_t offset, size_t len,
+                                    const PithHighlightRun *runs, size_t run_count,
+                                    int cell_x, int cell_y) {
+    size_t drawn = 0;
+    for (size_t i = 0; i < run_count; i++) {
+        size_t start = runs[i].start;
+        size_t end = start + runs[i].length;
+        if (end <= offset) continue;
+        if (start >= offset + len) break;
+        if (start < offset) start = offset;
+        if (end > offset + len) end = offset + len;
+        start -= offset;
+        end -= offset;
+
+        render_row_span(ui, text, drawn, start, cell_x, cell_y, HL_PLAIN);
+        render_row_span(ui, text, start, end, cell_x, cell_y, runs[i].kind);
+        drawn = end;
+    }
+    render_row_span(ui, text, drawn, len, cell_x, cell_y, HL_PLAIN);
+}
+
+/* Row of a buffer position in textarea scroll units (visual rows when
+ * wrapping, lines otherwise), and its column within that row */
+static size_t textarea_pos_row(PithView *view, size_t pos, size_t *col) {
+    PithGapBuffer *buf = view->as.textarea.buffer;
+    if (view->as.textarea.wrap) {
+        return pith_wrap_pos_to_row(view->as.textarea.wrap, buf, pos, col);
+    }
+    *col = pith_gapbuf_pos_column(buf, pos);
+    return pith_gapbuf_pos_line(buf, pos);
+}
+
 /* Render a border around a cell region */
 static void render_border(PithUI *ui, int x, int y, int w, int h, 
                           const char *edges, uint32_t color) {
@@ -422,8 +483,8 @@ static void measure_view(PithUI *ui, PithView *view, int *out_w, int *out_h) {
                         lines++;
                         if (current_width > max_width) max_width = current_width;
                         current_width = 0;
-                    } else {
-                        current_width++;
+                    } else if ((*c & 0xC0) != 0x80) {
+                        current_width++;  /* One cell per codepoint */
                     }
                 }
                 if (current_width > max_width) max_width = current_width;
@@ -439,11 +500,9 @@ static void measure_view(PithUI *ui, PithView *view, int *out_w, int *out_h) {
             /* Measure based on gap buffer content, with minimum width */
             int content_width = 10;
             if (view->as.textfield.buffer) {
-                char *str = pith_gapbuf_to_string(view->as.textfield.buffer);
-                if (str) {
-                    content_width = (int)strlen(str) + 2; /* +2 for padding */
-                    free(str);
-                }
+                /* Single line, so its width is the indexed column count */
+                size_t cols = pith_gapbuf_line_columns(view->as.textfield.buffer, 0);
+                content_width = (int)cols + 2; /* +2 for padding */
             }
             *out_w = content_width > 10 ? content_width : 10;
             *out_h = 1;
@@ -465,9 +524,9 @@ static void measure_view(PithUI *ui, PithView *view, int *out_w, int *out_h) {
                 size_t total_lines = pith_gapbuf_line_count(view->as.textarea.buffer);
                 line_count = total_lines > 3 ? (int)total_lines : 3;
 
-                /* Find max line width */
-                for (size_t i = 0; i < total_lines; i++) {
-                    size_t line_len = pith_gapbuf_line_length(view->as.textarea.buffer, i);
+                /* Find max line width (wrapped textareas wrap instead) */
+                for (size_t i = 0; i < total_lines && !view->as.textarea.wrap; i++) {
+                    size_t line_len = pith_gapbuf_line_columns(view->as.textarea.buffer, i);
                     if ((int)line_len + 2 > max_width) {
                         max_width = (int)line_len + 2;  /* +2 for padding */
                     }
@@ -786,8 +845,8 @@ static void render_view_internal(PithUI *ui, PithView *view,
 
                     /* Draw cursor if this field is focused */
                     if (ui->focused_view == view) {
-                        size_t cursor_pos = pith_gapbuf_cursor(view->as.textfield.buffer);
-                        int cursor_x = inner_x + 1 + (int)cursor_pos;
+                        size_t cursor_col = pith_gapbuf_cursor_column(view->as.textfield.buffer);
+                        int cursor_x = inner_x + 1 + (int)cursor_col;
                         /* Draw cursor as a vertical bar */
                         int px = cursor_x * ui->cell_width;
                         int py = inner_y * ui->cell_height;
@@ -812,10 +871,11 @@ static void render_view_internal(PithUI *ui, PithView *view,
             /* Check if status bar is enabled */
             bool show_statusbar = view->style.has_statusbar && view->style.statusbar;
 
-            /* Render text line by line */
+            /* Render text row by row */
             if (view->as.textarea.buffer) {
                 PithGapBuffer *buf = view->as.textarea.buffer;
-                size_t total_lines = pith_gapbuf_line_count(buf);
+                PithWrapMap *wrap = view->as.textarea.wrap;
+                PithHighlighter *hl = view->as.textarea.highlighter;
                 int scroll_offset = buf->scroll_offset;
 
                 /* Calculate visible lines (reserve 1 for status bar if enabled) */
@@ -827,39 +887,85 @@ static void render_view_internal(PithUI *ui, PithView *view,
                 /* Cache visible height for scroll calculations */
                 view->as.textarea.visible_height = visible_lines;
 
-                /* Render each visible line */
-                for (int line_idx = 0; line_idx < visible_lines; line_idx++) {
-                    size_t line_num = scroll_offset + line_idx;
-                    if (line_num >= total_lines) break;
-
-                    /* Extract line content */
-                    size_t line_start = pith_gapbuf_line_start(buf, line_num);
-                    size_t line_len = pith_gapbuf_line_length(buf, line_num);
+                /* Text width in codepoints */
+                int max_chars = inner_w - 2;  /* Leave space for padding */
+                if (max_chars < 0) max_chars = 0;
 
-                    /* Build line string - fit within available width */
-                    int max_chars = inner_w - 2;  /* Leave space for padding */
-                    if (max_chars < 0) max_chars = 0;
-                    size_t chars_to_copy = line_len < (size_t)max_chars ? line_len : (size_t)max_chars;
+                /* Rows are lines, or visual rows of wrapped lines */
+                size_t total_rows = pith_gapbuf_line_count(buf);
+                if (wrap) {
+                    pith_wrap_sync(wrap, buf, max_chars);
+                    total_rows = pith_wrap_total_rows(wrap);
+                }
 
-                    char *line_buf = malloc(chars_to_copy + 1);
-                    for (size_t i = 0; i < chars_to_copy; i++) {
-                        line_buf[i] = pith_gapbuf_char_at(buf, line_start + i);
+                PithHighlightRun runs[PITH_HIGHLIGHT_MAX_RUNS];
+                size_t run_count = 0;
+                size_t runs_line = SIZE_MAX;
+
+                /* Render each visible row */
+                for (int row_idx = 0; row_idx < visible_lines; row_idx++) {
+                    size_t row = scroll_offset + row_idx;
+                    if (row >= total_rows) break;
+
+                    /* Byte range of the row */
+                    size_t line_num, row_start, row_end;
+                    if (wrap) {
+                        size_t sub;
+                        size_t width = (size_t)pith_wrap_width(wrap);
+                        line_num = pith_wrap_line_at_row(wrap, row, &sub);
+                        row_start = pith_gapbuf_pos_from_line_col(buf, line_num, sub * width);
+                        row_end = pith_gapbuf_pos_from_line_col(buf, line_num, (sub + 1) * width);
+                    } else {
+                        /* Fit within available width (in codepoints) */
+                        line_num = row;
+                        row_start = pith_gapbuf_line_start(buf, line_num);
+                        row_end = row_start;
+                        if (pith_gapbuf_line_columns(buf, line_num) <= (size_t)max_chars) {
+                            row_end = pith_gapbuf_line_end(buf, line_num);
+                        } else {
+                            for (int i = 0; i < max_chars; i++) {
+                                row_end = pith_gapbuf_next_char(buf, row_end);
+                            }
+                        }
                     }
-                    line_buf[chars_to_copy] = '\0';
 
-                    render_text(ui, line_buf, inner_x + 1, inner_y + line_idx, field_fg, false);
+                    size_t bytes_to_copy = row_end - row_start;
+                    char *line_buf = malloc(bytes_to_copy + 1);
+                    pith_gapbuf_copy_range(buf, row_start, row_end, line_buf);
+                    line_buf[bytes_to_copy] = '\0';
+
+                    if (hl) {
+                        /* Wrapped rows of one line share its runs */
+                        if (runs_line != line_num) {
+                            run_count = pith_highlight_line(hl, buf, line_num, runs,
+                                                            PITH_HIGHLIGHT_MAX_RUNS);
+                            if (run_count > PITH_HIGHLIGHT_MAX_RUNS) {
+                                run_count = PITH_HIGHLIGHT_MAX_RUNS;
+                            }
+                            runs_line = line_num;
+                        }
+                        size_t offset = row_start - pith_gapbuf_line_start(buf, line_num);
+                        render_highlighted_line(ui, line_buf, offset, bytes_to_copy, runs,
+                                                run_count, inner_x + 1, inner_y + row_idx);
+                    } else {
+                        render_text(ui, line_buf, inner_x + 1, inner_y + row_idx, field_fg, false);
+                    }
                     free(line_buf);
                 }
 
-                /* Draw cursor if focused */
+                /* Draw cursors if focused (primary first, then any extra cursors) */
                 if (ui->focused_view == view) {
-                    size_t cursor_line = pith_gapbuf_cursor_line(buf);
-                    size_t cursor_col = pith_gapbuf_cursor_column(buf);
-
-                    /* Check if cursor is in visible area */
-                    if ((int)cursor_line >= scroll_offset &&
-                        (int)cursor_line < scroll_offset + visible_lines) {
-                        int cursor_screen_y = inner_y + (int)cursor_line - scroll_offset;
+                    for (size_t c = 0; c <= buf->cursor_count; c++) {
+                        size_t pos = c == 0 ? pith_gapbuf_cursor(buf) : buf->cursors[c - 1];
+                        size_t cursor_col;
+                        size_t cursor_row = textarea_pos_row(view, pos, &cursor_col);
+
+                        /* Check if cursor is in visible area */
+                        if ((int)cursor_row < scroll_offset ||
+                            (int)cursor_row >= scroll_offset + visible_lines) {
+                            continue;
+                        }
+                        int cursor_screen_y = inner_y + (int)cursor_row - scroll_offset;
                         int cursor_screen_x = inner_x + 1 + (int)cursor_col;
 
                         /* Draw cursor as a vertical bar */
@@ -1122,16 +1228,9 @@ PithEvent pith_ui_poll_event(PithUI *ui) {
     if (ch != 0) {
         event.type = EVENT_TEXT_INPUT;
         /* Convert unicode codepoint to UTF-8 */
-        static char text_buf[8];
-        if (ch < 0x80) {
-            text_buf[0] = ch;
-            text_buf[1] = '\0';
-        } else {
-            /* Simplified UTF-8 encoding */
-            text_buf[0] = ch;
-            text_buf[1] = '\0';
-        }
-        event.as.text_input.text = text_buf;
+        size_t n = pith_utf8_encode((uint32_t)ch, ui->text_buf);
+        ui->text_buf[n] = '\0';
+        event.as.text_input.text = ui->text_buf;
         return event;
     }
     
@@ -1143,6 +1242,7 @@ PithEvent pith_ui_poll_event(PithUI *ui) {
         event.as.click.x = (int)(pos.x / ui->cell_width);
         event.as.click.y = (int)(pos.y / ui->cell_height);
         event.as.click.button = 0;
+        event.as.click.alt = IsKeyDown(KEY_LEFT_ALT) || IsKeyDown(KEY_RIGHT_ALT);
         event.as.click.target = NULL;
         return event;
     }
@@ -1154,6 +1254,7 @@ PithEvent pith_ui_poll_event(PithUI *ui) {
         event.as.click.x = (int)(pos.x / ui->cell_width);
         event.as.click.y = (int)(pos.y / ui->cell_height);
         event.as.click.button = 1;
+        event.as.click.alt = IsKeyDown(KEY_LEFT_ALT) || IsKeyDown(KEY_RIGHT_ALT);
         event.as.click.target = NULL;
         return event;
     }
@@ -1253,12 +1354,38 @@ void pith_ui_restore_focus(PithUI *ui, PithView *root) {
    TEXTFIELD / TEXTAREA INPUT HANDLING
    ======================================================================== */
 
+/* Move the cursor up or down by lines, or by visual rows when wrapping */
+static void textarea_move_rows(PithView *view, int delta) {
+    PithGapBuffer *buf = view->as.textarea.buffer;
+    PithWrapMap *wrap = view->as.textarea.wrap;
+    if (!wrap) {
+        if (delta < 0) pith_gapbuf_move_up(buf, -delta);
+        else pith_gapbuf_move_down(buf, delta);
+        return;
+    }
+
+    pith_wrap_sync(wrap, buf, pith_wrap_width(wrap));
+    size_t col;
+    size_t row = textarea_pos_row(view, pith_gapbuf_cursor(buf), &col);
+    size_t total = pith_wrap_total_rows(wrap);
+    if (delta < 0) {
+        row = (size_t)-delta > row ? 0 : row + delta;
+    } else {
+        row += (size_t)delta;
+        if (total > 0 && row >= total) row = total - 1;
+    }
+    pith_gapbuf_goto(buf, pith_wrap_row_col_to_pos(wrap, buf, row, col));
+}
+
 /* Update scroll offset to keep cursor visible */
 static void update_textarea_scroll(PithView *view) {
     if (view->type != VIEW_TEXTAREA || !view->as.textarea.buffer) return;
 
     PithGapBuffer *buf = view->as.textarea.buffer;
-    size_t cursor_line = pith_gapbuf_cursor_line(buf);
+    PithWrapMap *wrap = view->as.textarea.wrap;
+    if (wrap) pith_wrap_sync(wrap, buf, pith_wrap_width(wrap));
+    size_t cursor_col;
+    size_t cursor_row = textarea_pos_row(view, pith_gapbuf_cursor(buf), &cursor_col);
     int scroll_offset = buf->scroll_offset;
 
     /* Get visible height: use cached value from render, or style, or default */
@@ -1270,12 +1397,12 @@ static void update_textarea_scroll(PithView *view) {
     }
 
     /* Adjust scroll to keep cursor visible */
-    if ((int)cursor_line < scroll_offset) {
+    if ((int)cursor_row < scroll_offset) {
         /* Cursor is above visible area */
-        buf->scroll_offset = (int)cursor_line;
-    } else if ((int)cursor_line >= scroll_offset + visible_lines) {
+        buf->scroll_offset = (int)cursor_row;
+    } else if ((int)cursor_row >= scroll_offset + visible_lines) {
         /* Cursor is below visible area */
-        buf->scroll_offset = (int)cursor_line - visible_lines + 1;
+        buf->scroll_offset = (int)cursor_row - visible_lines + 1;
     }
 }
 
@@ -1297,8 +1424,8 @@ bool pith_ui_handle_textfield_input(PithUI *ui, PithEvent event) {
     if (!buf) return false;
 
     if (event.type == EVENT_TEXT_INPUT) {
-        /* Insert typed character */
-        pith_gapbuf_insert(buf, event.as.text_input.text);
+        /* Insert typed character (at every cursor) */
+        pith_gapbuf_multi_insert(buf, event.as.text_input.text);
         if (is_textarea) update_textarea_scroll(ui->focused_view);
         return true;
     }
@@ -1308,47 +1435,50 @@ bool pith_ui_handle_textfield_input(PithUI *ui, PithEvent event) {
 
         /* Backspace - delete character before cursor */
         if (key == KEY_BACKSPACE) {
-            pith_gapbuf_delete(buf, -1);
+            pith_gapbuf_multi_delete(buf, -1);
             if (is_textarea) update_textarea_scroll(ui->focused_view);
             return true;
         }
 
         /* Delete - delete character after cursor */
         if (key == KEY_DELETE) {
-            pith_gapbuf_delete(buf, 1);
+            pith_gapbuf_multi_delete(buf, 1);
             return true;
         }
 
         /* Left arrow - move cursor left */
         if (key == KEY_LEFT) {
-            pith_gapbuf_move(buf, -1);
+            pith_gapbuf_multi_move(buf, -1);
             if (is_textarea) update_textarea_scroll(ui->focused_view);
             return true;
         }
 
         /* Right arrow - move cursor right */
         if (key == KEY_RIGHT) {
-            pith_gapbuf_move(buf, 1);
+            pith_gapbuf_multi_move(buf, 1);
             if (is_textarea) update_textarea_scroll(ui->focused_view);
             return true;
         }
 
-        /* Up arrow - move cursor up (textarea only) */
+        /* Up arrow - move cursor up (textarea only, drops extra cursors) */
         if (key == KEY_UP && is_textarea) {
-            pith_gapbuf_move_up(buf, 1);
+            pith_gapbuf_clear_cursors(buf);
+            textarea_move_rows(ui->focused_view, -1);
             update_textarea_scroll(ui->focused_view);
             return true;
         }
 
-        /* Down arrow - move cursor down (textarea only) */
+        /* Down arrow - move cursor down (textarea only, drops extra cursors) */
         if (key == KEY_DOWN && is_textarea) {
-            pith_gapbuf_move_down(buf, 1);
+            pith_gapbuf_clear_cursors(buf);
+            textarea_move_rows(ui->focused_view, 1);
             update_textarea_scroll(ui->focused_view);
             return true;
         }
 
         /* Home - move to line start (textarea) or buffer start (textfield) */
         if (key == KEY_HOME) {
+            pith_gapbuf_clear_cursors(buf);
             if (is_textarea) {
                 pith_gapbuf_line_home(buf);
                 update_textarea_scroll(ui->focused_view);
@@ -1360,6 +1490,7 @@ bool pith_ui_handle_textfield_input(PithUI *ui, PithEvent event) {
 
         /* End - move to line end (textarea) or buffer end (textfield) */
         if (key == KEY_END) {
+            pith_gapbuf_clear_cursors(buf);
             if (is_textarea) {
                 pith_gapbuf_line_end_move(buf);
                 update_textarea_scroll(ui->focused_view);
@@ -1372,13 +1503,17 @@ bool pith_ui_handle_textfield_input(PithUI *ui, PithEvent event) {
 
         /* Enter - insert newline (textarea only) */
         if (key == KEY_ENTER && is_textarea) {
-            pith_gapbuf_insert(buf, "\n");
+            pith_gapbuf_multi_insert(buf, "\n");
             update_textarea_scroll(ui->focused_view);
             return true;
         }
 
-        /* Escape - unfocus */
+        /* Escape - drop extra cursors, or unfocus if there are none */
         if (key == KEY_ESCAPE) {
+            if (buf->cursor_count > 0) {
+                pith_gapbuf_clear_cursors(buf);
+                return true;
+            }
             ui->focused_view = NULL;
             return true;
         }
@@ -1387,13 +1522,14 @@ bool pith_ui_handle_textfield_input(PithUI *ui, PithEvent event) {
     return false;
 }
 
-/* Position cursor in textfield/textarea based on click coordinates */
-void pith_ui_click_to_cursor(PithView *view, int click_x, int click_y) {
-    if (!view) return;
+/* Convert click coordinates to a buffer position in a textfield/textarea */
+static bool click_position(PithView *view, int click_x, int click_y,
+                           PithGapBuffer **out_buf, size_t *out_pos) {
+    if (!view) return false;
 
     if (view->type == VIEW_TEXTFIELD) {
         PithGapBuffer *buf = view->as.textfield.buffer;
-        if (!buf) return;
+        if (!buf) return false;
 
         /* Calculate position within the textfield */
         /* render_x + 1 is where text starts (1 cell padding) */
@@ -1402,15 +1538,14 @@ void pith_ui_click_to_cursor(PithView *view, int click_x, int click_y) {
 
         if (char_pos < 0) char_pos = 0;
 
-        /* Clamp to buffer length */
-        size_t len = pith_gapbuf_length(buf);
-        if ((size_t)char_pos > len) char_pos = (int)len;
-
-        pith_gapbuf_goto(buf, (size_t)char_pos);
+        /* Convert the column to a byte position (clamped to the text) */
+        *out_buf = buf;
+        *out_pos = pith_gapbuf_pos_from_line_col(buf, 0, (size_t)char_pos);
+        return true;
 
     } else if (view->type == VIEW_TEXTAREA) {
         PithGapBuffer *buf = view->as.textarea.buffer;
-        if (!buf) return;
+        if (!buf) return false;
 
         /* Calculate position within the textarea */
         /* render_x + 1 is where text starts (1 cell padding) */
@@ -1428,20 +1563,47 @@ void pith_ui_click_to_cursor(PithView *view, int click_x, int click_y) {
         int scroll_offset = buf->scroll_offset;
         size_t line = (size_t)(scroll_offset + visible_line);
 
+        /* Wrapped textareas scroll by visual rows */
+        PithWrapMap *wrap = view->as.textarea.wrap;
+        if (wrap) {
+            pith_wrap_sync(wrap, buf, pith_wrap_width(wrap));
+            *out_buf = buf;
+            *out_pos = pith_wrap_row_col_to_pos(wrap, buf, line, (size_t)col);
+            return true;
+        }
+
         /* Clamp to valid line range */
         size_t total_lines = pith_gapbuf_line_count(buf);
         if (line >= total_lines) {
             line = total_lines > 0 ? total_lines - 1 : 0;
         }
 
-        /* Clamp column to line length */
-        size_t line_len = pith_gapbuf_line_length(buf, line);
-        if ((size_t)col > line_len) col = (int)line_len;
-
-        /* Move cursor to the calculated position */
-        size_t pos = pith_gapbuf_pos_from_line_col(buf, line, (size_t)col);
-        pith_gapbuf_goto(buf, pos);
+        /* Column is clamped to the line */
+        *out_buf = buf;
+        *out_pos = pith_gapbuf_pos_from_line_col(buf, line, (size_t)col);
+        return true;
     }
+    return false;
+}
+
+/* Position cursor in textfield/textarea based on click coordinates */
+void pith_ui_click_to_cursor(PithView *view, int click_x, int click_y) {
+    PithGapBuffer *buf;
+    size_t pos;
+    if (!click_position(view, click_x, click_y, &buf, &pos)) return;
+
+    /* A plain click collapses multiple cursors */
+    pith_gapbuf_clear_cursors(buf);
+    pith_gapbuf_goto(buf, pos);
+}
+
+/* Add an extra cursor at the click position (alt+click in a textarea) */
+void pith_ui_click_add_cursor(PithView *view, int click_x, int click_y) {
+    PithGapBuffer *buf;
+    size_t pos;
+    if (!view || view->type != VIEW_TEXTAREA) return;
+    if (!click_position(view, click_x, click_y, &buf, &pos)) return;
+    pith_gapbuf_add_cursor(buf, pos);
 }
 
 /* Commit text widget content to its source signal */
@@ -1454,7 +1616,7 @@ void pith_ui_commit_text_widget(PithView *view) {
             /* If signal already has gapbuf, buffer is shared - nothing to commit */
             PithValue val = pith_signal_get(sig);
             if (PITH_IS_GAPBUF(val)) return;
-            char *content = pith_gapbuf_to_string(view->as.textfield.buffer);
+            char *content = pith_gapbuf_to_value_string(view->as.textfield.buffer);
             pith_signal_set(sig, PITH_STRING(content));
         }
     } else if (view->type == VIEW_TEXTAREA) {
@@ -1463,7 +1625,7 @@ void pith_ui_commit_text_widget(PithView *view) {
             /* If signal already has gapbuf, buffer is shared - nothing to commit */
             PithValue val = pith_signal_get(sig);
             if (PITH_IS_GAPBUF(val)) return;
-            char *content = pith_gapbuf_to_string(view->as.textarea.buffer);
+            char *content = pith_gapbuf_to_value_string(view->as.textarea.buffer);
             pith_signal_set(sig, PITH_STRING(content));
         }
     }
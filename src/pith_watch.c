@@ -0,0 +1,257 @@
+/*
+ * pith_watch.c - Watch source directories for changed .pith files
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "pith_watch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+/* A file seen by the polling fallback */
+typedef struct {
+    char *path;
+    time_t mtime;
+    off_t size;
+} WatchedFile;
+
+typedef struct {
+    char *path;
+    int wd;                     /* inotify watch descriptor (-1 when polling) */
+} WatchedDir;
+
+struct PithWatcher {
+    int inotify_fd;             /* -1 when polling */
+
+    WatchedDir *dirs;
+    size_t dir_count;
+    size_t dir_capacity;
+
+    WatchedFile *files;         /* Polling state */
+    size_t file_count;
+    size_t file_capacity;
+    double next_poll;
+
+    char **pending;             /* Changed paths not yet returned */
+    size_t pending_count;
+    size_t pending_capacity;
+    char *current;              /* Path of the last returned event */
+};
+
+static bool is_pith_file(const char *name) {
+    size_t len = strlen(name);
+    return len > 5 && strcmp(name + len - 5, ".pith") == 0 && name[0] != '.';
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static char* join_path(const char *dir, const char *name) {
+    size_t len = strlen(dir) + strlen(name) + 2;
+    char *path = malloc(len);
+    snprintf(path, len, "%s/%s", dir, name);
+    return path;
+}
+
+/* Queue a changed path, dropping duplicates (editors often write twice) */
+static void queue_change(PithWatcher *w, char *path) {
+    for (size_t i = 0; i < w->pending_count; i++) {
+        if (strcmp(w->pending[i], path) == 0) {
+            free(path);
+            return;
+        }
+    }
+    if (w->pending_count >= w->pending_capacity) {
+        w->pending_capacity = w->pending_capacity ? w->pending_capacity * 2 : 8;
+        w->pending = realloc(w->pending, w->pending_capacity * sizeof(char*));
+    }
+    w->pending[w->pending_count++] = path;
+}
+
+/* ========================================================================
+   POLLING FALLBACK
+   ======================================================================== */
+
+static WatchedFile* find_file(PithWatcher *w, const char *path) {
+    for (size_t i = 0; i < w->file_count; i++) {
+        if (strcmp(w->files[i].path, path) == 0) return &w->files[i];
+    }
+    return NULL;
+}
+
+/* Stat every .pith file of a directory; report changes unless priming */
+static void scan_dir(PithWatcher *w, const char *dir, bool report) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (!is_pith_file(entry->d_name)) continue;
+
+        char *path = join_path(dir, entry->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0) {
+            free(path);
+            continue;
+        }
+
+        WatchedFile *file = find_file(w, path);
+        if (!file) {
+            if (w->file_count >= w->file_capacity) {
+                w->file_capacity = w->file_capacity ? w->file_capacity * 2 : 16;
+                w->files = realloc(w->files, w->file_capacity * sizeof(WatchedFile));
+            }
+            file = &w->files[w->file_count++];
+            file->path = path;
+            file->mtime = st.st_mtime;
+            file->size = st.st_size;
+            if (report) queue_change(w, strdup(path));
+            continue;
+        }
+        free(path);
+
+        if (file->mtime != st.st_mtime || file->size != st.st_size) {
+            file->mtime = st.st_mtime;
+            file->size = st.st_size;
+            if (report) queue_change(w, strdup(file->path));
+        }
+    }
+    closedir(d);
+}
+
+static void poll_dirs(PithWatcher *w) {
+    double now = now_ms();
+    if (now < w->next_poll) return;
+    w->next_poll = now + PITH_WATCH_POLL_MS;
+
+    for (size_t i = 0; i < w->dir_count; i++) {
+        scan_dir(w, w->dirs[i].path, true);
+    }
+}
+
+/* ========================================================================
+   INOTIFY
+   ======================================================================== */
+
+#ifdef __linux__
+static void read_inotify(PithWatcher *w) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (1) {
+        ssize_t len = read(w->inotify_fd, buf, sizeof(buf));
+        if (len <= 0) return;
+
+        for (char *p = buf; p < buf + len; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->len == 0 || !is_pith_file(ev->name)) continue;
+
+            for (size_t i = 0; i < w->dir_count; i++) {
+                if (w->dirs[i].wd == ev->wd) {
+                    queue_change(w, join_path(w->dirs[i].path, ev->name));
+                    break;
+                }
+            }
+        }
+    }
+}
+#endif
+
+/* ========================================================================
+   WATCHER API
+   ======================================================================== */
+
+PithWatcher* pith_watcher_new(void) {
+    PithWatcher *w = calloc(1, sizeof(PithWatcher));
+    w->inotify_fd = -1;
+#ifdef __linux__
+    w->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    return w;
+}
+
+void pith_watcher_free(PithWatcher *w) {
+    if (!w) return;
+#ifdef __linux__
+    if (w->inotify_fd >= 0) close(w->inotify_fd);
+#endif
+    for (size_t i = 0; i < w->dir_count; i++) free(w->dirs[i].path);
+    free(w->dirs);
+    for (size_t i = 0; i < w->file_count; i++) free(w->files[i].path);
+    free(w->files);
+    for (size_t i = 0; i < w->pending_count; i++) free(w->pending[i]);
+    free(w->pending);
+    free(w->current);
+    free(w);
+}
+
+bool pith_watcher_add_dir(PithWatcher *w, const char *dir) {
+    for (size_t i = 0; i < w->dir_count; i++) {
+        if (strcmp(w->dirs[i].path, dir) == 0) return true;
+    }
+
+    int wd = -1;
+#ifdef __linux__
+    if (w->inotify_fd >= 0) {
+        wd = inotify_add_watch(w->inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) {
+            /* Fall back to polling for every directory */
+            close(w->inotify_fd);
+            w->inotify_fd = -1;
+        }
+    }
+#endif
+
+    if (w->dir_count >= w->dir_capacity) {
+        w->dir_capacity = w->dir_capacity ? w->dir_capacity * 2 : 4;
+        w->dirs = realloc(w->dirs, w->dir_capacity * sizeof(WatchedDir));
+    }
+    w->dirs[w->dir_count].path = strdup(dir);
+    w->dirs[w->dir_count].wd = wd;
+    w->dir_count++;
+
+    /* Remember current sizes and times so polling only reports changes */
+    scan_dir(w, dir, false);
+    return true;
+}
+
+PithEvent pith_watcher_poll(PithWatcher *w) {
+    PithEvent event = { .type = EVENT_NONE };
+    if (!w) return event;
+
+    free(w->current);
+    w->current = NULL;
+
+    if (w->pending_count == 0) {
+#ifdef __linux__
+        if (w->inotify_fd >= 0) {
+            read_inotify(w);
+        } else {
+            poll_dirs(w);
+        }
+#else
+        poll_dirs(w);
+#endif
+    }
+    if (w->pending_count == 0) return event;
+
+    w->current = w->pending[0];
+    memmove(w->pending, w->pending + 1, (w->pending_count - 1) * sizeof(char*));
+    w->pending_count--;
+
+    event.type = EVENT_FILE_CHANGE;
+    event.as.file_change.path = w->current;
+    return event;
+}
@@ -0,0 +1,29 @@
+/*
+ * pith_watch.h - Watch source directories for changed .pith files
+ *
+ * Produces EVENT_FILE_CHANGE events for .pith files that are written,
+ * created or renamed into a watched directory. Uses inotify on Linux and
+ * falls back to polling file sizes and modification times elsewhere (or
+ * when inotify is unavailable).
+ */
+
+#ifndef PITH_WATCH_H
+#define PITH_WATCH_H
+
+#include "pith_types.h"
+
+#define PITH_WATCH_POLL_MS  250     /* Polling fallback interval */
+
+typedef struct PithWatcher PithWatcher;
+
+PithWatcher* pith_watcher_new(void);
+void pith_watcher_free(PithWatcher *w);
+
+/* Start watching a directory (adding the same directory twice is a no-op) */
+bool pith_watcher_add_dir(PithWatcher *w, const char *dir);
+
+/* Next pending change, or an EVENT_NONE event. The event's path stays
+ * valid until the next call. Never blocks. */
+PithEvent pith_watcher_poll(PithWatcher *w);
+
+#endif /* PITH_WATCH_H */
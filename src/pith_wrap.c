@@ -0,0 +1,210 @@
+/*
+ * pith_wrap.c - Soft-wrap layout for textarea views
+ */
+
+#include "pith_wrap.h"
+#include "pith_runtime.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct PithWrapMap {
+    int width;              /* Columns per visual row */
+    size_t line_count;
+    size_t *rows;           /* Visual rows of each line */
+    size_t *tree;           /* Fenwick tree over rows (1-based) */
+    size_t capacity;
+    size_t total;           /* Sum of rows */
+
+    PithGapBuffer *buffer;  /* Buffer the map describes ... */
+    size_t revision;        /* ... at this revision */
+};
+
+PithWrapMap* pith_wrap_new(void) {
+    return calloc(1, sizeof(PithWrapMap));
+}
+
+void pith_wrap_free(PithWrapMap *wm) {
+    if (!wm) return;
+    free(wm->rows);
+    free(wm->tree);
+    free(wm);
+}
+
+static size_t wrap_line_rows(PithWrapMap *wm, PithGapBuffer *gb, size_t line) {
+    size_t cols = pith_gapbuf_line_columns(gb, line);
+    if (cols == 0) return 1;
+    return (cols + (size_t)wm->width - 1) / (size_t)wm->width;
+}
+
+/* Add delta (may wrap around for negative changes) to a line's count */
+static void wrap_tree_add(PithWrapMap *wm, size_t line, size_t delta) {
+    for (size_t k = line + 1; k <= wm->line_count; k += k & (~k + 1)) {
+        wm->tree[k] += delta;
+    }
+}
+
+/* Sum of the rows of lines [0, line) */
+static size_t wrap_tree_prefix(PithWrapMap *wm, size_t line) {
+    size_t sum = 0;
+    for (size_t k = line; k > 0; k -= k & (~k + 1)) {
+        sum += wm->tree[k];
+    }
+    return sum;
+}
+
+/* Recount every line and build the tree in O(n) */
+static void wrap_rebuild(PithWrapMap *wm, PithGapBuffer *gb) {
+    size_t count = pith_gapbuf_line_count(gb);
+    if (count > wm->capacity) {
+        wm->capacity = count;
+        wm->rows = realloc(wm->rows, count * sizeof(size_t));
+        wm->tree = realloc(wm->tree, (count + 1) * sizeof(size_t));
+    }
+    wm->line_count = count;
+    wm->total = 0;
+    wm->tree[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        wm->rows[i] = wrap_line_rows(wm, gb, i);
+        wm->tree[i + 1] = wm->rows[i];
+        wm->total += wm->rows[i];
+    }
+    for (size_t k = 1; k <= count; k++) {
+        size_t parent = k + (k & (~k + 1));
+        if (parent <= count) wm->tree[parent] += wm->tree[k];
+    }
+}
+
+/* Lines were added or removed. Lines [first, last] of the buffer cover
+ * the edit; every line after them is an old line moved by the change in
+ * count. Move those counts into place, recount the edited lines and
+ * rebuild the tree nodes from first on. Returns false if the edit range
+ * doesn't fit the old map. */
+static bool wrap_splice(PithWrapMap *wm, PithGapBuffer *gb, size_t first, size_t last) {
+    size_t count = pith_gapbuf_line_count(gb);
+    size_t old_count = wm->line_count;
+    /* The old lines the edit replaced, [first, old_end), must exist */
+    if (last >= count || last + 1 + old_count < count + first) return false;
+    size_t old_end = last + 1 + old_count - count;
+
+    if (count > wm->capacity) {
+        wm->capacity = count > wm->capacity * 2 ? count : wm->capacity * 2;
+        wm->rows = realloc(wm->rows, wm->capacity * sizeof(size_t));
+        wm->tree = realloc(wm->tree, (wm->capacity + 1) * sizeof(size_t));
+    }
+    memmove(wm->rows + last + 1, wm->rows + old_end, (old_count - old_end) * sizeof(size_t));
+    wm->line_count = count;
+    for (size_t line = first; line <= last; line++) {
+        wm->rows[line] = wrap_line_rows(wm, gb, line);
+    }
+
+    /* Nodes up to first only cover lines before the edit and stay valid.
+     * Those on first's prefix path feed nodes past it; the rest is the
+     * usual linear build. */
+    for (size_t k = first + 1; k <= count; k++) {
+        wm->tree[k] = wm->rows[k - 1];
+    }
+    for (size_t k = first; k > 0; k -= k & (~k + 1)) {
+        size_t parent = k + (k & (~k + 1));
+        if (parent <= count) wm->tree[parent] += wm->tree[k];
+    }
+    for (size_t k = first + 1; k <= count; k++) {
+        size_t parent = k + (k & (~k + 1));
+        if (parent <= count) wm->tree[parent] += wm->tree[k];
+    }
+    wm->total = wrap_tree_prefix(wm, count);
+    return true;
+}
+
+void pith_wrap_sync(PithWrapMap *wm, PithGapBuffer *gb, int width) {
+    if (width < 1) width = 1;
+    size_t start, end;
+
+    if (wm->buffer != gb || wm->width != width) {
+        wm->buffer = gb;
+        wm->width = width;
+        pith_gapbuf_changes_since(gb, gb->revision, &start, &end);
+        wrap_rebuild(wm, gb);
+    } else if (wm->revision != gb->revision) {
+        bool known = pith_gapbuf_changes_since(gb, wm->revision, &start, &end);
+        if (!known) {
+            wrap_rebuild(wm, gb);
+        } else if (start <= end && pith_gapbuf_line_count(gb) != wm->line_count) {
+            /* Lines added or removed: splice in the edited range */
+            size_t first = pith_gapbuf_pos_line(gb, start);
+            size_t last = pith_gapbuf_pos_line(gb, end);
+            if (!wrap_splice(wm, gb, first, last)) wrap_rebuild(wm, gb);
+        } else if (start <= end) {
+            /* Same lines as before: recount only the edited ones */
+            size_t first = pith_gapbuf_pos_line(gb, start);
+            size_t last = pith_gapbuf_pos_line(gb, end);
+            for (size_t line = first; line <= last; line++) {
+                size_t rows = wrap_line_rows(wm, gb, line);
+                if (rows == wm->rows[line]) continue;
+                wrap_tree_add(wm, line, rows - wm->rows[line]);
+                wm->total += rows - wm->rows[line];
+                wm->rows[line] = rows;
+            }
+        }
+    }
+    wm->revision = gb->revision;
+}
+
+int pith_wrap_width(PithWrapMap *wm) {
+    return wm->width > 0 ? wm->width : 1;
+}
+
+size_t pith_wrap_total_rows(PithWrapMap *wm) {
+    return wm->total;
+}
+
+size_t pith_wrap_row_of_line(PithWrapMap *wm, size_t line) {
+    if (line > wm->line_count) line = wm->line_count;
+    return wrap_tree_prefix(wm, line);
+}
+
+size_t pith_wrap_line_at_row(PithWrapMap *wm, size_t row, size_t *sub_row) {
+    if (wm->line_count == 0) {
+        *sub_row = 0;
+        return 0;
+    }
+    if (row >= wm->total) {
+        size_t last = wm->line_count - 1;
+        *sub_row = wm->rows[last] - 1;
+        return last;
+    }
+
+    /* Descend the tree to the last line whose first row is <= row */
+    size_t step = 1;
+    while (step * 2 <= wm->line_count) step *= 2;
+    size_t line = 0;
+    size_t remaining = row;
+    for (; step > 0; step /= 2) {
+        if (line + step <= wm->line_count && wm->tree[line + step] <= remaining) {
+            line += step;
+            remaining -= wm->tree[line];
+        }
+    }
+    *sub_row = remaining;
+    return line;
+}
+
+size_t pith_wrap_pos_to_row(PithWrapMap *wm, PithGapBuffer *gb, size_t pos, size_t *col) {
+    size_t line = pith_gapbuf_pos_line(gb, pos);
+    size_t line_col = pith_gapbuf_pos_column(gb, pos);
+    size_t width = (size_t)pith_wrap_width(wm);
+    size_t sub = line_col / width;
+    if (line < wm->line_count && sub >= wm->rows[line]) sub = wm->rows[line] - 1;
+    *col = line_col - sub * width;
+    return pith_wrap_row_of_line(wm, line) + sub;
+}
+
+size_t pith_wrap_row_col_to_pos(PithWrapMap *wm, PithGapBuffer *gb, size_t row, size_t col) {
+    size_t sub;
+    size_t line = pith_wrap_line_at_row(wm, row, &sub);
+    size_t width = (size_t)pith_wrap_width(wm);
+
+    /* Stay on this row: only the last row of a line may end past width-1 */
+    bool last_row = line >= wm->line_count || sub + 1 >= wm->rows[line];
+    if (!last_row && col >= width) col = width - 1;
+    return pith_gapbuf_pos_from_line_col(gb, line, sub * width + col);
+}
@@ -0,0 +1,42 @@
+/*
+ * pith_wrap.h - Soft-wrap layout for textarea views
+ *
+ * A wrap map records how many visual rows each logical line takes at the
+ * current width. The row counts are kept in a Fenwick (binary indexed)
+ * tree, so the first row of a line and the line at a given row are both
+ * O(log n). Edits only recount the lines they touched. Edits that add
+ * or remove lines also move the counts after them and rebuild the tree
+ * from the first edited line on, without recounting those lines; only a
+ * width change or a lost edit history recounts the whole buffer.
+ */
+
+#ifndef PITH_WRAP_H
+#define PITH_WRAP_H
+
+#include "pith_types.h"
+
+PithWrapMap* pith_wrap_new(void);
+void pith_wrap_free(PithWrapMap *wm);
+
+/* Bring the map up to date with the buffer at width columns per row */
+void pith_wrap_sync(PithWrapMap *wm, PithGapBuffer *gb, int width);
+
+/* Width the map was last synced at */
+int pith_wrap_width(PithWrapMap *wm);
+
+/* Total visual rows */
+size_t pith_wrap_total_rows(PithWrapMap *wm);
+
+/* First visual row of a logical line */
+size_t pith_wrap_row_of_line(PithWrapMap *wm, size_t line);
+
+/* Logical line shown at a visual row, and which of its rows it is */
+size_t pith_wrap_line_at_row(PithWrapMap *wm, size_t row, size_t *sub_row);
+
+/* Visual row of a byte position, and its column within that row */
+size_t pith_wrap_pos_to_row(PithWrapMap *wm, PithGapBuffer *gb, size_t pos, size_t *col);
+
+/* Byte position at a visual row and column (clamped to the row) */
+size_t pith_wrap_row_col_to_pos(PithWrapMap *wm, PithGapBuffer *gb, size_t row, size_t col);
+
+#endif /* PITH_WRAP_H */
@@ -0,0 +1,206 @@
+/*
+ * project.c - Project loading checks a single .pith test can't express
+ *
+ * Each check builds a throwaway project directory under /tmp, loads it
+ * through the same API main.c uses and compares what the slots print.
+ *
+ * Usage: project
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "pith_runtime.h"
+#include "pith_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static int failures;
+
+/* ========================================================================
+   HELPERS
+   ======================================================================== */
+
+static void check(bool ok, const char *what) {
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) failures++;
+}
+
+/* A fresh project directory with an empty pith/ inside */
+static char* make_project(void) {
+    char *dir = strdup("/tmp/pith-project-XXXXXX");
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        exit(2);
+    }
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/pith", dir);
+    mkdir(path, 0755);
+    return dir;
+}
+
+static void write_source(const char *dir, const char *name, const char *source) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/pith/%s", dir, name);
+    pith_fs_native().write_file(path, source, strlen(source), 0, NULL);
+}
+
+static void remove_project(const char *dir) {
+    char command[1024];
+    snprintf(command, sizeof(command), "rm -rf '%s'", dir);
+    if (system(command) != 0) fprintf(stderr, "could not remove %s\n", dir);
+}
+
+/* Output of running a slot (print output and any error) */
+static char* run_slot(PithRuntime *rt, const char *slot) {
+    char *output = NULL;
+    size_t len;
+    FILE *out = open_memstream(&output, &len);
+    rt->out = out;
+    pith_runtime_run_slot(rt, slot);
+    if (rt->has_error) {
+        fprintf(out, "Error in %s: %s\n", slot, pith_get_error(rt));
+        rt->has_error = false;
+    }
+    fclose(out);
+    rt->out = stdout;
+    return output;
+}
+
+static bool slot_prints(PithRuntime *rt, const char *slot, const char *expected) {
+    char *output = run_slot(rt, slot);
+    bool ok = strcmp(output, expected) == 0;
+    if (!ok) fprintf(stderr, "  expected \"%s\", got \"%s\"\n", expected, output);
+    free(output);
+    return ok;
+}
+
+static PithRuntime* load(const char *dir) {
+    PithRuntime *rt = pith_runtime_new(pith_fs_native());
+    if (!pith_runtime_load_project(rt, dir)) {
+        fprintf(stderr, "  load failed: %s\n", pith_get_error(rt));
+    }
+    return rt;
+}
+
+/* Whether every unit was mapped from the token cache */
+static bool all_units_cached(PithRuntime *rt) {
+    if (rt->unit_count == 0) return false;
+    for (size_t i = 0; i < rt->unit_count; i++) {
+        if (!rt->units[i]->map) return false;
+    }
+    return true;
+}
+
+/* ========================================================================
+   CHECKS
+   ======================================================================== */
+
+/* The second load maps every file's tokens from pith/.cache */
+static void check_token_cache(void) {
+    char *dir = make_project();
+    write_source(dir, "runtime.pith",
+                 "main:\n    \"from \" helper concat print\nend\n");
+    write_source(dir, "helper.pith", "helper:\n    \"cache\"\nend\n");
+
+    PithRuntime *first = load(dir);
+    check(first->unit_count == 2 && !first->units[0]->map && !first->units[1]->map,
+          "first load lexes every file");
+    check(slot_prints(first, "main", "from cache\n"), "first load runs");
+    pith_runtime_free(first);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/pith/.cache/runtime.pith.tokens", dir);
+    check(access(path, R_OK) == 0, "token cache is written");
+
+    PithRuntime *second = load(dir);
+    check(all_units_cached(second), "second load is served from the cache");
+    check(slot_prints(second, "main", "from cache\n"), "cached load runs the same");
+    pith_runtime_free(second);
+
+    /* A changed source must not be served stale tokens */
+    write_source(dir, "helper.pith", "helper:\n    \"fresh source\"\nend\n");
+    PithRuntime *third = load(dir);
+    check(slot_prints(third, "main", "from fresh source\n"), "changed file is lexed again");
+    pith_runtime_free(third);
+
+    remove_project(dir);
+    free(dir);
+}
+
+/* Reloading a file swaps in its new bodies for every caller */
+static void check_reload(void) {
+    char *dir = make_project();
+    write_source(dir, "runtime.pith",
+                 "main:\n    greeting print\nend\n\n"
+                 "shout:\n    greeting uppercase print\nend\n");
+    write_source(dir, "words.pith", "greeting:\n    \"before\"\nend\n");
+
+    PithRuntime *rt = load(dir);
+    check(slot_prints(rt, "main", "before\n"), "word runs before reload");
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/pith/words.pith", dir);
+    write_source(dir, "words.pith", "greeting:\n    \"after\"\nend\n");
+    check(pith_runtime_reload_file(rt, path), "changed file reloads");
+    check(slot_prints(rt, "main", "after\n"), "caller sees the new body");
+    check(slot_prints(rt, "shout", "AFTER\n"), "every caller sees the new body");
+
+    /* A file that no longer parses leaves the last good definitions */
+    write_source(dir, "words.pith", "greeting:\n    \"broken\"\n");
+    check(!pith_runtime_reload_file(rt, path), "broken file is rejected");
+    rt->has_error = false;
+    check(slot_prints(rt, "main", "after\n"), "rejected reload keeps the old body");
+
+    pith_runtime_free(rt);
+    remove_project(dir);
+    free(dir);
+}
+
+/* A top-level name belongs to one file; a second definition is an error */
+static void check_duplicate_names(void) {
+    char *dir = make_project();
+    write_source(dir, "runtime.pith", "main:\n    greeting print\nend\n");
+    write_source(dir, "words.pith", "greeting:\n    \"hello\"\nend\n");
+
+    PithRuntime *rt = load(dir);
+    check(slot_prints(rt, "main", "hello\n"), "word from a second file runs");
+
+    /* Reloading a file may not take over another file's name */
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/pith/words.pith", dir);
+    write_source(dir, "words.pith",
+                 "greeting:\n    \"hello\"\nend\n\nmain:\n    \"taken\" print\nend\n");
+    check(!pith_runtime_reload_file(rt, path), "reload repeating a name is rejected");
+    check(strstr(pith_get_error(rt), "'main' is already defined in") != NULL,
+          "reload error names the duplicate");
+    rt->has_error = false;
+    check(slot_prints(rt, "main", "hello\n"), "rejected reload keeps the first file's body");
+    pith_runtime_free(rt);
+
+    write_source(dir, "words.pith",
+                 "greeting:\n    \"hello\"\nend\n\napp:\n    name: \"words\"\nend\n");
+    write_source(dir, "runtime.pith",
+                 "app:\n    name: \"runtime\"\nend\n\nmain:\n    app.name print\nend\n");
+    rt = pith_runtime_new(pith_fs_native());
+    check(!pith_runtime_load_project(rt, dir), "duplicate dictionary fails the load");
+    const char *error = pith_get_error(rt);
+    check(strstr(error, "words.pith: 'app' is already defined in") != NULL &&
+          strstr(error, "runtime.pith") != NULL,
+          "load error names both files");
+    pith_runtime_free(rt);
+
+    remove_project(dir);
+    free(dir);
+}
+
+int main(void) {
+    check_token_cache();
+    check_reload();
+    check_duplicate_names();
+
+    printf("%s\n", failures ? "Project checks failed" : "Project checks passed");
+    return failures ? 1 : 0;
+}
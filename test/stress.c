@@ -0,0 +1,169 @@
+/*
+ * stress.c - Run the test corpus on many runtimes at once
+ *
+ * Each .pith test is first run alone to record its output. Then N threads
+ * each create their own runtimes and run every test several times, in a
+ * different order per thread, checking that the output never changes.
+ * Any shared mutable state between runtimes shows up as a mismatch (or
+ * as a report when built with -fsanitize=thread).
+ *
+ * Usage: stress <test-dir> [threads] [rounds]
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "pith_runtime.h"
+#include "pith_fs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define STRESS_THREAD_STACK (16 * 1024 * 1024)
+#define STRESS_MAX_REPORTS  10
+
+typedef struct {
+    char *path;
+    char *expected;             /* Output of the single-threaded run */
+    size_t expected_len;
+} StressTest;
+
+static StressTest *tests;
+static size_t test_count;
+static int rounds = 4;
+static atomic_int mismatches;
+
+/* ========================================================================
+   RUNNING A TEST
+   ======================================================================== */
+
+/* Run one test the way main.c does, capturing print output and errors */
+static char* run_test(const char *path, size_t *len) {
+    char *output = NULL;
+    FILE *out = open_memstream(&output, len);
+
+    PithRuntime *rt = pith_runtime_new(pith_fs_native());
+    rt->out = out;
+
+    if (!pith_runtime_load_project(rt, path)) {
+        fprintf(out, "Failed to load project: %s\n", pith_get_error(rt));
+    } else {
+        const char *slots[] = { "init", "main", "exit" };
+        for (int i = 0; i < 3; i++) {
+            pith_runtime_run_slot(rt, slots[i]);
+            if (rt->has_error) {
+                fprintf(out, "Error in %s: %s\n", slots[i], pith_get_error(rt));
+                break;
+            }
+        }
+    }
+
+    pith_runtime_free(rt);
+    fclose(out);
+    return output;
+}
+
+static void* stress_thread(void *arg) {
+    size_t id = (size_t)arg;
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < test_count; i++) {
+            StressTest *t = &tests[(i + id * 7 + (size_t)r) % test_count];
+            size_t len;
+            char *output = run_test(t->path, &len);
+            if (len != t->expected_len || memcmp(output, t->expected, len) != 0) {
+                if (atomic_fetch_add(&mismatches, 1) < STRESS_MAX_REPORTS) {
+                    fprintf(stderr, "MISMATCH (thread %zu): %s\n", id, t->path);
+                }
+            }
+            free(output);
+        }
+    }
+    return NULL;
+}
+
+/* ========================================================================
+   MAIN
+   ======================================================================== */
+
+static int compare_tests(const void *a, const void *b) {
+    return strcmp(((const StressTest *)a)->path, ((const StressTest *)b)->path);
+}
+
+/* Tests that write fixed paths under /tmp would race with each other */
+static bool uses_shared_files(const char *path) {
+    char *source = pith_fs_native().read_file(path, NULL, NULL);
+    bool shared = source && (strstr(source, "file-write") || strstr(source, "file-append"));
+    free(source);
+    return shared;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <test-dir> [threads] [rounds]\n", argv[0]);
+        return 2;
+    }
+    int threads = argc > 2 ? atoi(argv[2]) : 8;
+    if (argc > 3) rounds = atoi(argv[3]);
+    if (threads < 1) threads = 1;
+
+    DIR *dir = opendir(argv[1]);
+    if (!dir) {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 2;
+    }
+    size_t capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t n = strlen(entry->d_name);
+        if (n <= 5 || strcmp(entry->d_name + n - 5, ".pith") != 0) continue;
+
+        char *path = malloc(strlen(argv[1]) + n + 2);
+        sprintf(path, "%s/%s", argv[1], entry->d_name);
+        if (uses_shared_files(path)) {
+            free(path);
+            continue;
+        }
+        if (test_count >= capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            tests = realloc(tests, capacity * sizeof(StressTest));
+        }
+        tests[test_count++] = (StressTest){ .path = path };
+    }
+    closedir(dir);
+    if (test_count == 0) {
+        fprintf(stderr, "No tests found in %s\n", argv[1]);
+        return 2;
+    }
+    qsort(tests, test_count, sizeof(StressTest), compare_tests);
+
+    /* Reference outputs, one runtime at a time */
+    for (size_t i = 0; i < test_count; i++) {
+        tests[i].expected = run_test(tests[i].path, &tests[i].expected_len);
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, STRESS_THREAD_STACK);
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&ids[i], &attr, stress_thread, (void *)(size_t)i);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    pthread_attr_destroy(&attr);
+    free(ids);
+
+    int failed = atomic_load(&mismatches);
+    printf("Stress: %zu tests x %d rounds on %d threads, %d mismatches\n",
+           test_count, rounds, threads, failed);
+
+    for (size_t i = 0; i < test_count; i++) {
+        free(tests[i].path);
+        free(tests[i].expected);
+    }
+    free(tests);
+    return failed ? 1 : 0;
+}